@@ -32,6 +32,12 @@
 #include "image_analyzer.h"
 #include "ia_sequence.h"
 #include "analyze.h"
+#include "numa.h"
+#include "tstats.h"
+#include "stabilize.h"
+#include "scene.h"
+#include "gate.h"
+#include "hash.h"
 #include "filters/filters.h"
 
 static inline ia_seq_t* analyze_init( ia_param_t* p )
@@ -44,6 +50,24 @@ static inline ia_seq_t* analyze_init( ia_param_t* p )
         return NULL;
     }
 
+    if( p->StabSettings.Enable ) {
+        ias->stab = ia_stab_open( p->StabSettings.Window ? p->StabSettings.Window : p->i_maxrefs );
+        if( ias->stab == NULL )
+            fprintf( stderr, "ERROR: analyze_init(): couldnt alloc stabiliser, frames are left as they are\n" );
+    }
+
+    if( p->SceneSettings.Keyframes || p->SceneSettings.ListFile[0] ) {
+        ias->scene = ia_scene_open( p );
+        if( ias->scene == NULL )
+            fprintf( stderr, "ERROR: analyze_init(): couldnt alloc scene cut detector, every frame is output\n" );
+    }
+
+    if( p->GateSettings.Threshold >= 0 ) {
+        ias->gate = ia_gate_open( p );
+        if( ias->gate == NULL )
+            fprintf( stderr, "ERROR: analyze_init(): couldnt alloc motion gate, every frame is filtered\n" );
+    }
+
     init_filters();
 
     /* call any init functions */
@@ -57,6 +81,23 @@ static inline ia_seq_t* analyze_init( ia_param_t* p )
     return ias;
 }
 
+/* filters that keep state from one frame to the next, or write lists, in
+ * frame order. they have to see every frame, gated or repeated or not. */
+static inline bool analyze_filter_ordered( int filter )
+{
+    switch( filter ) {
+        case BGSUB:
+        case BHATTA:
+        case BLOBS:
+        case CORNERS:
+        case TEMPLATE:
+        case TRACK:
+            return true;
+        default:
+            return false;
+    }
+}
+
 static inline void analyze_deinit( ia_seq_t* s )
 {
     int j;
@@ -68,6 +109,10 @@ static inline void analyze_deinit( ia_seq_t* s )
             filters.clos[s->param->filter[j]]( s->fparam[s->param->filter[j]] );
     }
 
+    ia_gate_report( s->gate, stderr );
+    if( s->param->DedupSettings.Enable )
+        fprintf( stderr, "dedup: %llu frames repeated the previous output\n",
+                 (long long unsigned) s->i_dups );
     ia_seq_close( s );
 }
 
@@ -83,9 +128,14 @@ void* analyze_exec( void* vptr )
     if( !iaim )
         ia_pthread_exit( NULL );
 
+    /* pinned before the first image is created so the results are first
+     * touched, and placed, on this worker's node */
+    ia_numa_pin( s->param->worker_cpus, iax->bufno );
+
     while( 1 )
     {
         ia_image_t *iaf, *iar;
+        bool b_key = true, b_gated = false, b_skip;
         int j, rc;
         uint64_t i, current_frame;
 
@@ -97,12 +147,25 @@ void* analyze_exec( void* vptr )
             break;
         }
 
-        if( s->iaio->b_decode && 1 == iaio_freeimage_decode_image(s->iaio, iaf) ) {
+        if( iaf->encoded && 1 == iaio_freeimage_decode_image(s->iaio, iaf) ) {
             fprintf( stderr, "decoding image failed\n" );
             return NULL;
         }
         iaf->i_refcount = i_maxrefs;
 
+        /* on the frame as decoded, before stabilising warps it */
+        if( s->scene )
+            b_key = ia_scene_frame( s->scene, iaf );
+
+        /* before the frame goes in the ref list, so every use of it sees it
+         * stabilised */
+        if( s->stab && ia_stab_frame(s->stab, iaf) )
+            fprintf( stderr, "ERROR: analyze_exec(): couldnt stabilise frame %llu\n",
+                     (long long unsigned) iaf->i_frame );
+
+        if( s->gate )
+            b_gated = ia_gate_frame( s->gate, iaf );
+
         current_frame = iaf->i_frame;
         /* short curcuit the fancy reference frame gathering stuff if the
          * filter only needs one frame */
@@ -160,16 +223,42 @@ void* analyze_exec( void* vptr )
         iar = ia_image_create( iax->ias->param->i_width, iax->ias->param->i_height );
 
         iar->i_frame = current_frame;
+        iar->b_drop = s->param->SceneSettings.Keyframes && !b_key;
+        if( b_gated && s->gate->b_drop )
+            iar->b_drop = true;
+        else if( b_gated || iaf->b_dup )
+            iar->b_repeat = true;
+        b_skip = b_gated || iaf->b_dup || iar->b_drop;
+        if( s->tstats )
+            iar->tstats = ia_tstats_advance( s->tstats, iaim, current_frame );
 
         /* do processing */
         for ( j = 0; iax->ias->param->filter[j] != 0 && no_filter >= 0; j++ )
         {
-            if( filters.exec[iax->ias->param->filter[j]] )
-                filters.exec[iax->ias->param->filter[j]]( iax->ias, iax->ias->fparam[iax->ias->param->filter[j]], iaim, iar );
-            else
+            if( filters.exec[iax->ias->param->filter[j]] ) {
+                if( !b_skip || analyze_filter_ordered(iax->ias->param->filter[j]) )
+                    filters.exec[iax->ias->param->filter[j]]( iax->ias, iax->ias->fparam[iax->ias->param->filter[j]], iaim, iar );
+            } else
                 no_filter++;
         }
 
+        ia_tstats_window_free( iar->tstats );
+        iar->tstats = NULL;
+
+        /* a frame the filters passed through unchanged is written from the
+         * planes it was read from. they may have come over with the pixels,
+         * see ia_image_swap, and any filter or stabilising changes the hash */
+        if( iar->planes == NULL && iaf->planes != NULL ) {
+            iar->planes = iaf->planes;
+            iar->i_planes_hash = iaf->i_planes_hash;
+            iaf->planes = NULL;
+        }
+        if( iar->planes && (iar->b_repeat || iar->b_drop ||
+                            ia_hash_image( iar ) != iar->i_planes_hash) ) {
+            ia_free( iar->planes );
+            iar->planes = NULL;
+        }
+
         /* mark the no filter flag if no filters were specified */
         if( no_filter == j || no_filter == -1 )
             no_filter = -1;
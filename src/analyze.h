@@ -37,7 +37,6 @@ ia_pixel_t *get_gaussian(int ksize);
 ia_pixel_t* get_reflectance_image(IplImage* im, ia_pixel_t* gaussian, int ksize);
 ia_pixel_t* patch_diff(ia_pixel_t* ima, ia_pixel_t* imb, int ksize);
 ia_pixel_t* Iplblur(IplImage* im, ia_pixel_t* gaussian, int ksize);
-void dialate(ia_pixel_t* im, int ksize);
 
 
 // these actually work but you wont ever need to call them outside of analyze.c
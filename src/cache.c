@@ -0,0 +1,277 @@
+#include "cache.h"
+
+static ia_cache_entry_t* ia_cache_get_locked( ia_image_t* iaf, ia_cache_kind_t kind );
+
+static ia_cache_entry_t* ia_cache_entry_create( ia_cache_kind_t kind, int width, int height,
+                                                int channels, size_t value_size )
+{
+    ia_cache_entry_t* e = ia_malloc( sizeof(ia_cache_entry_t) );
+
+    if( e == NULL )
+        return NULL;
+
+    e->kind = kind;
+    e->i_width = width;
+    e->i_height = height;
+    e->i_channels = channels;
+    e->i_stride = (size_t)width * channels;
+    e->i_refcount = 1;
+    // tiny frames have empty pyramid levels, keep data valid anyway
+    e->data = ia_malloc( e->i_stride * (height > 0 ? height : 1) * value_size + 1 );
+    if( e->data == NULL ) {
+        ia_free( e );
+        return NULL;
+    }
+    return e;
+}
+
+static void ia_cache_build_luma( ia_cache_entry_t* e, ia_image_t* iaf )
+{
+    uint8_t* luma = e->data;
+    int x, y;
+
+    for( y = 0; y < e->i_height; y++ )
+    {
+        const ia_pixel_t* p = iaf->pix + (size_t)y * iaf->i_pitch;
+        uint8_t* l = luma + y * e->i_stride;
+
+        for( x = 0; x < e->i_width; x++ )
+            l[x] = 0.30 * p[3*x] + 0.59 * p[3*x+1] + 0.11 * p[3*x+2];
+    }
+}
+
+/* one row of zeros, then every value is its own plus the ones above and left */
+static void ia_cache_build_integral( ia_cache_entry_t* e, const uint8_t* src,
+                                     size_t src_stride, bool b_square )
+{
+    const int n = e->i_channels;
+    const int w = e->i_width - 1;
+    int x, y, c;
+
+    memset( e->data, 0, e->i_stride * (b_square ? sizeof(uint64_t) : sizeof(uint32_t)) );
+
+    for( y = 1; y < e->i_height; y++ )
+    {
+        const uint8_t* s = src + (y-1) * src_stride;
+
+        for( c = 0; c < n; c++ )
+        {
+            if( b_square ) {
+                uint64_t* t = (uint64_t*) e->data + y * e->i_stride;
+                uint64_t sum = 0;
+                t[c] = 0;
+                for( x = 0; x < w; x++ ) {
+                    sum += s[x*n+c] * s[x*n+c];
+                    t[(x+1)*n+c] = t[(x+1)*n+c - e->i_stride] + sum;
+                }
+            } else {
+                uint32_t* t = (uint32_t*) e->data + y * e->i_stride;
+                uint32_t sum = 0;
+                t[c] = 0;
+                for( x = 0; x < w; x++ ) {
+                    sum += s[x*n+c];
+                    t[(x+1)*n+c] = t[(x+1)*n+c - e->i_stride] + sum;
+                }
+            }
+        }
+    }
+}
+
+static inline int16_t ia_cache_sobel( const uint8_t* up, const uint8_t* mid, const uint8_t* down,
+                                      int xl, int x, int xr, bool b_x )
+{
+    if( b_x )
+        return (up[xr] + 2*mid[xr] + down[xr]) - (up[xl] + 2*mid[xl] + down[xl]);
+    return (down[xl] + 2*down[x] + down[xr]) - (up[xl] + 2*up[x] + up[xr]);
+}
+
+/* 3x3 sobel with the border samples repeated outwards. the first and last
+ * column are done apart so the loop over the others has no branches and
+ * vectorizes. */
+static void ia_cache_build_gradient( ia_cache_entry_t* e, ia_cache_entry_t* luma, bool b_x )
+{
+    const uint8_t* l = luma->data;
+    int16_t* g = e->data;
+    const int w = e->i_width;
+    const int h = e->i_height;
+    int x, y;
+
+    if( w < 1 )
+        return;
+
+    for( y = 0; y < h; y++ )
+    {
+        const uint8_t* up = l + (y > 0   ? y-1 : 0) * luma->i_stride;
+        const uint8_t* mid = l + y * luma->i_stride;
+        const uint8_t* down = l + (y < h-1 ? y+1 : h-1) * luma->i_stride;
+        int16_t* d = g + y * e->i_stride;
+
+        d[0] = ia_cache_sobel( up, mid, down, 0, 0, w > 1 ? 1 : 0, b_x );
+        if( b_x ) {
+            for( x = 1; x < w-1; x++ )
+                d[x] = (up[x+1] + 2*mid[x+1] + down[x+1]) - (up[x-1] + 2*mid[x-1] + down[x-1]);
+        } else {
+            for( x = 1; x < w-1; x++ )
+                d[x] = (down[x-1] + 2*down[x] + down[x+1]) - (up[x-1] + 2*up[x] + up[x+1]);
+        }
+        if( w > 1 )
+            d[w-1] = ia_cache_sobel( up, mid, down, w-2, w-1, w-1, b_x );
+    }
+}
+
+static void ia_cache_build_pyramid( ia_cache_entry_t* e, ia_cache_entry_t* src )
+{
+    const uint8_t* s = src->data;
+    uint8_t* d = e->data;
+    int x, y;
+
+    for( y = 0; y < e->i_height; y++ )
+    {
+        const uint8_t* s0 = s + 2*y * src->i_stride;
+        const uint8_t* s1 = s0 + src->i_stride;
+
+        for( x = 0; x < e->i_width; x++ )
+            d[y * e->i_stride + x] = (s0[2*x] + s0[2*x+1] + s1[2*x] + s1[2*x+1] + 2) >> 2;
+    }
+}
+
+/* one pass over luma, a row adds to the histograms of the tiles it crosses */
+static void ia_cache_build_tile_hist( ia_cache_entry_t* e, ia_cache_entry_t* luma )
+{
+    uint32_t* hist = e->data;
+    int x, y, t;
+
+    memset( hist, 0, e->i_stride * e->i_height * sizeof(uint32_t) );
+    for( y = 0; y < luma->i_height; y++ )
+    {
+        const uint8_t* l = (uint8_t*) luma->data + y * luma->i_stride;
+        uint32_t* row = hist + (y / IA_CACHE_TILE) * e->i_stride;
+
+        for( t = 0; t < e->i_width; t++ ) {
+            uint32_t* h = row + t * 256;
+            const int x1 = (t+1) * IA_CACHE_TILE < luma->i_width ? (t+1) * IA_CACHE_TILE : luma->i_width;
+            for( x = t * IA_CACHE_TILE; x < x1; x++ )
+                h[l[x]]++;
+        }
+    }
+}
+
+static ia_cache_entry_t* ia_cache_build( ia_image_t* iaf, ia_cache_kind_t kind )
+{
+    const int w = iaf->i_width;
+    const int h = iaf->i_height;
+    ia_cache_entry_t *e, *src = NULL;
+
+    /* make sure what this entry is built from is there first */
+    switch( kind ) {
+        case IA_CACHE_INTEGRAL:
+        case IA_CACHE_INTEGRAL2:
+        case IA_CACHE_GRAD_X:
+        case IA_CACHE_GRAD_Y:
+        case IA_CACHE_PYR2:
+        case IA_CACHE_TILE_HIST:
+            src = ia_cache_get_locked( iaf, IA_CACHE_LUMA );
+            break;
+        case IA_CACHE_PYR4:
+            src = ia_cache_get_locked( iaf, IA_CACHE_PYR2 );
+            break;
+        case IA_CACHE_PYR8:
+            src = ia_cache_get_locked( iaf, IA_CACHE_PYR4 );
+            break;
+        default:
+            break;
+    }
+    if( kind != IA_CACHE_LUMA && kind != IA_CACHE_INTEGRAL_BGR && src == NULL )
+        return NULL;
+
+    switch( kind ) {
+        case IA_CACHE_LUMA:
+            if( (e = ia_cache_entry_create(kind, w, h, 1, sizeof(uint8_t))) )
+                ia_cache_build_luma( e, iaf );
+            break;
+        case IA_CACHE_INTEGRAL:
+        case IA_CACHE_INTEGRAL2:
+            if( (e = ia_cache_entry_create(kind, w+1, h+1, 1, kind == IA_CACHE_INTEGRAL2 ?
+                                           sizeof(uint64_t) : sizeof(uint32_t))) )
+                ia_cache_build_integral( e, src->data, src->i_stride, kind == IA_CACHE_INTEGRAL2 );
+            break;
+        case IA_CACHE_INTEGRAL_BGR:
+            if( (e = ia_cache_entry_create(kind, w+1, h+1, 3, sizeof(uint32_t))) )
+                ia_cache_build_integral( e, iaf->pix, iaf->i_pitch, false );
+            break;
+        case IA_CACHE_GRAD_X:
+        case IA_CACHE_GRAD_Y:
+            if( (e = ia_cache_entry_create(kind, w, h, 1, sizeof(int16_t))) )
+                ia_cache_build_gradient( e, src, kind == IA_CACHE_GRAD_X );
+            break;
+        case IA_CACHE_PYR2:
+        case IA_CACHE_PYR4:
+        case IA_CACHE_PYR8:
+            if( (e = ia_cache_entry_create(kind, src->i_width/2, src->i_height/2, 1, sizeof(uint8_t))) )
+                ia_cache_build_pyramid( e, src );
+            break;
+        case IA_CACHE_TILE_HIST:
+            if( (e = ia_cache_entry_create(kind, (w + IA_CACHE_TILE-1) / IA_CACHE_TILE,
+                                           (h + IA_CACHE_TILE-1) / IA_CACHE_TILE, 256, sizeof(uint32_t))) )
+                ia_cache_build_tile_hist( e, src );
+            break;
+        default:
+            e = NULL;
+            break;
+    }
+
+    if( e == NULL )
+        fprintf( stderr, "ERROR: ia_cache_build(): couldnt alloc cache entry %d\n", kind );
+    return e;
+}
+
+/* iaf->mutex must be held */
+static ia_cache_entry_t* ia_cache_get_locked( ia_image_t* iaf, ia_cache_kind_t kind )
+{
+    if( iaf->cache[kind] == NULL )
+        iaf->cache[kind] = ia_cache_build( iaf, kind );
+    return iaf->cache[kind];
+}
+
+ia_cache_entry_t* ia_cache_get( ia_image_t* iaf, ia_cache_kind_t kind )
+{
+    ia_cache_entry_t* e;
+    int rc;
+
+    if( 0 != (rc = ia_pthread_mutex_lock( &iaf->mutex )) )
+        ia_pthread_error( rc, "ia_cache_get()", "ia_pthread_mutex_lock()" );
+
+    e = ia_cache_get_locked( iaf, kind );
+    if( e != NULL )
+        __sync_fetch_and_add( &e->i_refcount, 1 );
+
+    if( 0 != (rc = ia_pthread_mutex_unlock( &iaf->mutex )) )
+        ia_pthread_error( rc, "ia_cache_get()", "ia_pthread_mutex_unlock()" );
+    return e;
+}
+
+void ia_cache_release( ia_cache_entry_t* e )
+{
+    if( e == NULL )
+        return;
+    if( __sync_sub_and_fetch(&e->i_refcount, 1) == 0 ) {
+        ia_free( e->data );
+        ia_free( e );
+    }
+}
+
+void ia_cache_flush( ia_image_t* iaf )
+{
+    int i, rc;
+
+    if( 0 != (rc = ia_pthread_mutex_lock( &iaf->mutex )) )
+        ia_pthread_error( rc, "ia_cache_flush()", "ia_pthread_mutex_lock()" );
+
+    for( i = 0; i < IA_CACHE_NUM; i++ ) {
+        ia_cache_release( iaf->cache[i] );
+        iaf->cache[i] = NULL;
+    }
+
+    if( 0 != (rc = ia_pthread_mutex_unlock( &iaf->mutex )) )
+        ia_pthread_error( rc, "ia_cache_flush()", "ia_pthread_mutex_unlock()" );
+}
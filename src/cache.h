@@ -0,0 +1,61 @@
+#ifndef _H_CACHE
+#define _H_CACHE
+
+#include "common.h"
+
+/* data derived from the pixels of a frame, built the first time a filter asks
+ * for it and kept on the frame until it is freed. a frame is used by every
+ * filter and, as a ref, by the next i_maxrefs-1 frames too, so each entry is
+ * built at most once per frame whatever the filters and refs.
+ *
+ * rows are in the same order as pix, so (x,y) of an entry is the pixel at
+ * offset(i_pitch,x,y,0) of the frame. */
+typedef struct ia_cache_entry_t
+{
+    ia_cache_kind_t kind;
+    int32_t     i_width;    // samples per row
+    int32_t     i_height;
+    int32_t     i_channels; // interleaved values per sample
+    size_t      i_stride;   // values from one row to the next
+    void*       data;
+    int32_t     i_refcount; // the frame holds one, ia_cache_get hands out more
+} ia_cache_entry_t;
+
+/* returns the kind entry of iaf, building it (and what it is built from) if
+ * this is the first request. the entry stays valid until it is given back
+ * with ia_cache_release, even if iaf is freed in the meantime.
+ * retval: the entry, NULL if it couldnt be allocated */
+ia_cache_entry_t* ia_cache_get( ia_image_t* iaf, ia_cache_kind_t kind );
+
+void ia_cache_release( ia_cache_entry_t* e );
+
+/* IA_CACHE_TILE_HIST cuts the frame into tiles this many pixels a side, the
+ * last ones in a row or column get what is left. its samples are tiles and
+ * its values the 256 bins of their histograms. */
+#define IA_CACHE_TILE 64
+
+/* drops everything cached for iaf, needed when its pixels change */
+void ia_cache_flush( ia_image_t* iaf );
+
+/* sum of the samples of channel c in [x0,x1) x [y0,y1) of an
+ * IA_CACHE_INTEGRAL or IA_CACHE_INTEGRAL_BGR entry. the table wraps around
+ * for big frames but the sum of any window smaller than 2^32 comes out right */
+static inline uint32_t ia_cache_box32( ia_cache_entry_t* e, int x0, int y0,
+                                       int x1, int y1, int c )
+{
+    const uint32_t* t = e->data;
+    const int n = e->i_channels;
+    return t[y1*e->i_stride + x1*n + c] - t[y0*e->i_stride + x1*n + c]
+         - t[y1*e->i_stride + x0*n + c] + t[y0*e->i_stride + x0*n + c];
+}
+
+/* the same for IA_CACHE_INTEGRAL2 */
+static inline uint64_t ia_cache_box64( ia_cache_entry_t* e, int x0, int y0,
+                                       int x1, int y1 )
+{
+    const uint64_t* t = e->data;
+    return t[y1*e->i_stride + x1] - t[y0*e->i_stride + x1]
+         - t[y1*e->i_stride + x0] + t[y0*e->i_stride + x0];
+}
+
+#endif
@@ -0,0 +1,193 @@
+#include "ccl.h"
+
+static inline int32_t ia_ccl_find( ia_ccl_run_t* runs, int32_t i )
+{
+    while( runs[i].parent != i ) {
+        runs[i].parent = runs[runs[i].parent].parent;
+        i = runs[i].parent;
+    }
+    return i;
+}
+
+/* links the later root to the earlier one, so a root is always the first run
+ * of its blob */
+static inline void ia_ccl_union( ia_ccl_run_t* runs, int32_t a, int32_t b )
+{
+    a = ia_ccl_find( runs, a );
+    b = ia_ccl_find( runs, b );
+    if( a < b )
+        runs[b].parent = a;
+    else if( b < a )
+        runs[a].parent = b;
+}
+
+/* joins the runs of row y with the 8-connected ones of row y-1 */
+static void ia_ccl_connect( ia_ccl_t* l, int y )
+{
+    int i = l->row[y-1], j = l->row[y];
+    const int i_end = l->row[y], j_end = l->row[y+1];
+
+    while( i < i_end && j < j_end )
+    {
+        ia_ccl_run_t* up = &l->runs[i];
+        ia_ccl_run_t* cur = &l->runs[j];
+
+        if( up->x0 <= cur->x1 && cur->x0 <= up->x1 )
+            ia_ccl_union( l->runs, i, j );
+        /* move past whichever run ends first, the other can still touch the
+         * next run of the other row */
+        if( up->x1 < cur->x1 )
+            i++;
+        else
+            j++;
+    }
+}
+
+static int ia_ccl_band( ia_ccl_t* l, ia_cache_entry_t* luma, int threshold, int y0, int y1 )
+{
+    const int w = luma->i_width;
+    int x, y;
+
+    for( y = y0; y < y1; y++ )
+    {
+        const uint8_t* p = (uint8_t*) luma->data + y * luma->i_stride;
+
+        l->row[y] = l->i_runs;
+        for( x = 0; x < w; )
+        {
+            int x0;
+
+            while( x < w && p[x] <= threshold )
+                x++;
+            if( x == w )
+                break;
+            x0 = x;
+            while( x < w && p[x] > threshold )
+                x++;
+
+            if( l->i_runs == l->i_size ) {
+                ia_ccl_run_t* runs = realloc( l->runs, 2 * l->i_size * sizeof(ia_ccl_run_t) );
+                if( runs == NULL )
+                    return 1;
+                l->runs = runs;
+                l->i_size *= 2;
+            }
+            l->runs[l->i_runs].y = y;
+            l->runs[l->i_runs].x0 = x0;
+            l->runs[l->i_runs].x1 = x;
+            l->runs[l->i_runs].parent = l->i_runs;
+            l->i_runs++;
+        }
+        l->row[y+1] = l->i_runs;
+
+        if( y > y0 )
+            ia_ccl_connect( l, y );
+    }
+    return 0;
+}
+
+/* sums of a blob while it is being built, on the entry of its root */
+typedef struct ia_ccl_sum_t
+{
+    uint64_t    sum_x;
+    uint64_t    sum_y;
+    ia_blob_t   blob;
+} ia_ccl_sum_t;
+
+int ia_ccl_label( ia_ccl_t* l, ia_cache_entry_t* luma, int threshold, int min_area )
+{
+    const int h = luma->i_height;
+    ia_ccl_sum_t* sum;
+    int i, y;
+
+    l->i_runs = 0;
+    l->i_blobs = 0;
+    if( l->runs == NULL ) {
+        l->i_size = 1024;
+        if( (l->runs = ia_malloc( l->i_size * sizeof(ia_ccl_run_t) )) == NULL )
+            return 1;
+    }
+    if( l->i_rows < h+1 ) {
+        ia_free( l->row );
+        if( (l->row = ia_malloc( (h+1) * sizeof(int32_t) )) == NULL ) {
+            l->i_rows = 0;
+            return 1;
+        }
+        l->i_rows = h+1;
+    }
+    l->row[0] = 0;
+
+    for( y = 0; y < h; y += IA_CCL_BAND_ROWS )
+        if( ia_ccl_band( l, luma, threshold, y, y + IA_CCL_BAND_ROWS < h ? y + IA_CCL_BAND_ROWS : h ) )
+            return 1;
+    for( y = IA_CCL_BAND_ROWS; y < h; y += IA_CCL_BAND_ROWS )
+        ia_ccl_connect( l, y );
+
+    if( (sum = ia_malloc( (l->i_runs ? l->i_runs : 1) * sizeof(ia_ccl_sum_t) )) == NULL )
+        return 1;
+
+    /* roots come before the rest of their blob, so one pass in run order
+     * flattens the trees and sums everything up on the roots */
+    for( i = 0; i < l->i_runs; i++ )
+    {
+        ia_ccl_run_t* r = &l->runs[i];
+        const int32_t len = r->x1 - r->x0;
+        ia_ccl_sum_t* t;
+
+        r->parent = l->runs[r->parent].parent;
+        t = &sum[r->parent];
+        if( r->parent == i ) {
+            memset( t, 0, sizeof(ia_ccl_sum_t) );
+            t->blob.i_left = r->x0;
+            t->blob.i_top = r->y;
+            t->blob.i_right = r->x1 - 1;
+        }
+        t->blob.i_area += len;
+        t->sum_x += (uint64_t)len * (r->x0 + r->x1 - 1) / 2;
+        t->sum_y += (uint64_t)len * r->y;
+        t->blob.i_left = r->x0 < t->blob.i_left ? r->x0 : t->blob.i_left;
+        t->blob.i_right = r->x1 - 1 > t->blob.i_right ? r->x1 - 1 : t->blob.i_right;
+        t->blob.i_bottom = r->y;
+    }
+
+    /* there are at most as many blobs as runs */
+    if( l->i_blob_size < l->i_runs ) {
+        ia_free( l->blobs );
+        if( (l->blobs = ia_malloc( l->i_size * sizeof(ia_blob_t) )) == NULL ) {
+            l->i_blob_size = 0;
+            ia_free( sum );
+            return 1;
+        }
+        l->i_blob_size = l->i_size;
+    }
+
+    for( i = 0; i < l->i_runs; i++ )
+    {
+        ia_ccl_run_t* r = &l->runs[i];
+        ia_ccl_sum_t* t = &sum[i];
+
+        if( r->parent != i ) {
+            r->blob = l->runs[r->parent].blob;
+            continue;
+        }
+        if( t->blob.i_area < (uint32_t) min_area ) {
+            r->blob = -1;
+            continue;
+        }
+        t->blob.f_cx = (double) t->sum_x / t->blob.i_area;
+        t->blob.f_cy = (double) t->sum_y / t->blob.i_area;
+        r->blob = l->i_blobs;
+        l->blobs[l->i_blobs++] = t->blob;
+    }
+
+    ia_free( sum );
+    return 0;
+}
+
+void ia_ccl_free( ia_ccl_t* l )
+{
+    ia_free( l->runs );
+    ia_free( l->row );
+    ia_free( l->blobs );
+    memset( l, 0, sizeof(ia_ccl_t) );
+}
@@ -0,0 +1,57 @@
+#ifndef _H_CCL
+#define _H_CCL
+
+#include "common.h"
+#include "cache.h"
+
+/* a run of foreground pixels [x0,x1) on row y. parent links the runs of a
+ * blob towards the first of them in raster order, after ia_ccl_label it is
+ * that first run and blob is the index of the blob in ia_ccl_t.blobs, -1 if
+ * it was under the minimum area. */
+typedef struct ia_ccl_run_t
+{
+    int32_t     y;
+    int32_t     x0;
+    int32_t     x1;
+    int32_t     parent;
+    int32_t     blob;
+} ia_ccl_run_t;
+
+typedef struct ia_blob_t
+{
+    uint32_t    i_area;
+    double      f_cx;           // centroid
+    double      f_cy;
+    int32_t     i_left;         // bounding box, inclusive
+    int32_t     i_top;
+    int32_t     i_right;
+    int32_t     i_bottom;
+} ia_blob_t;
+
+/* 8-connected components of a thresholded luma plane. every band of
+ * IA_CCL_BAND_ROWS rows is run length encoded and its runs joined in a
+ * union-find on their own, then a merge step joins the bands across their
+ * seams, so the only pass over the pixels is the one finding the runs. */
+typedef struct ia_ccl_t
+{
+    ia_ccl_run_t* runs;
+    int32_t*    row;            // first run of each row and one past the last
+    int         i_runs;
+    int         i_size;         // runs allocated
+    int         i_rows;         // rows allocated
+    ia_blob_t*  blobs;          // in raster order of their first pixel
+    int         i_blobs;
+    int         i_blob_size;
+} ia_ccl_t;
+
+#define IA_CCL_BAND_ROWS 64
+
+/* labels the samples of luma above threshold and sums up the blobs of at
+ * least min_area samples. l must be zeroed before its first use and can be
+ * reused for the next frame.
+ * retval: 0 ok, 1 couldnt allocate */
+int ia_ccl_label( ia_ccl_t* l, ia_cache_entry_t* luma, int threshold, int min_area );
+
+void ia_ccl_free( ia_ccl_t* l );
+
+#endif
@@ -21,41 +21,90 @@
  *****************************************************************************/
 
 #include "common.h"
-#include <FreeImage.h>
+#include "numa.h"
+#include "cache.h"
+#include "tstats.h"
 
 ia_image_t* ia_image_create( size_t width, size_t height )
+{
+    return ia_image_create_node( width, height, -1 );
+}
+
+ia_image_t* ia_image_create_node( size_t width, size_t height, int node )
 {
     ia_image_t* iaf = calloc( 1, sizeof(ia_image_t) );
 
     if( iaf == NULL )
         return NULL;
 
-    iaf->dib = FreeImage_Allocate( width, height, 24,
-                              0, 0, 0 );
-    if( !iaf->dib )
-        return NULL;
-    iaf->pix = FreeImage_GetBits( (FIBITMAP*)iaf->dib );
-    if( iaf->pix == NULL )
+    iaf->i_width = width;
+    iaf->i_height = height;
+    iaf->i_pitch = (width*3 + IA_IMAGE_ALIGN-1) & ~(IA_IMAGE_ALIGN-1);
+    iaf->i_alloc = iaf->i_pitch * height;
+    iaf->b_bottom_up = true;
+    iaf->pix = ia_numa_alloc_node( iaf->i_alloc, node, &iaf->b_mapped );
+    if( iaf->pix == NULL ) {
+        ia_free( iaf );
         return NULL;
+    }
 
     pthread_mutex_init( &iaf->mutex, NULL );
     ia_pthread_cond_init( &iaf->cond_ro, NULL );
     ia_pthread_cond_init( &iaf->cond_rw, NULL );
 
     iaf->i_size = width*height*3;
-    iaf->i_pitch = FreeImage_GetPitch( (FIBITMAP*)iaf->dib );
 
     return iaf;
 }
 
 void ia_image_free( ia_image_t* iaf )
 {
+    ia_cache_flush( iaf );
+    ia_tstats_window_free( iaf->tstats );
     pthread_mutex_destroy( &iaf->mutex );
     pthread_cond_destroy( &iaf->cond_ro );
     pthread_cond_destroy( &iaf->cond_rw );
 
-    if( iaf->dib )
-        FreeImage_Unload( (FIBITMAP*)iaf->dib );
+    ia_numa_free( iaf->pix, iaf->i_alloc, iaf->b_mapped );
+    ia_free( iaf->encoded );
+    ia_free( iaf->planes );
     ia_free( iaf );
 }
 
+void ia_image_swap( ia_image_t* a, ia_image_t* b )
+{
+    ia_image_t t;
+
+    ia_cache_flush( a );
+    ia_cache_flush( b );
+
+    t.pix = a->pix;
+    t.i_pitch = a->i_pitch;
+    t.i_alloc = a->i_alloc;
+    t.b_mapped = a->b_mapped;
+    t.i_width = a->i_width;
+    t.i_height = a->i_height;
+    t.b_bottom_up = a->b_bottom_up;
+    t.planes = a->planes;
+    t.i_planes_hash = a->i_planes_hash;
+
+    a->pix = b->pix;
+    a->i_pitch = b->i_pitch;
+    a->i_alloc = b->i_alloc;
+    a->b_mapped = b->b_mapped;
+    a->i_width = b->i_width;
+    a->i_height = b->i_height;
+    a->b_bottom_up = b->b_bottom_up;
+    a->planes = b->planes;
+    a->i_planes_hash = b->i_planes_hash;
+
+    b->pix = t.pix;
+    b->i_pitch = t.i_pitch;
+    b->i_alloc = t.i_alloc;
+    b->b_mapped = t.b_mapped;
+    b->i_width = t.i_width;
+    b->i_height = t.i_height;
+    b->b_bottom_up = t.b_bottom_up;
+    b->planes = t.planes;
+    b->i_planes_hash = t.i_planes_hash;
+}
@@ -58,15 +58,43 @@ static const int debug = 0;
 #include <linux/videodev.h>
 #endif
 
+/* rows of ia_image_t start on this boundary */
+#define IA_IMAGE_ALIGN 64
+
+/* buffers at least this large are aligned to it and backed by huge pages
+ * when the kernel has them, see numa.h */
+#define IA_HUGEPAGE_SIZE (2*1024*1024)
+
+/* derived data ia_cache_get can attach to an image, see cache.h */
+typedef enum {
+    IA_CACHE_LUMA,          // uint8_t, 0.30*p0 + 0.59*p1 + 0.11*p2 like grayscale
+    IA_CACHE_INTEGRAL,      // uint32_t (w+1)x(h+1) sums of luma above and left
+    IA_CACHE_INTEGRAL2,     // uint64_t (w+1)x(h+1) sums of squared luma
+    IA_CACHE_INTEGRAL_BGR,  // uint32_t (w+1)x(h+1)x3 sums of each channel
+    IA_CACHE_GRAD_X,        // int16_t sobel of luma along rows
+    IA_CACHE_GRAD_Y,        // int16_t sobel of luma towards later rows of pix
+    IA_CACHE_PYR2,          // uint8_t luma averaged over 2x2 blocks
+    IA_CACHE_PYR4,          // uint8_t luma averaged over 4x4 blocks
+    IA_CACHE_PYR8,          // uint8_t luma averaged over 8x8 blocks
+    IA_CACHE_TILE_HIST,     // uint32_t 256 bin luma histogram of every tile, see cache.h
+    IA_CACHE_NUM
+} ia_cache_kind_t;
+
+struct ia_cache_entry_t;
+struct ia_tstats_window_t;
+
 /* ia_image_t: image data structure
  * i_frame: position of this frame in image stream
- * pix    : pixel data
+ * pix    : pixel data, BGR24, i_pitch bytes per row
+ * b_bottom_up : pix starts with the bottom row of the picture
  * name   : output name
  * thumbname : thumbnail name
  * users  : number of threads using this image
  * ready  : if input image  -> must be set to read data
  *          if output image -> must be set for system to save data
  * lock   : you must have this lock in order to write to this image
+ * cache  : derived data, built under mutex by ia_cache_get
+ * tstats : statistics of the ref window an output image is computed from
 */
 typedef struct ia_image_t
 {
@@ -76,11 +104,24 @@ typedef struct ia_image_t
     int32_t     i_refcount;
     uint64_t    i_size;
     uint64_t    i_pitch;
+    int32_t     i_width;
+    int32_t     i_height;
+    bool        b_bottom_up;
     ia_pixel_t* pix;
-    void*       dib;
+    uint64_t    i_alloc;    // bytes allocated at pix
+    bool        b_mapped;   // pix came from mmap, see ia_numa_alloc
+    uint8_t*    encoded;    // undecoded file, see iaio_freeimage_decode_image
+    uint64_t    i_encoded;
+    uint8_t*    planes;     // y4m frame as read, written out as is while pix matches it
+    uint64_t    i_planes_hash;  // ia_hash_image of pix when planes was read
     struct ia_image_t* next;
     struct ia_image_t* last;
     bool        eoi;
+    bool        b_drop;     // not written by the output stage, see --keyframes
+    bool        b_repeat;   // the previous output is written in its place, see --gate
+    bool        b_dup;      // its ref window is the same as the previous frame's, see --dedup
+    struct ia_cache_entry_t* cache[IA_CACHE_NUM];
+    struct ia_tstats_window_t* tstats;
     pthread_mutex_t mutex;
     pthread_cond_t cond_ro;
     pthread_cond_t cond_rw;
@@ -424,8 +465,27 @@ static inline void ia_pthread_error( int rc, char* a, char* b )
 }
 
 ia_image_t* ia_image_create( size_t width, size_t height );
+/* as ia_image_create with the pixels on numa node, see ia_numa_alloc_node */
+ia_image_t* ia_image_create_node( size_t width, size_t height, int node );
 void ia_image_free( ia_image_t* iaf );
 
+/* exchanges the pixel storage of a and b, with the planes they came from */
+void ia_image_swap( ia_image_t* a, ia_image_t* b );
+
+/* row y of the picture counted from the top, whatever the orientation */
+static inline ia_pixel_t* ia_image_row( ia_image_t* iaf, int y )
+{
+    if( iaf->b_bottom_up )
+        y = iaf->i_height - y - 1;
+    return iaf->pix + (size_t)y * iaf->i_pitch;
+}
+
+/* bytes from one picture row to the one below it, negative if bottom-up */
+static inline int ia_image_stride( ia_image_t* iaf )
+{
+    return iaf->b_bottom_up ? -(int)iaf->i_pitch : (int)iaf->i_pitch;
+}
+
 #define ia_error(format, ...) { if(debug) fprintf(stderr,format, ## __VA_ARGS__); }
 
 #endif
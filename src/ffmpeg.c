@@ -1,4 +1,5 @@
 #include "ffmpeg.h"
+#include <unistd.h>
 
 #ifdef HAVE_FFMPEG
 
@@ -9,11 +10,9 @@ ia_ffmpeg_t* ia_ffmpeg_init( const char* input )
     AVCodecContext *pCodecCtx;
     AVCodec *pCodec;
     AVFrame *pFrame;
-    AVFrame *pFrameRGB;
-    int numBytes;
-    uint8_t *buffer;
-    struct SwsContext *img_convert_ctx;
     ia_ffmpeg_t *ffio;
+    long cores;
+    int h_shift, v_shift;
 
     // Register all formats and codecs
     av_register_all();
@@ -62,36 +61,12 @@ ia_ffmpeg_t* ia_ffmpeg_init( const char* input )
 
     // Allocate video frame
     pFrame = avcodec_alloc_frame();
-
-    // Allocate an AVFrame structure
-    pFrameRGB=avcodec_alloc_frame();
-    if(pFrameRGB==NULL) {
+    if(pFrame==NULL) {
         fprintf(stderr, "Couldn't alloc an avcodec frame\n");
         return NULL;
     }
 
-    // Determine required buffer size and allocate buffer
-    numBytes=avpicture_get_size(PIX_FMT_BGR24, pCodecCtx->width,
-                                pCodecCtx->height);
-    buffer=(uint8_t *)av_malloc(numBytes*sizeof(uint8_t));
-
-    // Assign appropriate parts of buffer to image planes in pFrameRGB
-    // Note that pFrameRGB is an AVFrame, but AVFrame is a superset
-    // of AVPicture
-    avpicture_fill((AVPicture *)pFrameRGB, buffer, PIX_FMT_BGR24,
-                   pCodecCtx->width, pCodecCtx->height);
-
-    img_convert_ctx = sws_getContext(pCodecCtx->width, pCodecCtx->height,
-                                     pFormatCtx->streams[videoStream]->codec->pix_fmt,
-                                     pCodecCtx->width, pCodecCtx->height,
-                                     PIX_FMT_BGR24, SWS_BICUBIC,
-                                     NULL, NULL, NULL);
-    if(img_convert_ctx == NULL) {
-        fprintf(stderr, "Cannot initialize the conversion context!\n");
-        return NULL;
-    }
-
-    ffio = malloc (sizeof(ia_ffmpeg_t));
+    ffio = calloc (1, sizeof(ia_ffmpeg_t));
     if(!ffio) {
         fprintf(stderr, "Couldn't alloc an ffio object\n");
         return NULL;
@@ -102,32 +77,197 @@ ia_ffmpeg_t* ia_ffmpeg_init( const char* input )
     ffio->pCodecCtx = pCodecCtx;
     ffio->pCodec = pCodec;
     ffio->pFrame = pFrame;
-    ffio->pFrameRGB = pFrameRGB;
-    ffio->numBytes = numBytes;
-    ffio->buffer = buffer;
-    ffio->img_convert_ctx = img_convert_ctx;
     ffio->i_width = pCodecCtx->width;
     ffio->i_height = pCodecCtx->height;
     ffio->i_size = pCodecCtx->width * pCodecCtx->height;
+    ffio->i_frame = -1;
+    ffio->b_timestamps = false;
+
+    // Frame indexes are derived from timestamps, which needs the duration of
+    // one frame. r_frame_rate is the best guess, the codec time base is the
+    // fallback for containers that don't set it.
+    if(pFormatCtx->streams[videoStream]->r_frame_rate.num &&
+       pFormatCtx->streams[videoStream]->r_frame_rate.den) {
+        ffio->frame_duration.num = pFormatCtx->streams[videoStream]->r_frame_rate.den;
+        ffio->frame_duration.den = pFormatCtx->streams[videoStream]->r_frame_rate.num;
+    } else {
+        ffio->frame_duration = pCodecCtx->time_base;
+    }
+
+    // Split the colour conversion into horizontal bands, one per core. Every
+    // band gets its own context since a SwsContext can't be shared between
+    // threads. Paletted formats keep their palette in data[1] so they are
+    // always converted in one piece.
+    avcodec_get_chroma_sub_sample(pCodecCtx->pix_fmt, &h_shift, &v_shift);
+    ffio->i_chroma_shift = v_shift;
+    cores = sysconf(_SC_NPROCESSORS_ONLN);
+    ffio->i_slices = cores < 1 ? 1 : cores > IA_FFMPEG_MAX_SLICES ? IA_FFMPEG_MAX_SLICES : cores;
+    if(ffio->i_slices > pCodecCtx->height / IA_FFMPEG_MIN_SLICE_HEIGHT)
+        ffio->i_slices = pCodecCtx->height / IA_FFMPEG_MIN_SLICE_HEIGHT;
+    if(ffio->i_slices < 1 ||
+       pCodecCtx->pix_fmt == PIX_FMT_PAL8 ||
+       pCodecCtx->pix_fmt == PIX_FMT_RGB8 || pCodecCtx->pix_fmt == PIX_FMT_BGR8 ||
+       pCodecCtx->pix_fmt == PIX_FMT_RGB4_BYTE || pCodecCtx->pix_fmt == PIX_FMT_BGR4_BYTE)
+        ffio->i_slices = 1;
+
+    // band heights are kept a multiple of 16 so chroma rows never straddle
+    // two bands
+    ffio->i_slice_height = (pCodecCtx->height + ffio->i_slices - 1) / ffio->i_slices;
+    ffio->i_slice_height = (ffio->i_slice_height + 15) & ~15;
+    ffio->i_slices = (pCodecCtx->height + ffio->i_slice_height - 1) / ffio->i_slice_height;
+
+    for(i=0; i<ffio->i_slices; i++) {
+        int h = pCodecCtx->height - i*ffio->i_slice_height;
+        if(h > ffio->i_slice_height)
+            h = ffio->i_slice_height;
+
+        ffio->img_convert_ctx[i] = sws_getContext(pCodecCtx->width, h,
+                                                  pCodecCtx->pix_fmt,
+                                                  pCodecCtx->width, h,
+                                                  PIX_FMT_BGR24, SWS_BICUBIC,
+                                                  NULL, NULL, NULL);
+        if(ffio->img_convert_ctx[i] == NULL) {
+            fprintf(stderr, "Cannot initialize the conversion context!\n");
+            return NULL;
+        }
+    }
 
     return ffio;
 }
 
-void SaveFrame(AVFrame *pFrame, int width, int height, ia_image_t* iaf) {
-    int y;
-    for(y=0; y<height; y++)
-        memcpy(iaf->pix+y*pFrame->linesize[0], pFrame->data[0]+(height-y-1)*pFrame->linesize[0], width*3);
+typedef struct ia_ffmpeg_slice_t {
+    struct SwsContext *c;
+    uint8_t *src[4];
+    int     src_stride[4];
+    uint8_t *dst[4];
+    int     dst_stride[4];
+    int     h;
+} ia_ffmpeg_slice_t;
+
+static void* ia_ffmpeg_scale_slice( void* vptr )
+{
+    ia_ffmpeg_slice_t* sl = (ia_ffmpeg_slice_t*) vptr;
+    sws_scale(sl->c, sl->src, sl->src_stride, 0, sl->h, sl->dst, sl->dst_stride);
+    return NULL;
+}
+
+/* convert the decoded frame straight into iaf. for bottom-up images the
+ * destination starts at the last row and walks backwards with a negative
+ * stride, which flips the image for free. */
+static void ia_ffmpeg_convert_frame( ia_ffmpeg_t* ffio, ia_image_t* iaf )
+{
+    ia_ffmpeg_slice_t slices[IA_FFMPEG_MAX_SLICES];
+    pthread_t threads[IA_FFMPEG_MAX_SLICES];
+    int i, p, rc;
+
+    for(i=0; i<ffio->i_slices; i++) {
+        ia_ffmpeg_slice_t* sl = &slices[i];
+        int y = i*ffio->i_slice_height;
+
+        sl->c = ffio->img_convert_ctx[i];
+        sl->h = ffio->i_height - y;
+        if(sl->h > ffio->i_slice_height)
+            sl->h = ffio->i_slice_height;
+
+        for(p=0; p<4; p++) {
+            int row = (p == 1 || p == 2) ? y >> ffio->i_chroma_shift : y;
+            sl->src_stride[p] = ffio->pFrame->linesize[p];
+            sl->src[p] = ffio->pFrame->data[p]
+                         ? ffio->pFrame->data[p] + row*ffio->pFrame->linesize[p]
+                         : NULL;
+            sl->dst[p] = NULL;
+            sl->dst_stride[p] = 0;
+        }
+        sl->dst[0] = ia_image_row( iaf, y );
+        sl->dst_stride[0] = ia_image_stride( iaf );
+    }
+
+    // the first band is converted on this thread while the others run
+    for(i=1; i<ffio->i_slices; i++) {
+        if( 0 != (rc = pthread_create(&threads[i], NULL, &ia_ffmpeg_scale_slice, &slices[i])) ) {
+            ia_pthread_error( rc, "ia_ffmpeg_convert_frame()", "pthread_create()" );
+        }
+    }
+    ia_ffmpeg_scale_slice( &slices[0] );
+    for(i=1; i<ffio->i_slices; i++) {
+        if( 0 != (rc = pthread_join(threads[i], NULL)) ) {
+            ia_pthread_error( rc, "ia_ffmpeg_convert_frame()", "pthread_join()" );
+        }
+    }
+}
+
+/* converts a stream timestamp into a frame index, -1 if unknown */
+int64_t ia_ffmpeg_frame_index( ia_ffmpeg_t* ffio, int64_t ts )
+{
+    AVStream* st = ffio->pFormatCtx->streams[ffio->videoStream];
+
+    if(ts == AV_NOPTS_VALUE)
+        return -1;
+    if(st->start_time != AV_NOPTS_VALUE)
+        ts -= st->start_time;
+    return av_rescale_q(ts, st->time_base, ffio->frame_duration);
+}
+
+/* converts a frame index into a stream timestamp */
+static int64_t ia_ffmpeg_frame_timestamp( ia_ffmpeg_t* ffio, int64_t i_frame )
+{
+    AVStream* st = ffio->pFormatCtx->streams[ffio->videoStream];
+    int64_t ts = av_rescale_q(i_frame, ffio->frame_duration, st->time_base);
+
+    if(st->start_time != AV_NOPTS_VALUE)
+        ts += st->start_time;
+    return ts;
+}
+
+/* seek to the keyframe before i_frame if that is further along than where
+ * decoding currently is. without timestamps there is no way to tell where a
+ * seek landed, so nothing is done until the first frame carried a pts. */
+static void ia_ffmpeg_jump( ia_ffmpeg_t* ffio, int64_t i_frame )
+{
+    AVStream* st = ffio->pFormatCtx->streams[ffio->videoStream];
+    int64_t ts, key;
+    int k;
+
+    if(!ffio->b_timestamps || i_frame <= ffio->i_frame + 1)
+        return;
+
+    ts = ia_ffmpeg_frame_timestamp(ffio, i_frame);
+    k = av_index_search_timestamp(st, ts, AVSEEK_FLAG_BACKWARD);
+    if(k >= 0) {
+        key = ia_ffmpeg_frame_index(ffio, st->index_entries[k].timestamp);
+        if(key <= ffio->i_frame + 1)
+            return;
+    } else if(i_frame - ffio->i_frame < IA_FFMPEG_SEEK_DISTANCE) {
+        return;
+    }
+
+    if(av_seek_frame(ffio->pFormatCtx, ffio->videoStream, ts, AVSEEK_FLAG_BACKWARD) < 0)
+        return;
+    avcodec_flush_buffers(ffio->pCodecCtx);
 }
 
-int ia_ffmpeg_read_frame( ia_ffmpeg_t* ffio, ia_image_t* iaf )
+int ia_ffmpeg_read_frame( ia_ffmpeg_t* ffio, ia_image_t* iaf, int64_t i_frame )
 {
     AVPacket        packet;
     int             frameFinished;
+    int64_t         i_pkt, i_out;
+
+    ia_ffmpeg_jump(ffio, i_frame);
 
-    // Read frames and save to disk
     while(av_read_frame(ffio->pFormatCtx, &packet)>=0) {
         // Is this a packet from the video stream?
         if(packet.stream_index==ffio->videoStream) {
+            // Frames that will be dropped are only decoded if something
+            // else references them
+            i_pkt = ia_ffmpeg_frame_index(ffio, packet.pts);
+            ffio->pCodecCtx->skip_frame = (i_pkt >= 0 && i_pkt < i_frame)
+                                          ? AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+
+            // the decoder hands this back with the frame it belongs to,
+            // which may be a later call when frames are reordered
+            ffio->pCodecCtx->reordered_opaque =
+                packet.pts != AV_NOPTS_VALUE ? packet.pts : packet.dts;
+
             // Decode video frame
 #if LIBAVCODEC_VERSION_MAJOR <= 52 &&   \
     LIBAVCODEC_VERSION_MINOR <= 30 &&   \
@@ -140,29 +280,42 @@ int ia_ffmpeg_read_frame( ia_ffmpeg_t* ffio, ia_image_t* iaf )
 #endif
             // Did we get a video frame?
             if(frameFinished) {
-                // Convert the image from its native format to RGB
-                sws_scale(ffio->img_convert_ctx, ffio->pFrame->data, ffio->pFrame->linesize,
-                          0, ffio->pCodecCtx->height, ((AVPicture *)ffio->pFrameRGB)->data, ((AVPicture *)ffio->pFrameRGB)->linesize);
-
-                // Save the frame
-                SaveFrame(ffio->pFrameRGB, ffio->pCodecCtx->width,
-                          ffio->pCodecCtx->height, iaf);
-                break;
+                i_out = ia_ffmpeg_frame_index(ffio, ffio->pFrame->reordered_opaque);
+                if(i_out < 0) {
+                    // no timestamps, count frames instead
+                    i_out = ffio->i_frame + 1;
+                } else {
+                    ffio->b_timestamps = true;
+                }
+                ffio->i_frame = i_out;
+
+                if(i_out >= i_frame) {
+                    // Convert the image from its native format to BGR,
+                    // directly into the output image
+                    ia_ffmpeg_convert_frame(ffio, iaf);
+                    av_free_packet(&packet);
+                    return 0;
+                }
+
+                // still short of the wanted frame, see if a seek gets there
+                // faster now that we know where we are
+                av_free_packet(&packet);
+                ia_ffmpeg_jump(ffio, i_frame);
+                continue;
             }
         }
         // Free the packet that was allocated by av_read_frame
         av_free_packet(&packet);
     }
-    av_free_packet(&packet);
-    return 0;
+    return -1;
 }
 
 void ia_ffmpeg_close (ia_ffmpeg_t* ffio)
 {
-    ia_free( ffio->img_convert_ctx );
-    // Free the RGB image
-    av_free(ffio->buffer);
-    av_free(ffio->pFrameRGB);
+    int i;
+
+    for(i=0; i<ffio->i_slices; i++)
+        sws_freeContext( ffio->img_convert_ctx[i] );
 
     // Free the YUV frame
     av_free(ffio->pFrame);
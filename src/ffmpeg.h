@@ -9,24 +9,46 @@
 #include <libavformat/avformat.h>
 #include <libswscale/swscale.h>
 
+/* maximum number of horizontal bands a decoded frame is converted in */
+#define IA_FFMPEG_MAX_SLICES 8
+
+/* smallest band worth handing to its own thread */
+#define IA_FFMPEG_MIN_SLICE_HEIGHT 64
+
+/* when the demuxer has no keyframe index, gaps larger than this many frames
+ * are crossed with av_seek_frame instead of decoding through them */
+#define IA_FFMPEG_SEEK_DISTANCE 250
+
 typedef struct ia_ffmpeg_t {
     AVFormatContext *pFormatCtx;
     int             videoStream;
     AVCodecContext  *pCodecCtx;
     AVCodec         *pCodec;
     AVFrame         *pFrame;
-    AVFrame         *pFrameRGB;
-    int             numBytes;
-    uint8_t         *buffer;
-    struct SwsContext *img_convert_ctx;
+    int             i_slices;       // number of bands sws_scale runs on
+    int             i_slice_height; // rows per band (last band may be shorter)
+    int             i_chroma_shift; // vertical chroma subsampling of the source
+    struct SwsContext *img_convert_ctx[IA_FFMPEG_MAX_SLICES];
+    AVRational      frame_duration; // length of one frame in seconds
+    int64_t         i_frame;        // index of the last decoded frame, -1 if none
+    bool            b_timestamps;   // true once decoded frames carry a pts
     int i_width;
     int i_height;
     int i_size;
 } ia_ffmpeg_t;
 
 ia_ffmpeg_t* ia_ffmpeg_init( const char* file );
-int ia_ffmpeg_read_frame( ia_ffmpeg_t* ffio, ia_image_t* iaf );
+
+/* decodes the first frame whose index is at least i_frame into iaf, frames
+ * before it are skipped with as little decoding as possible. the index of
+ * the frame that was read is left in ffio->i_frame.
+ * retval: 0 ok, -1 end of file */
+int ia_ffmpeg_read_frame( ia_ffmpeg_t* ffio, ia_image_t* iaf, int64_t i_frame );
 void ia_ffmpeg_close (ia_ffmpeg_t* ffio);
+
+/* converts a timestamp of the video stream into a frame index, -1 if the
+ * timestamp is unknown */
+int64_t ia_ffmpeg_frame_index( ia_ffmpeg_t* ffio, int64_t ts );
 #endif
 
 #endif
@@ -0,0 +1,307 @@
+#include "ffmpeg_encode.h"
+#include <strings.h>
+
+#ifdef HAVE_FFMPEG
+
+typedef struct ia_ffmpeg_container_t {
+    const char  *ext;
+    enum CodecID codec_id;  // codec used unless one was asked for
+} ia_ffmpeg_container_t;
+
+static const ia_ffmpeg_container_t containers[] = {
+    { "avi", CODEC_ID_FFV1 },
+    { "mkv", CODEC_ID_FFV1 },
+    { "nut", CODEC_ID_FFV1 },
+    { "mov", CODEC_ID_H264 },
+    { "mp4", CODEC_ID_H264 },
+    { NULL,  CODEC_ID_NONE }
+};
+
+static const ia_ffmpeg_container_t* ia_ffmpeg_enc_container( const char* file )
+{
+    const char* ext = strrchr( file, '.' );
+    int i;
+
+    if( ext == NULL )
+        return NULL;
+    for( i = 0; containers[i].ext != NULL; i++ )
+        if( !strcasecmp(ext+1, containers[i].ext) )
+            return &containers[i];
+    return NULL;
+}
+
+bool ia_ffmpeg_enc_is_video( const char* file )
+{
+    return ia_ffmpeg_enc_container( file ) != NULL;
+}
+
+static enum CodecID ia_ffmpeg_enc_codec( const char* codec, enum CodecID fallback )
+{
+    if( codec == NULL || *codec == '\0' )
+        return fallback;
+    if( !strcasecmp(codec, "ffv1") )
+        return CODEC_ID_FFV1;
+    if( !strcasecmp(codec, "h264") || !strcasecmp(codec, "x264") )
+        return CODEC_ID_H264;
+    if( !strcasecmp(codec, "mpeg4") )
+        return CODEC_ID_MPEG4;
+    return CODEC_ID_NONE;
+}
+
+static int ia_ffmpeg_enc_add_stream( ia_ffmpeg_enc_t* enc, ia_ffmpeg_enc_stream_t* s,
+                                     enum CodecID codec_id, int width, int height,
+                                     AVRational fps )
+{
+    AVCodecContext *c;
+
+    s->st = av_new_stream( enc->oc, enc->oc->nb_streams );
+    if( s->st == NULL ) {
+        fprintf( stderr, "ia_ffmpeg_enc_add_stream(): couldnt alloc stream\n" );
+        return -1;
+    }
+
+    c = s->st->codec;
+    c->codec_id = codec_id;
+    c->codec_type = CODEC_TYPE_VIDEO;
+    c->width = width;
+    c->height = height;
+    c->time_base.num = fps.den;
+    c->time_base.den = fps.num;
+
+    if( codec_id == CODEC_ID_FFV1 ) {
+        // FFV1 codes RGB losslessly, so the BGR frames come back bit exact
+        c->pix_fmt = PIX_FMT_RGB32;
+    } else {
+        c->pix_fmt = PIX_FMT_YUV420P;
+        c->gop_size = 250;
+        c->bit_rate = width * height * 4;
+    }
+
+    // some formats want stream headers to be separate
+    if( enc->oc->oformat->flags & AVFMT_GLOBALHEADER )
+        c->flags |= CODEC_FLAG_GLOBAL_HEADER;
+
+    s->i_width = width;
+    s->i_height = height;
+    return 0;
+}
+
+static int ia_ffmpeg_enc_open_stream( ia_ffmpeg_enc_stream_t* s, int src_width,
+                                      int src_height, int i_threads )
+{
+    AVCodecContext *c = s->st->codec;
+    AVCodec *codec;
+    int size;
+
+    codec = avcodec_find_encoder( c->codec_id );
+    if( codec == NULL ) {
+        fprintf( stderr, "ia_ffmpeg_enc_open_stream(): encoder not found\n" );
+        return -1;
+    }
+
+    if( i_threads > 1 )
+        avcodec_thread_init( c, i_threads );
+
+    if( avcodec_open(c, codec) < 0 ) {
+        fprintf( stderr, "ia_ffmpeg_enc_open_stream(): couldnt open encoder\n" );
+        return -1;
+    }
+
+    // a lossless frame can end up larger than the raw picture
+    s->outbuf_size = s->i_width * s->i_height * 8 + 16384;
+    s->outbuf = av_malloc( s->outbuf_size );
+
+    s->pFrame = avcodec_alloc_frame();
+    size = avpicture_get_size( c->pix_fmt, s->i_width, s->i_height );
+    s->picture = av_malloc( size );
+    if( s->outbuf == NULL || s->pFrame == NULL || s->picture == NULL ) {
+        fprintf( stderr, "ia_ffmpeg_enc_open_stream(): couldnt alloc frame\n" );
+        return -1;
+    }
+    avpicture_fill( (AVPicture *)s->pFrame, s->picture, c->pix_fmt,
+                    s->i_width, s->i_height );
+
+    s->img_convert_ctx = sws_getContext( src_width, src_height, PIX_FMT_BGR24,
+                                         s->i_width, s->i_height, c->pix_fmt,
+                                         (src_width == s->i_width) ? SWS_BICUBIC : SWS_AREA,
+                                         NULL, NULL, NULL );
+    if( s->img_convert_ctx == NULL ) {
+        fprintf( stderr, "ia_ffmpeg_enc_open_stream(): cannot initialize the conversion context\n" );
+        return -1;
+    }
+
+    return 0;
+}
+
+/* encode frame (or flush one delayed frame if frame is NULL)
+ * retval: size of the packet written, -1 on error */
+static int ia_ffmpeg_enc_encode( ia_ffmpeg_enc_t* enc, ia_ffmpeg_enc_stream_t* s,
+                                 AVFrame* frame )
+{
+    AVCodecContext *c = s->st->codec;
+    AVPacket pkt;
+    int out_size;
+
+    out_size = avcodec_encode_video( c, s->outbuf, s->outbuf_size, frame );
+    if( out_size <= 0 )
+        return out_size;
+
+    av_init_packet( &pkt );
+    if( c->coded_frame->pts != AV_NOPTS_VALUE )
+        pkt.pts = av_rescale_q( c->coded_frame->pts, c->time_base, s->st->time_base );
+    if( c->coded_frame->key_frame )
+        pkt.flags |= PKT_FLAG_KEY;
+    pkt.stream_index = s->st->index;
+    pkt.data = s->outbuf;
+    pkt.size = out_size;
+
+    if( av_interleaved_write_frame(enc->oc, &pkt) != 0 ) {
+        fprintf( stderr, "ia_ffmpeg_enc_encode(): error while writing frame\n" );
+        return -1;
+    }
+    return out_size;
+}
+
+static void ia_ffmpeg_enc_close_stream( ia_ffmpeg_enc_stream_t* s )
+{
+    if( s->st == NULL )
+        return;
+    avcodec_close( s->st->codec );
+    if( s->img_convert_ctx )
+        sws_freeContext( s->img_convert_ctx );
+    av_free( s->picture );
+    av_free( s->pFrame );
+    av_free( s->outbuf );
+}
+
+ia_ffmpeg_enc_t* ia_ffmpeg_enc_open( const char* file, const char* codec,
+                                     int width, int height, AVRational fps,
+                                     bool b_thumbnail, int i_threads )
+{
+    const ia_ffmpeg_container_t* container;
+    AVOutputFormat *fmt;
+    ia_ffmpeg_enc_t *enc;
+    enum CodecID codec_id;
+
+    av_register_all();
+
+    container = ia_ffmpeg_enc_container( file );
+    if( container == NULL ) {
+        fprintf( stderr, "ia_ffmpeg_enc_open(): unknown container %s\n", file );
+        return NULL;
+    }
+    codec_id = ia_ffmpeg_enc_codec( codec, container->codec_id );
+    if( codec_id == CODEC_ID_NONE ) {
+        fprintf( stderr, "ia_ffmpeg_enc_open(): unknown codec %s\n", codec );
+        return NULL;
+    }
+
+    fmt = guess_format( NULL, file, NULL );
+    if( fmt == NULL ) {
+        fprintf( stderr, "ia_ffmpeg_enc_open(): couldnt deduce output format from %s\n", file );
+        return NULL;
+    }
+
+    enc = calloc( 1, sizeof(ia_ffmpeg_enc_t) );
+    if( enc == NULL )
+        return NULL;
+
+    enc->oc = avformat_alloc_context();
+    if( enc->oc == NULL ) {
+        fprintf( stderr, "ia_ffmpeg_enc_open(): couldnt alloc format context\n" );
+        return NULL;
+    }
+    enc->oc->oformat = fmt;
+    snprintf( enc->oc->filename, sizeof(enc->oc->filename), "%s", file );
+    enc->b_thumbnail = b_thumbnail;
+
+    if( ia_ffmpeg_enc_add_stream(enc, &enc->video, codec_id, width, height, fps) )
+        return NULL;
+
+    if( b_thumbnail ) {
+        // same aspect as the frames with the longer side IA_FFMPEG_THUMB_SIZE,
+        // rounded to even sizes for the 4:2:0 codecs
+        int tw = width >= height ? IA_FFMPEG_THUMB_SIZE : width * IA_FFMPEG_THUMB_SIZE / height;
+        int th = width >= height ? height * IA_FFMPEG_THUMB_SIZE / width : IA_FFMPEG_THUMB_SIZE;
+        tw = tw < 2 ? 2 : tw & ~1;
+        th = th < 2 ? 2 : th & ~1;
+        if( ia_ffmpeg_enc_add_stream(enc, &enc->thumb, codec_id, tw, th, fps) )
+            return NULL;
+    }
+
+    if( av_set_parameters(enc->oc, NULL) < 0 ) {
+        fprintf( stderr, "ia_ffmpeg_enc_open(): invalid output format parameters\n" );
+        return NULL;
+    }
+
+    if( ia_ffmpeg_enc_open_stream(&enc->video, width, height, i_threads) )
+        return NULL;
+    if( b_thumbnail && ia_ffmpeg_enc_open_stream(&enc->thumb, width, height, i_threads) )
+        return NULL;
+
+    if( !(fmt->flags & AVFMT_NOFILE) ) {
+        if( url_fopen(&enc->oc->pb, file, URL_WRONLY) < 0 ) {
+            fprintf( stderr, "ia_ffmpeg_enc_open(): couldnt open %s\n", file );
+            return NULL;
+        }
+    }
+
+    if( av_write_header(enc->oc) < 0 ) {
+        fprintf( stderr, "ia_ffmpeg_enc_open(): couldnt write header to %s\n", file );
+        return NULL;
+    }
+
+    return enc;
+}
+
+int ia_ffmpeg_enc_write( ia_ffmpeg_enc_t* enc, ia_image_t* iar )
+{
+    ia_ffmpeg_enc_stream_t* streams[2] = { &enc->video, &enc->thumb };
+    int i;
+
+    for( i = 0; i < (enc->b_thumbnail ? 2 : 1); i++ ) {
+        ia_ffmpeg_enc_stream_t* s = streams[i];
+        // start at the top row and walk down, backwards through memory for
+        // bottom-up frames, so the encoder gets them the right way up
+        uint8_t* src[4] = { ia_image_row(iar, 0), NULL, NULL, NULL };
+        int src_stride[4] = { ia_image_stride(iar), 0, 0, 0 };
+
+        sws_scale( s->img_convert_ctx, src, src_stride, 0, iar->i_height,
+                   s->pFrame->data, s->pFrame->linesize );
+        s->pFrame->pts = enc->i_frame;
+
+        if( ia_ffmpeg_enc_encode(enc, s, s->pFrame) < 0 )
+            return -1;
+    }
+
+    enc->i_frame++;
+    return 0;
+}
+
+void ia_ffmpeg_enc_close( ia_ffmpeg_enc_t* enc )
+{
+    unsigned int i;
+
+    // get the frames the encoders are still holding on to
+    while( ia_ffmpeg_enc_encode(enc, &enc->video, NULL) > 0 );
+    if( enc->b_thumbnail )
+        while( ia_ffmpeg_enc_encode(enc, &enc->thumb, NULL) > 0 );
+
+    av_write_trailer( enc->oc );
+
+    ia_ffmpeg_enc_close_stream( &enc->video );
+    ia_ffmpeg_enc_close_stream( &enc->thumb );
+
+    for( i = 0; i < enc->oc->nb_streams; i++ ) {
+        av_freep( &enc->oc->streams[i]->codec );
+        av_freep( &enc->oc->streams[i] );
+    }
+
+    if( !(enc->oc->oformat->flags & AVFMT_NOFILE) )
+        url_fclose( enc->oc->pb );
+
+    av_free( enc->oc );
+    ia_free( enc );
+}
+
+#endif
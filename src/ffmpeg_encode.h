@@ -0,0 +1,52 @@
+#ifndef _H_FFMPEG_ENCODE
+#define _H_FFMPEG_ENCODE
+
+#include "common.h"
+
+#ifdef HAVE_FFMPEG
+#include "ffmpeg.h"
+
+/* longest side of the thumbnail stream, same as the thumbnail images */
+#define IA_FFMPEG_THUMB_SIZE 100
+
+/* one encoded video stream of an ia_ffmpeg_enc_t */
+typedef struct ia_ffmpeg_enc_stream_t {
+    AVStream        *st;
+    AVFrame         *pFrame;        // frame in the encoders pixel format
+    uint8_t         *picture;       // pixel data of pFrame
+    uint8_t         *outbuf;        // encoded packet
+    int             outbuf_size;
+    struct SwsContext *img_convert_ctx;
+    int             i_width;
+    int             i_height;
+} ia_ffmpeg_enc_stream_t;
+
+/* writes processed frames into a video container instead of one image file
+ * per frame. the container is picked from the file name, the codec defaults
+ * to lossless FFV1 unless the container wants H.264. */
+typedef struct ia_ffmpeg_enc_t {
+    AVFormatContext *oc;
+    ia_ffmpeg_enc_stream_t video;
+    ia_ffmpeg_enc_stream_t thumb;   // optional low resolution second stream
+    bool            b_thumbnail;
+    int64_t         i_frame;
+} ia_ffmpeg_enc_t;
+
+/* returns true if file names a container ia can encode into */
+bool ia_ffmpeg_enc_is_video( const char* file );
+
+/* opens file for writing. codec may be NULL or "" to pick one from the
+ * container, fps is the frame rate as a fraction. */
+ia_ffmpeg_enc_t* ia_ffmpeg_enc_open( const char* file, const char* codec,
+                                     int width, int height, AVRational fps,
+                                     bool b_thumbnail, int i_threads );
+
+/* encodes one frame
+ * retval: 0 ok, -1 error */
+int ia_ffmpeg_enc_write( ia_ffmpeg_enc_t* enc, ia_image_t* iar );
+
+/* flushes delayed frames and finishes the file */
+void ia_ffmpeg_enc_close( ia_ffmpeg_enc_t* enc );
+#endif
+
+#endif
@@ -0,0 +1,397 @@
+#include "ffmpeg_shard.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_FFMPEG
+
+typedef struct ia_ffmpeg_shard_job_t {
+    ia_ffmpeg_shard_t*  shard;
+    int                 w;
+} ia_ffmpeg_shard_job_t;
+
+static int ia_ffmpeg_shard_cmp( const void* a, const void* b )
+{
+    int64_t x = *(const int64_t*)a;
+    int64_t y = *(const int64_t*)b;
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+/* the index is cached in <file>.keyframes and is only trusted if the size and
+ * modification time of the video still match
+ * retval: 0 ok, 1 no usable cache */
+static int ia_ffmpeg_shard_load_index( ia_ffmpeg_shard_t* shard )
+{
+    char name[1031+10];
+    struct stat st;
+    long long size, mtime, frames;
+    int i, count;
+    FILE* filp;
+
+    if( stat(shard->file, &st) )
+        return 1;
+
+    snprintf( name, sizeof(name), "%s.keyframes", shard->file );
+    if( NULL == (filp = fopen(name, "r")) )
+        return 1;
+
+    if( 8 != fscanf(filp, "ia-keyframes %lld %lld %d %d %d %d %lld %d\n", &size, &mtime,
+                    &shard->i_width, &shard->i_height, &shard->frame_duration.num,
+                    &shard->frame_duration.den, &frames, &count)
+        || size != (long long)st.st_size || mtime != (long long)st.st_mtime
+        || count <= 0 ) {
+        fclose( filp );
+        return 1;
+    }
+
+    shard->keyframes = malloc( sizeof(int64_t)*count );
+    if( shard->keyframes == NULL ) {
+        fclose( filp );
+        return 1;
+    }
+    for( i = 0; i < count; i++ ) {
+        long long k;
+        if( 1 != fscanf(filp, "%lld\n", &k) ) {
+            ia_free( shard->keyframes );
+            shard->keyframes = NULL;
+            fclose( filp );
+            return 1;
+        }
+        shard->keyframes[i] = k;
+    }
+    fclose( filp );
+
+    shard->i_keyframes = count;
+    shard->i_frames = frames;
+    return 0;
+}
+
+/* the cache is only an optimization, failing to write it (e.g. the video is
+ * on a read only share) is not an error */
+static void ia_ffmpeg_shard_save_index( ia_ffmpeg_shard_t* shard )
+{
+    char name[1031+10];
+    struct stat st;
+    FILE* filp;
+    int i;
+
+    if( stat(shard->file, &st) )
+        return;
+
+    snprintf( name, sizeof(name), "%s.keyframes", shard->file );
+    if( NULL == (filp = fopen(name, "w")) )
+        return;
+
+    fprintf( filp, "ia-keyframes %lld %lld %d %d %d %d %lld %d\n",
+             (long long)st.st_size, (long long)st.st_mtime,
+             shard->i_width, shard->i_height,
+             shard->frame_duration.num, shard->frame_duration.den,
+             (long long)shard->i_frames, shard->i_keyframes );
+    for( i = 0; i < shard->i_keyframes; i++ )
+        fprintf( filp, "%lld\n", (long long)shard->keyframes[i] );
+    fclose( filp );
+}
+
+/* scan every packet of the video stream without decoding it and note the
+ * frame index of each keyframe
+ * retval: 0 ok, 1 file can't be indexed */
+static int ia_ffmpeg_shard_build_index( ia_ffmpeg_shard_t* shard )
+{
+    ia_ffmpeg_t* ffio;
+    AVPacket packet;
+    int64_t idx;
+    int size = 256;
+
+    if( NULL == (ffio = ia_ffmpeg_init(shard->file)) )
+        return 1;
+
+    shard->i_width = ffio->i_width;
+    shard->i_height = ffio->i_height;
+    shard->frame_duration = ffio->frame_duration;
+    shard->i_keyframes = 0;
+    shard->i_frames = 0;
+    shard->keyframes = malloc( sizeof(int64_t)*size );
+    if( shard->keyframes == NULL ) {
+        ia_ffmpeg_close( ffio );
+        return 1;
+    }
+
+    while( av_read_frame(ffio->pFormatCtx, &packet) >= 0 ) {
+        if( packet.stream_index == ffio->videoStream ) {
+            idx = ia_ffmpeg_frame_index( ffio, packet.pts != AV_NOPTS_VALUE
+                                               ? packet.pts : packet.dts );
+            if( idx < 0 ) {
+                fprintf( stderr, "ia_ffmpeg_shard_build_index(): %s has no timestamps\n", shard->file );
+                av_free_packet( &packet );
+                ia_ffmpeg_close( ffio );
+                return 1;
+            }
+
+            if( packet.flags & PKT_FLAG_KEY ) {
+                if( shard->i_keyframes == size ) {
+                    int64_t* tmp = realloc( shard->keyframes, sizeof(int64_t)*size*2 );
+                    if( tmp == NULL ) {
+                        av_free_packet( &packet );
+                        ia_ffmpeg_close( ffio );
+                        return 1;
+                    }
+                    shard->keyframes = tmp;
+                    size *= 2;
+                }
+                shard->keyframes[shard->i_keyframes++] = idx;
+            }
+
+            if( idx >= shard->i_frames )
+                shard->i_frames = idx+1;
+        }
+        av_free_packet( &packet );
+    }
+    ia_ffmpeg_close( ffio );
+
+    if( shard->i_keyframes == 0 )
+        return 1;
+
+    /* keyframes arrive in decode order, put them in display order */
+    qsort( shard->keyframes, shard->i_keyframes, sizeof(int64_t), &ia_ffmpeg_shard_cmp );
+
+    ia_ffmpeg_shard_save_index( shard );
+    return 0;
+}
+
+/* group whole GOPs into shards of at least IA_SHARD_MIN_FRAMES frames and
+ * drop the ones outside of [i_start, i_end).
+ *
+ * shards are not decoded with any overlap: every frame comes out of exactly
+ * one worker and the reader puts them back into source order before they
+ * reach the ref list, so the i_maxrefs-1 frames a temporal filter needs from
+ * the previous shard are already there. */
+static int ia_ffmpeg_shard_split( ia_ffmpeg_shard_t* shard )
+{
+    int k, next;
+
+    shard->shards = malloc( sizeof(ia_ffmpeg_shard_range_t)*shard->i_keyframes );
+    if( shard->shards == NULL )
+        return 1;
+
+    shard->i_shards = 0;
+    for( k = 0; k < shard->i_keyframes; k = next ) {
+        ia_ffmpeg_shard_range_t r;
+
+        /* anything before the first keyframe belongs to the first shard */
+        r.i_start = k ? shard->keyframes[k] : 0;
+        for( next = k+1; next < shard->i_keyframes
+                         && shard->keyframes[next] - r.i_start < IA_SHARD_MIN_FRAMES; next++ );
+        r.i_end = next < shard->i_keyframes ? shard->keyframes[next] : shard->i_frames;
+
+        if( r.i_end <= shard->i_start || (shard->i_end && r.i_start >= shard->i_end)
+            || r.i_start >= r.i_end )
+            continue;
+        shard->shards[shard->i_shards++] = r;
+    }
+
+    return shard->i_shards ? 0 : 1;
+}
+
+static bool ia_ffmpeg_shard_stopped( ia_ffmpeg_shard_t* shard )
+{
+    bool b_stop;
+
+    pthread_mutex_lock( &shard->mutex );
+    b_stop = shard->b_stop;
+    pthread_mutex_unlock( &shard->mutex );
+
+    return b_stop;
+}
+
+static void* ia_ffmpeg_shard_worker( void* vptr )
+{
+    ia_ffmpeg_shard_job_t* job = (ia_ffmpeg_shard_job_t*) vptr;
+    ia_ffmpeg_shard_t* shard = job->shard;
+    ia_queue_t* q = shard->queues[job->w];
+    ia_ffmpeg_t* ffio;
+    ia_image_t* iaf;
+    int s;
+
+    ffio = ia_ffmpeg_init( shard->file );
+    if( ffio == NULL )
+        fprintf( stderr, "ia_ffmpeg_shard_worker(): couldnt open %s\n", shard->file );
+    else
+        /* the keyframe index was built from timestamps, so seeking to the
+         * first shard is safe before any frame was decoded */
+        ffio->b_timestamps = true;
+
+    for( s = job->w; s < shard->i_shards; s += shard->i_workers ) {
+        ia_ffmpeg_shard_range_t* r = &shard->shards[s];
+        int64_t next = shard->i_start;
+
+        /* first frame of the shard that is on the step grid */
+        if( r->i_start > next )
+            next += (r->i_start - next + shard->i_step - 1) / shard->i_step * shard->i_step;
+
+        while( ffio && next < r->i_end && (!shard->i_end || next < shard->i_end)
+               && !ia_ffmpeg_shard_stopped(shard) ) {
+            iaf = ia_image_create( shard->i_width, shard->i_height );
+            if( iaf == NULL )
+                break;
+
+            if( ia_ffmpeg_read_frame(ffio, iaf, next) < 0
+                || ffio->i_frame >= r->i_end
+                || (shard->i_end && ffio->i_frame >= shard->i_end) ) {
+                ia_image_free( iaf );
+                break;
+            }
+
+            iaf->i_frame = ffio->i_frame;
+            ia_queue_push( q, iaf, iaf->i_frame );
+            next = ffio->i_frame + shard->i_step;
+        }
+
+        /* tell the reader this shard is complete */
+        iaf = ia_image_create( shard->i_width, shard->i_height );
+        if( iaf == NULL || ia_ffmpeg_shard_stopped(shard) ) {
+            if( iaf )
+                ia_image_free( iaf );
+            break;
+        }
+        iaf->eoi = true;
+        ia_queue_push( q, iaf, r->i_end );
+    }
+
+    if( ffio )
+        ia_ffmpeg_close( ffio );
+
+    /* NULL marks the end of the worker, the reader takes one that comes
+     * before the last shard is complete as the end of the input */
+    ia_queue_push( q, NULL, shard->i_frames );
+
+    ia_free( job );
+    return NULL;
+}
+
+ia_ffmpeg_shard_t* ia_ffmpeg_shard_open( const char* file, int i_workers,
+                                         int64_t i_start, int64_t i_end,
+                                         int64_t i_step )
+{
+    ia_ffmpeg_shard_t* shard;
+    ia_ffmpeg_shard_job_t* jobs[IA_SHARD_MAX_WORKERS] = { NULL };
+    int w, rc;
+
+    shard = calloc( 1, sizeof(ia_ffmpeg_shard_t) );
+    if( shard == NULL )
+        return NULL;
+
+    strncpy( shard->file, file, 1030 );
+    shard->i_start = i_start;
+    shard->i_end = i_end;
+    shard->i_step = i_step > 0 ? i_step : 1;
+    shard->i_frame = -1;
+    shard->i_workers = i_workers > IA_SHARD_MAX_WORKERS ? IA_SHARD_MAX_WORKERS : i_workers;
+
+    if( ia_ffmpeg_shard_load_index(shard) && ia_ffmpeg_shard_build_index(shard) ) {
+        ia_free( shard->keyframes );
+        ia_free( shard );
+        return NULL;
+    }
+    shard->i_size = shard->i_width * shard->i_height;
+
+    if( ia_ffmpeg_shard_split(shard) ) {
+        ia_free( shard->shards );
+        ia_free( shard->keyframes );
+        ia_free( shard );
+        return NULL;
+    }
+    if( shard->i_workers > shard->i_shards )
+        shard->i_workers = shard->i_shards;
+
+    /* everything the workers need is allocated before the first one starts,
+     * so a failure has no running worker to stop */
+    for( w = 0; w < shard->i_workers; w++ ) {
+        jobs[w] = malloc( sizeof(ia_ffmpeg_shard_job_t) );
+        shard->queues[w] = ia_queue_open( IA_SHARD_QUEUE_SIZE, 0 );
+        if( jobs[w] == NULL || shard->queues[w] == NULL ) {
+            fprintf( stderr, "ERROR: ia_ffmpeg_shard_open(): couldnt alloc worker %d\n", w );
+            for( ; w >= 0; w-- ) {
+                ia_free( jobs[w] );
+                if( shard->queues[w] )
+                    ia_queue_close( shard->queues[w] );
+            }
+            ia_free( shard->shards );
+            ia_free( shard->keyframes );
+            ia_free( shard );
+            return NULL;
+        }
+        jobs[w]->shard = shard;
+        jobs[w]->w = w;
+    }
+
+    pthread_mutex_init( &shard->mutex, NULL );
+
+    for( w = 0; w < shard->i_workers; w++ ) {
+        if( 0 != (rc = ia_pthread_create( &shard->workers[w], NULL, &ia_ffmpeg_shard_worker, (void*) jobs[w] )) )
+            ia_pthread_error( rc, "ia_ffmpeg_shard_open()", "ia_pthread_create()" );
+    }
+
+    return shard;
+}
+
+int ia_ffmpeg_shard_read_frame( ia_ffmpeg_shard_t* shard, ia_image_t* iaf )
+{
+    ia_image_t* iar;
+
+    while( shard->i_shard < shard->i_shards ) {
+        const int w = shard->i_shard % shard->i_workers;
+
+        iar = ia_queue_pop( shard->queues[w] );
+        if( iar == NULL ) {
+            fprintf( stderr, "ERROR: ia_ffmpeg_shard_read_frame(): decoder %d stopped early\n", w );
+            shard->b_done[w] = true;
+            shard->i_shard = shard->i_shards;
+            break;
+        }
+        if( iar->eoi ) {
+            ia_image_free( iar );
+            shard->i_shard++;
+            continue;
+        }
+
+        /* hand the decoded pixels over to iaf, the old ones go away with
+         * iar */
+        ia_image_swap( iaf, iar );
+        shard->i_frame = iar->i_frame;
+        ia_image_free( iar );
+        return 0;
+    }
+
+    return -1;
+}
+
+void ia_ffmpeg_shard_close( ia_ffmpeg_shard_t* shard )
+{
+    ia_image_t* iar;
+    int w, rc;
+
+    pthread_mutex_lock( &shard->mutex );
+    shard->b_stop = true;
+    pthread_mutex_unlock( &shard->mutex );
+
+    for( w = 0; w < shard->i_workers; w++ ) {
+        /* a worker may be blocked on a full queue, keep draining it until
+         * its end marker comes out */
+        while( !shard->b_done[w] ) {
+            if( (iar = ia_queue_pop( shard->queues[w] )) == NULL )
+                shard->b_done[w] = true;
+            else
+                ia_image_free( iar );
+        }
+
+        if( 0 != (rc = ia_pthread_join( shard->workers[w], NULL )) )
+            ia_pthread_error( rc, "ia_ffmpeg_shard_close()", "ia_pthread_join()" );
+        ia_queue_close( shard->queues[w] );
+    }
+
+    pthread_mutex_destroy( &shard->mutex );
+    ia_free( shard->shards );
+    ia_free( shard->keyframes );
+    ia_free( shard );
+}
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef _H_FFMPEG_SHARD
+#define _H_FFMPEG_SHARD
+
+#include "common.h"
+
+#ifdef HAVE_FFMPEG
+#include "ffmpeg.h"
+#include "queue.h"
+
+/* most decoders that can run in parallel */
+#define IA_SHARD_MAX_WORKERS 16
+
+/* frames a worker decodes ahead of the reader */
+#define IA_SHARD_QUEUE_SIZE 64
+
+/* consecutive keyframes are merged until a shard is at least this long */
+#define IA_SHARD_MIN_FRAMES 32
+
+/* a run of whole GOPs, [i_start, i_end) in source frame indexes */
+typedef struct ia_ffmpeg_shard_range_t {
+    int64_t i_start;
+    int64_t i_end;
+} ia_ffmpeg_shard_range_t;
+
+/* decodes one video file with several ia_ffmpeg_t objects at once. the file
+ * is cut into shards at keyframes, worker w decodes shards w, w+workers, ...
+ * into its own queue and ia_ffmpeg_shard_read_frame hands the frames out in
+ * source order again. */
+typedef struct ia_ffmpeg_shard_t {
+    char                        file[1031];
+    int64_t*                    keyframes;      // frame index of every keyframe
+    int                         i_keyframes;
+    int64_t                     i_frames;       // frames in the file
+
+    ia_ffmpeg_shard_range_t*    shards;
+    int                         i_shards;
+    int                         i_shard;        // shard the reader is on
+
+    int64_t                     i_start;        // first frame to read
+    int64_t                     i_end;          // stop before this frame, 0 = never
+    int64_t                     i_step;         // read every i_step'th frame
+    int64_t                     i_frame;        // index of the last frame read
+
+    int                         i_width;
+    int                         i_height;
+    int                         i_size;
+    AVRational                  frame_duration; // length of one frame in seconds
+
+    int                         i_workers;
+    pthread_t                   workers[IA_SHARD_MAX_WORKERS];
+    ia_queue_t*                 queues[IA_SHARD_MAX_WORKERS];
+    bool                        b_done[IA_SHARD_MAX_WORKERS]; // end marker of the worker was popped
+    bool                        b_stop;
+    pthread_mutex_t             mutex;
+} ia_ffmpeg_shard_t;
+
+/* builds or loads the keyframe index of file and starts i_workers decoders
+ * on the frames [i_start, i_end) taking every i_step'th one. returns NULL if
+ * the file can't be sharded, e.g. because it has no timestamps. */
+ia_ffmpeg_shard_t* ia_ffmpeg_shard_open( const char* file, int i_workers,
+                                         int64_t i_start, int64_t i_end,
+                                         int64_t i_step );
+
+/* swaps the next frame in source order into iaf. the source index of the
+ * frame is left in shard->i_frame.
+ * retval: 0 ok, -1 end of file */
+int ia_ffmpeg_shard_read_frame( ia_ffmpeg_shard_t* shard, ia_image_t* iaf );
+
+void ia_ffmpeg_shard_close( ia_ffmpeg_shard_t* shard );
+#endif
+
+#endif
@@ -0,0 +1,166 @@
+#include "fft.h"
+
+ia_fft_t* ia_fft_create( int size )
+{
+    ia_fft_t* f;
+    int i, bits = 0;
+
+    if( size < 2 || (size & (size-1)) )
+        return NULL;
+    while( (1 << bits) < size )
+        bits++;
+
+    if( (f = ia_calloc( 1, sizeof(ia_fft_t) )) == NULL )
+        return NULL;
+    f->i_size = size;
+    f->twiddle = ia_malloc( size * sizeof(float) );
+    f->rev = ia_malloc( size * sizeof(int) );
+    if( f->twiddle == NULL || f->rev == NULL ) {
+        ia_fft_free( f );
+        return NULL;
+    }
+
+    for( i = 0; i < size/2; i++ ) {
+        f->twiddle[2*i] = cos( 2 * M_PI * i / size );
+        f->twiddle[2*i+1] = -sin( 2 * M_PI * i / size );
+    }
+    for( i = 0; i < size; i++ ) {
+        int b, r = 0;
+        for( b = 0; b < bits; b++ )
+            r |= (i >> b & 1) << (bits-1-b);
+        f->rev[i] = r;
+    }
+    return f;
+}
+
+void ia_fft_free( ia_fft_t* f )
+{
+    if( f == NULL )
+        return;
+    ia_free( f->twiddle );
+    ia_free( f->rev );
+    ia_free( f );
+}
+
+void ia_fft( const ia_fft_t* f, float* z, bool b_inverse )
+{
+    const int n = f->i_size;
+    const float sign = b_inverse ? -1 : 1;
+    int i, len, k;
+
+    for( i = 0; i < n; i++ ) {
+        const int r = f->rev[i];
+        if( r > i ) {
+            float t = z[2*i]; z[2*i] = z[2*r]; z[2*r] = t;
+            t = z[2*i+1]; z[2*i+1] = z[2*r+1]; z[2*r+1] = t;
+        }
+    }
+
+    for( len = 2; len <= n; len <<= 1 )
+    {
+        const int half = len >> 1;
+        const int step = n / len;
+
+        for( i = 0; i < n; i += len ) {
+            for( k = 0; k < half; k++ ) {
+                const float wr = f->twiddle[2*k*step];
+                const float wi = sign * f->twiddle[2*k*step+1];
+                float* a = z + 2*(i+k);
+                float* b = z + 2*(i+k+half);
+                const float tr = b[0]*wr - b[1]*wi;
+                const float ti = b[0]*wi + b[1]*wr;
+                b[0] = a[0] - tr;
+                b[1] = a[1] - ti;
+                a[0] += tr;
+                a[1] += ti;
+            }
+        }
+    }
+}
+
+/* the columns of a half spectrum, one at a time through tmp */
+static void ia_fft2d_cols( const ia_fft_t* f, float* spec, float* tmp, bool b_inverse )
+{
+    const int n = f->i_size;
+    const int w = n/2 + 1;
+    int x, y;
+
+    for( x = 0; x < w; x++ ) {
+        for( y = 0; y < n; y++ ) {
+            tmp[2*y] = spec[2*(y*w + x)];
+            tmp[2*y+1] = spec[2*(y*w + x)+1];
+        }
+        ia_fft( f, tmp, b_inverse );
+        for( y = 0; y < n; y++ ) {
+            spec[2*(y*w + x)] = tmp[2*y];
+            spec[2*(y*w + x)+1] = tmp[2*y+1];
+        }
+    }
+}
+
+void ia_fft2d_r2c( const ia_fft_t* f, const float* in, float* spec, float* tmp )
+{
+    const int n = f->i_size;
+    const int w = n/2 + 1;
+    int x, y;
+
+    for( y = 0; y < n; y += 2 )
+    {
+        const float* a = in + y * n;
+        const float* b = in + (y+1) * n;
+        float* sa = spec + 2 * y * w;
+        float* sb = spec + 2 * (y+1) * w;
+
+        for( x = 0; x < n; x++ ) {
+            tmp[2*x] = a[x];
+            tmp[2*x+1] = b[x];
+        }
+        ia_fft( f, tmp, false );
+
+        /* a is the even part of z, b the odd part over i */
+        for( x = 0; x < w; x++ ) {
+            const int m = (n - x) & (n-1);
+            const float zr = tmp[2*x], zi = tmp[2*x+1];
+            const float cr = tmp[2*m], ci = -tmp[2*m+1];
+            sa[2*x] = (zr + cr) / 2;
+            sa[2*x+1] = (zi + ci) / 2;
+            sb[2*x] = (zi - ci) / 2;
+            sb[2*x+1] = -(zr - cr) / 2;
+        }
+    }
+    ia_fft2d_cols( f, spec, tmp, false );
+}
+
+void ia_fft2d_c2r( const ia_fft_t* f, float* spec, float* out, float* tmp )
+{
+    const int n = f->i_size;
+    const int w = n/2 + 1;
+    int x, y;
+
+    ia_fft2d_cols( f, spec, tmp, true );
+
+    for( y = 0; y < n; y += 2 )
+    {
+        const float* sa = spec + 2 * y * w;
+        const float* sb = spec + 2 * (y+1) * w;
+        float* a = out + y * n;
+        float* b = out + (y+1) * n;
+
+        /* z = a + i b over the whole row, the upper half mirrored */
+        for( x = 0; x < w; x++ ) {
+            tmp[2*x] = sa[2*x] - sb[2*x+1];
+            tmp[2*x+1] = sa[2*x+1] + sb[2*x];
+        }
+        for( x = w; x < n; x++ ) {
+            const int m = n - x;
+            tmp[2*x] = sa[2*m] + sb[2*m+1];
+            tmp[2*x+1] = -sa[2*m+1] + sb[2*m];
+        }
+        ia_fft( f, tmp, true );
+
+        for( x = 0; x < n; x++ ) {
+            a[x] = tmp[2*x];
+            b[x] = tmp[2*x+1];
+        }
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef _H_FFT
+#define _H_FFT
+
+#include "common.h"
+
+/* radix-2 fft of a fixed power of two size, complex values are pairs of
+ * floats. the bit reversal and twiddles are worked out once. */
+typedef struct ia_fft_t
+{
+    int         i_size;
+    float*      twiddle;    // exp(-2 pi i k / size) for k < size/2
+    int*        rev;        // bit reversed index
+} ia_fft_t;
+
+/* retval: the plan, NULL if size isnt a power of two or no memory */
+ia_fft_t* ia_fft_create( int size );
+void ia_fft_free( ia_fft_t* f );
+
+/* in place transform of size complex values, the inverse isnt scaled */
+void ia_fft( const ia_fft_t* f, float* z, bool b_inverse );
+
+/* 2d transform of a real size x size block into its size x (size/2+1)
+ * complex half spectrum, the rest of it being the conjugate mirror. rows go
+ * through the complex fft two at a time, one as the real and one as the
+ * imaginary part. tmp holds 2*size complex values. */
+void ia_fft2d_r2c( const ia_fft_t* f, const float* in, float* spec, float* tmp );
+
+/* and back, times size*size. spec is used as scratch. */
+void ia_fft2d_c2r( const ia_fft_t* f, float* spec, float* out, float* tmp );
+
+#endif
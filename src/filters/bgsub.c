@@ -0,0 +1,349 @@
+/******************************************************************************
+ * Copyright (c) 2008 Joey Degges
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *****************************************************************************/
+
+#include "bgsub.h"
+
+/* variances are kept between these, in Q8. the floor stops a still pixel
+ * from turning foreground on sensor noise, the cap keeps var*i_t2 in 32 bits */
+#define BGSUB_VAR_MIN   ((4*4) << 8)
+#define BGSUB_VAR_MAX   ((64*64) << 8)
+#define BGSUB_VAR_INIT  ((16*16) << 8)
+
+#define BGSUB_MOG_W_INIT    3277    // 0.05, weight of a new component
+#define BGSUB_MOG_BG        45875   // 0.7, weight the background components cover
+
+void bgsub_init( ia_seq_t* s, ia_filter_param_t** fp )
+{
+    const size_t n = (size_t)s->param->i_width * s->param->i_height;
+    bgsub_t* bg = ia_calloc( 1, sizeof(bgsub_t) );
+    bool b_fail = false;
+    int c, k, t;
+
+    *fp = NULL;
+    if( bg == NULL )
+        return;
+
+    bg->i_model = s->param->Settings.Model;
+    bg->i_width = s->param->i_width;
+    bg->i_height = s->param->i_height;
+    bg->i_channels = s->param->Settings.nChannels == 1 ? 1 : 3;
+    bg->i_step = s->param->Settings.BgStep > 0 ? s->param->Settings.BgStep : 1;
+    bg->i_t2 = s->param->Settings.Threshold * s->param->Settings.Threshold * 16 + 0.5;
+    bg->i_first = s->param->i_maxrefs - 1;
+
+    /* the closest power of two to 1/NumBgFrames */
+    for( bg->i_rate = 0; bg->i_rate < 16 &&
+         (1 << bg->i_rate) + (1 << bg->i_rate)/2 < s->param->Settings.NumBgFrames; bg->i_rate++ );
+
+    for( c = 0; c < bg->i_channels; c++ ) {
+        if( bg->i_model == BGSUB_GAUSS ) {
+            b_fail |= (bg->mu[c] = ia_malloc( n * sizeof(int32_t) )) == NULL;
+            b_fail |= (bg->var[c] = ia_malloc( n * sizeof(int32_t) )) == NULL;
+        } else {
+            for( k = 0; k < BGSUB_MOG_K; k++ )
+                b_fail |= (bg->mog_mu[k][c] = ia_malloc( n * sizeof(int32_t) )) == NULL;
+        }
+    }
+    if( bg->i_model == BGSUB_MOG ) {
+        for( k = 0; k < BGSUB_MOG_K; k++ ) {
+            b_fail |= (bg->mog_w[k] = ia_malloc( n * sizeof(int32_t) )) == NULL;
+            b_fail |= (bg->mog_var[k] = ia_malloc( n * sizeof(int32_t) )) == NULL;
+        }
+    }
+
+    bg->i_tiles = (bg->i_height + BGSUB_TILE_ROWS-1) / BGSUB_TILE_ROWS;
+    bg->tile_turn = ia_malloc( bg->i_tiles * sizeof(uint64_t) );
+    bg->tile_cond = ia_malloc( bg->i_tiles * sizeof(pthread_cond_t) );
+
+    /* before any failure, bgsub_clos destroys them when both arrays are there */
+    if( bg->tile_turn && bg->tile_cond ) {
+        pthread_mutex_init( &bg->mutex, NULL );
+        for( t = 0; t < bg->i_tiles; t++ ) {
+            bg->tile_turn[t] = bg->i_first;
+            ia_pthread_cond_init( &bg->tile_cond[t], NULL );
+        }
+    }
+
+    if( b_fail || bg->tile_turn == NULL || bg->tile_cond == NULL ) {
+        fprintf( stderr, "ERROR: bgsub_init(): couldnt alloc background model\n" );
+        bgsub_clos( (ia_filter_param_t*) bg );
+        return;
+    }
+
+    *fp = (ia_filter_param_t*) bg;
+}
+
+/* the samples of row y of the frame, one plane per channel */
+static void bgsub_load_row( bgsub_t* bg, ia_image_t* iaf, ia_cache_entry_t* luma,
+                            int y, int32_t* x[3] )
+{
+    int i, c;
+
+    if( luma ) {
+        const uint8_t* l = (uint8_t*) luma->data + y * luma->i_stride;
+        for( i = 0; i < bg->i_width; i++ )
+            x[0][i] = l[i];
+        return;
+    }
+
+    for( c = 0; c < 3; c++ ) {
+        const ia_pixel_t* p = iaf->pix + (size_t)y * iaf->i_pitch + c;
+        for( i = 0; i < bg->i_width; i++ )
+            x[c][i] = p[3*i];
+    }
+}
+
+/* one channel of a row against its running gaussian. no branches in the
+ * loop so it vectorizes: fg collects a 1 for any channel off by more than
+ * the threshold and the model moves 2^-rate of the way to the sample. */
+static void bgsub_gauss_row( bgsub_t* bg, const int32_t* x, int32_t* mu, int32_t* var,
+                             int32_t* fg, int rate, bool b_learn )
+{
+    const int32_t t2 = bg->i_t2;
+    int i;
+
+    for( i = 0; i < bg->i_width; i++ )
+    {
+        int32_t d = (x[i] << 8) - mu[i];
+        int32_t dq = d >> 4;
+        int32_t d2 = dq * dq;
+        int32_t v = var[i];
+
+        fg[i] |= d2 > ((v * t2) >> 4);
+
+        if( b_learn ) {
+            mu[i] += d >> rate;
+            v += (d2 - v) >> rate;
+            v = v < BGSUB_VAR_MIN ? BGSUB_VAR_MIN : v;
+            var[i] = v > BGSUB_VAR_MAX ? BGSUB_VAR_MAX : v;
+        }
+    }
+}
+
+static void bgsub_gauss_start( const int32_t* x, int32_t* mu, int32_t* var, int width )
+{
+    int i;
+
+    for( i = 0; i < width; i++ ) {
+        mu[i] = x[i] << 8;
+        var[i] = BGSUB_VAR_INIT;
+    }
+}
+
+/* stauffer-grimson with one variance per component: the sample belongs to
+ * the strongest component it is within the threshold of, and is background
+ * if that component is among the ones making up BGSUB_MOG_BG of the weight.
+ * a sample no component explains replaces the weakest one. */
+static int32_t bgsub_mog_pixel( bgsub_t* bg, size_t i, const int32_t* x,
+                                int rate, bool b_learn, bool b_start )
+{
+    const int nch = bg->i_channels;
+    int32_t d[3] = { 0 };
+    int32_t cover = 0;
+    int k, c, match = -1;
+    bool fg = true;
+
+    if( b_start ) {
+        for( k = 0; k < BGSUB_MOG_K; k++ ) {
+            bg->mog_w[k][i] = k ? 0 : 1 << 16;
+            bg->mog_var[k][i] = BGSUB_VAR_INIT;
+            for( c = 0; c < nch; c++ )
+                bg->mog_mu[k][c][i] = x[c] << 8;
+        }
+        return 0;
+    }
+
+    for( k = 0; k < BGSUB_MOG_K; k++ )
+    {
+        int64_t dist2 = 0;
+
+        if( bg->mog_w[k][i] == 0 )
+            break;
+        for( c = 0; c < nch; c++ ) {
+            int32_t dq = ((x[c] << 8) - bg->mog_mu[k][c][i]) >> 4;
+            dist2 += dq * dq;
+        }
+        if( dist2 <= (((int64_t)bg->mog_var[k][i] * bg->i_t2 * nch) >> 4) ) {
+            match = k;
+            fg = cover >= BGSUB_MOG_BG;
+            for( c = 0; c < nch; c++ )
+                d[c] = (x[c] << 8) - bg->mog_mu[k][c][i];
+            break;
+        }
+        cover += bg->mog_w[k][i];
+    }
+
+    if( !b_learn )
+        return fg;
+
+    for( k = 0; k < BGSUB_MOG_K; k++ )
+        bg->mog_w[k][i] += (((k == match) << 16) - bg->mog_w[k][i]) >> rate;
+
+    if( match >= 0 ) {
+        int32_t d2 = 0, v = bg->mog_var[match][i];
+        for( c = 0; c < nch; c++ ) {
+            int32_t dq = d[c] >> 4;
+            d2 += dq * dq;
+            bg->mog_mu[match][c][i] += d[c] >> rate;
+        }
+        v += (d2 / nch - v) >> rate;
+        v = v < BGSUB_VAR_MIN ? BGSUB_VAR_MIN : v;
+        bg->mog_var[match][i] = v > BGSUB_VAR_MAX ? BGSUB_VAR_MAX : v;
+    } else {
+        match = BGSUB_MOG_K-1;
+        bg->mog_w[match][i] = BGSUB_MOG_W_INIT;
+        bg->mog_var[match][i] = BGSUB_VAR_INIT;
+        for( c = 0; c < nch; c++ )
+            bg->mog_mu[match][c][i] = x[c] << 8;
+    }
+
+    /* only the updated component can have moved past its neighbours */
+    for( k = match; k > 0 && bg->mog_w[k][i] > bg->mog_w[k-1][i]; k-- ) {
+        int32_t t;
+#define BGSUB_SWAP(a,b) { t = a; a = b; b = t; }
+        BGSUB_SWAP( bg->mog_w[k][i], bg->mog_w[k-1][i] );
+        BGSUB_SWAP( bg->mog_var[k][i], bg->mog_var[k-1][i] );
+        for( c = 0; c < nch; c++ )
+            BGSUB_SWAP( bg->mog_mu[k][c][i], bg->mog_mu[k-1][c][i] );
+#undef BGSUB_SWAP
+    }
+    return fg;
+}
+
+static void bgsub_tile( bgsub_t* bg, ia_image_t* iaf, ia_cache_entry_t* luma,
+                        ia_image_t* iar, int tile, int32_t* x[3], int32_t* fg,
+                        uint64_t n )
+{
+    const bool b_start = n == 0;
+    const bool b_learn = n % bg->i_step == 0;
+    int rate = 0;
+    int y, i, c;
+
+    /* while the model is young it is a plain average of what it has seen */
+    while( rate < bg->i_rate && (2ULL << rate) <= n / bg->i_step + 1 )
+        rate++;
+
+    for( y = tile * BGSUB_TILE_ROWS; y < (tile+1) * BGSUB_TILE_ROWS && y < bg->i_height; y++ )
+    {
+        const size_t row = (size_t)y * bg->i_width;
+        ia_pixel_t* dst = iar->pix + (size_t)y * iar->i_pitch;
+
+        bgsub_load_row( bg, iaf, luma, y, x );
+        memset( fg, 0, bg->i_width * sizeof(int32_t) );
+
+        if( bg->i_model == BGSUB_GAUSS ) {
+            for( c = 0; c < bg->i_channels; c++ ) {
+                if( b_start )
+                    bgsub_gauss_start( x[c], bg->mu[c] + row, bg->var[c] + row, bg->i_width );
+                else
+                    bgsub_gauss_row( bg, x[c], bg->mu[c] + row, bg->var[c] + row,
+                                     fg, rate, b_learn );
+            }
+        } else {
+            for( i = 0; i < bg->i_width; i++ ) {
+                int32_t px[3];
+                for( c = 0; c < bg->i_channels; c++ )
+                    px[c] = x[c][i];
+                fg[i] = bgsub_mog_pixel( bg, row + i, px, rate, b_learn, b_start );
+            }
+        }
+
+        for( i = 0; i < bg->i_width; i++ )
+            dst[3*i] = dst[3*i+1] = dst[3*i+2] = fg[i] ? 255 : 0;
+    }
+}
+
+void bgsub_exec( ia_seq_t* s, ia_filter_param_t* fp, ia_image_t** iaim, ia_image_t* iar )
+{
+    bgsub_t* bg = (bgsub_t*) fp;
+    ia_image_t* iaf = iaim[s->param->i_maxrefs-1];
+    ia_cache_entry_t* luma = NULL;
+    int32_t* buf;
+    int32_t* x[3];
+    int tile, rc;
+
+    if( bg == NULL )
+        return;
+
+    buf = ia_malloc( 4 * bg->i_width * sizeof(int32_t) );
+    if( bg->i_channels == 1 )
+        luma = ia_cache_get( iaf, IA_CACHE_LUMA );
+    x[0] = buf;
+    x[1] = buf + bg->i_width;
+    x[2] = buf + 2*bg->i_width;
+
+    for( tile = 0; tile < bg->i_tiles; tile++ )
+    {
+        if( 0 != (rc = ia_pthread_mutex_lock( &bg->mutex )) )
+            ia_pthread_error( rc, "bgsub_exec()", "ia_pthread_mutex_lock()" );
+        while( bg->tile_turn[tile] != iar->i_frame ) {
+            if( 0 != (rc = ia_pthread_cond_wait( &bg->tile_cond[tile], &bg->mutex )) )
+                ia_pthread_error( rc, "bgsub_exec()", "ia_pthread_cond_wait()" );
+        }
+        if( 0 != (rc = ia_pthread_mutex_unlock( &bg->mutex )) )
+            ia_pthread_error( rc, "bgsub_exec()", "ia_pthread_mutex_unlock()" );
+
+        /* a failed allocation still has to pass the tile on */
+        if( buf && (luma || bg->i_channels == 3) )
+            bgsub_tile( bg, iaf, luma, iar, tile, x, buf + 3*bg->i_width,
+                        iar->i_frame - bg->i_first );
+
+        if( 0 != (rc = ia_pthread_mutex_lock( &bg->mutex )) )
+            ia_pthread_error( rc, "bgsub_exec()", "ia_pthread_mutex_lock()" );
+        bg->tile_turn[tile]++;
+        if( 0 != (rc = ia_pthread_cond_broadcast( &bg->tile_cond[tile] )) )
+            ia_pthread_error( rc, "bgsub_exec()", "ia_pthread_cond_broadcast()" );
+        if( 0 != (rc = ia_pthread_mutex_unlock( &bg->mutex )) )
+            ia_pthread_error( rc, "bgsub_exec()", "ia_pthread_mutex_unlock()" );
+    }
+
+    ia_cache_release( luma );
+    ia_free( buf );
+}
+
+void bgsub_clos( ia_filter_param_t* fp )
+{
+    bgsub_t* bg = (bgsub_t*) fp;
+    int c, k, t;
+
+    if( bg == NULL )
+        return;
+
+    for( c = 0; c < 3; c++ ) {
+        ia_free( bg->mu[c] );
+        ia_free( bg->var[c] );
+        for( k = 0; k < BGSUB_MOG_K; k++ )
+            ia_free( bg->mog_mu[k][c] );
+    }
+    for( k = 0; k < BGSUB_MOG_K; k++ ) {
+        ia_free( bg->mog_w[k] );
+        ia_free( bg->mog_var[k] );
+    }
+    if( bg->tile_cond && bg->tile_turn ) {
+        for( t = 0; t < bg->i_tiles; t++ )
+            pthread_cond_destroy( &bg->tile_cond[t] );
+        pthread_mutex_destroy( &bg->mutex );
+    }
+    ia_free( bg->tile_turn );
+    ia_free( bg->tile_cond );
+    ia_free( bg );
+}
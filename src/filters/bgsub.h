@@ -0,0 +1,68 @@
+/******************************************************************************
+ * Copyright (c) 2008 Joey Degges
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *****************************************************************************/
+
+#ifndef _H_BGSUB
+#define _H_BGSUB
+
+#include "filters.h"
+
+#define BGSUB_GAUSS     0   // one running gaussian per channel
+#define BGSUB_MOG       1   // mixture of BGSUB_MOG_K gaussians per pixel
+
+#define BGSUB_MOG_K     3
+
+/* rows in a tile. frames go through the model one tile at a time, in frame
+ * order, so a worker can start on the top of its frame while the one before
+ * it is still busy further down */
+#define BGSUB_TILE_ROWS 16
+
+/* model state, kept between frames in the filter params. everything is
+ * fixed point in planes of i_width*i_height values: means and variances in
+ * Q8 (value*256), mixture weights in Q16. rows are in the order of pix. */
+typedef struct bgsub_t
+{
+    int         i_model;
+    int         i_width;
+    int         i_height;
+    int         i_channels;     // 3 for BGR, 1 for luma
+    int         i_rate;         // learning rate is 2^-i_rate
+    int         i_step;         // learn from every i_step'th frame
+    int32_t     i_t2;           // squared threshold in Q4
+    uint64_t    i_first;        // first frame the filter sees
+
+    int32_t*    mu[3];                      // BGSUB_GAUSS
+    int32_t*    var[3];
+    int32_t*    mog_w[BGSUB_MOG_K];         // BGSUB_MOG, strongest first
+    int32_t*    mog_mu[BGSUB_MOG_K][3];
+    int32_t*    mog_var[BGSUB_MOG_K];
+
+    int         i_tiles;
+    uint64_t*   tile_turn;      // frame each tile takes next
+    pthread_cond_t* tile_cond;
+    pthread_mutex_t mutex;
+} bgsub_t;
+
+void bgsub_init( ia_seq_t*, ia_filter_param_t** );
+void bgsub_exec( ia_seq_t*, ia_filter_param_t*, ia_image_t**, ia_image_t* );
+void bgsub_clos( ia_filter_param_t* );
+
+#endif
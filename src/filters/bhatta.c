@@ -0,0 +1,372 @@
+/******************************************************************************
+ * Copyright (c) 2008 Joey Degges
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *****************************************************************************/
+
+#include "bhatta.h"
+
+#include <math.h>
+
+void bhatta_init( ia_seq_t* s, ia_filter_param_t** fp )
+{
+    const ia_param_t* p = s->param;
+    const bool b_opt = p->BhattaOptSettings.MaxSizePatch > 0;
+    const int nbins[3] = {
+        b_opt ? p->BhattaOptSettings.NumBins1 : p->BhattaSettings.NumBins1,
+        b_opt ? p->BhattaOptSettings.NumBins2 : p->BhattaSettings.NumBins2,
+        b_opt ? p->BhattaOptSettings.NumBins3 : p->BhattaSettings.NumBins3 };
+    const int size = b_opt ? p->BhattaOptSettings.MaxSizePatch : p->BhattaSettings.SizePatch;
+    const double alpha = b_opt ? p->BhattaOptSettings.Alpha : p->BhattaSettings.Alpha;
+    const size_t n = (size_t)p->i_width * p->i_height * 3;
+    bhatta_t* bh;
+    int c, v, i, rmax, area;
+
+    *fp = NULL;
+
+    if( nbins[0] < 1 || nbins[0] > 256 || nbins[1] < 1 || nbins[1] > 256 ||
+        nbins[2] < 1 || nbins[2] > 256 || nbins[0]*nbins[1]*nbins[2] > BHATTA_MAX_BINS ) {
+        fprintf( stderr, "ERROR: bhatta_init(): need 1 to 256 bins per channel and at most %d in all\n",
+                 BHATTA_MAX_BINS );
+        return;
+    }
+    if( size < 1 || size > BHATTA_MAX_PATCH ) {
+        fprintf( stderr, "ERROR: bhatta_init(): patch size must be 1 to %d\n", BHATTA_MAX_PATCH );
+        return;
+    }
+
+    if( (bh = ia_calloc( 1, sizeof(bhatta_t) )) == NULL )
+        return;
+
+    bh->i_width = p->i_width;
+    bh->i_height = p->i_height;
+    bh->i_bins = nbins[0] * nbins[1] * nbins[2];
+    for( v = 0; v < 256; v++ ) {
+        bh->lut[0][v] = (v * nbins[0] >> 8) * nbins[1] * nbins[2];
+        bh->lut[1][v] = (v * nbins[1] >> 8) * nbins[2];
+        bh->lut[2][v] = v * nbins[2] >> 8;
+    }
+
+    /* the variable mode tries every power of two up to the largest patch and
+     * keeps the size that explains the pixel best once small patches, which
+     * only hold a few samples per bin, are penalized */
+    rmax = size / 2;
+    if( b_opt ) {
+        for( i = 1; i < rmax && bh->i_scales < BHATTA_MAX_SCALES-1; i *= 2 )
+            bh->radius[bh->i_scales++] = i;
+    }
+    bh->radius[bh->i_scales++] = rmax;
+    for( i = 0; i < bh->i_scales; i++ ) {
+        area = (2*bh->radius[i]+1) * (2*bh->radius[i]+1);
+        bh->penalty[i] = b_opt ? p->BhattaOptSettings.Regularizer * bh->i_bins / area : 0;
+    }
+
+    area = (2*rmax+1) * (2*rmax+1);
+    bh->sqrt_tab = ia_malloc( (area+1) * sizeof(float) );
+    if( bh->sqrt_tab != NULL )
+        for( i = 0; i <= area; i++ )
+            bh->sqrt_tab[i] = sqrtf( i );
+
+    bh->i_alpha = alpha * 65536 + 0.5;
+    bh->i_alpha = bh->i_alpha < 0 ? 0 : bh->i_alpha > 65536 ? 65536 : bh->i_alpha;
+    bh->b_update_mask = b_opt ? p->BhattaOptSettings.useBgUpdateMask : p->BhattaSettings.useBgUpdateMask;
+    bh->f_threshold = b_opt ? p->BhattaOptSettings.Threshold : p->BhattaSettings.Threshold;
+    bh->i_first = p->i_maxrefs - 1;
+
+    bh->bg[0] = ia_malloc( n * sizeof(uint16_t) );
+    bh->bg[1] = ia_malloc( n * sizeof(uint16_t) );
+
+    bh->i_tiles = (bh->i_height + BHATTA_TILE_ROWS-1) / BHATTA_TILE_ROWS;
+    bh->i_lookahead = (rmax + BHATTA_TILE_ROWS-1) / BHATTA_TILE_ROWS;
+    bh->i_scratch_size = (size_t)(BHATTA_TILE_ROWS + 2*rmax + 1) * (bh->i_width + 1) * bh->i_bins;
+    bh->tile_turn = ia_malloc( bh->i_tiles * sizeof(uint64_t) );
+
+    if( !bh->sqrt_tab || !bh->bg[0] || !bh->bg[1] || !bh->tile_turn ) {
+        fprintf( stderr, "ERROR: bhatta_init(): couldnt alloc background model\n" );
+        ia_free( bh->sqrt_tab );
+        ia_free( bh->bg[0] );
+        ia_free( bh->bg[1] );
+        ia_free( bh->tile_turn );
+        ia_free( bh );
+        return;
+    }
+
+    for( c = 0; c < bh->i_tiles; c++ )
+        bh->tile_turn[c] = bh->i_first;
+    pthread_mutex_init( &bh->mutex, NULL );
+    ia_pthread_cond_init( &bh->cond, NULL );
+
+    *fp = (ia_filter_param_t*) bh;
+}
+
+static void bhatta_scratch_free( bhatta_scratch_t* sc )
+{
+    if( sc == NULL )
+        return;
+    ia_free( sc->ih[0] );
+    ia_free( sc->ih[1] );
+    ia_free( sc->bins );
+    ia_free( sc );
+}
+
+/* bh->mutex must be held */
+static bhatta_scratch_t* bhatta_scratch_get( bhatta_t* bh )
+{
+    bhatta_scratch_t* sc = bh->scratch;
+
+    if( sc != NULL ) {
+        bh->scratch = sc->next;
+        return sc;
+    }
+
+    if( (sc = ia_calloc( 1, sizeof(bhatta_scratch_t) )) == NULL )
+        return NULL;
+    sc->ih[0] = ia_malloc( bh->i_scratch_size * sizeof(uint16_t) );
+    sc->ih[1] = ia_malloc( bh->i_scratch_size * sizeof(uint16_t) );
+    sc->bins = ia_malloc( bh->i_width * sizeof(uint16_t) );
+    if( !sc->ih[0] || !sc->ih[1] || !sc->bins ) {
+        bhatta_scratch_free( sc );
+        return NULL;
+    }
+    return sc;
+}
+
+/* integral histogram of rows [y0,y1) of the frame (bg NULL) or background.
+ * row 0 and column 0 are zero, (x,y) counts the pixels of [0,x) x [y0,y0+y) */
+static void bhatta_integrate( bhatta_t* bh, bhatta_scratch_t* sc, uint16_t* ih,
+                              ia_image_t* iaf, const uint16_t* bg, int y0, int y1 )
+{
+    const int w = bh->i_width;
+    const int nb = bh->i_bins;
+    const size_t row_size = (size_t)(w+1) * nb;
+    uint16_t hist[BHATTA_MAX_BINS];
+    int x, y, b;
+
+    memset( ih, 0, row_size * sizeof(uint16_t) );
+
+    for( y = y0; y < y1; y++ )
+    {
+        uint16_t* row = ih + (y - y0 + 1) * row_size;
+        const uint16_t* above = row - row_size;
+
+        if( bg != NULL ) {
+            const uint16_t* q = bg + (size_t)y * w * 3;
+            for( x = 0; x < w; x++ )
+                sc->bins[x] = bh->lut[0][q[3*x] >> 8] + bh->lut[1][q[3*x+1] >> 8]
+                            + bh->lut[2][q[3*x+2] >> 8];
+        } else {
+            const ia_pixel_t* q = iaf->pix + (size_t)y * iaf->i_pitch;
+            for( x = 0; x < w; x++ )
+                sc->bins[x] = bh->lut[0][q[3*x]] + bh->lut[1][q[3*x+1]] + bh->lut[2][q[3*x+2]];
+        }
+
+        memset( hist, 0, nb * sizeof(uint16_t) );
+        memset( row, 0, nb * sizeof(uint16_t) );
+        for( x = 0; x < w; x++ )
+        {
+            uint16_t* dst = row + (x+1) * nb;
+            const uint16_t* src = above + (x+1) * nb;
+
+            hist[sc->bins[x]]++;
+            for( b = 0; b < nb; b++ )
+                dst[b] = src[b] + hist[b];
+        }
+    }
+}
+
+/* bhattacharyya coefficient of the frame and background histograms of one
+ * patch, given by the offsets of its corners in the integral histograms */
+static float bhatta_coeff( bhatta_t* bh, bhatta_scratch_t* sc, const size_t o[4] )
+{
+    const uint16_t* f = sc->ih[0];
+    const uint16_t* g = sc->ih[1];
+    const float* sq = bh->sqrt_tab;
+    float sum = 0;
+    int b;
+
+    for( b = 0; b < bh->i_bins; b++ )
+    {
+        uint16_t cf = f[o[3]+b] - f[o[2]+b] - f[o[1]+b] + f[o[0]+b];
+        uint16_t cg = g[o[3]+b] - g[o[2]+b] - g[o[1]+b] + g[o[0]+b];
+        sum += sq[cf] * sq[cg];
+    }
+    return sum;
+}
+
+static void bhatta_tile( bhatta_t* bh, bhatta_scratch_t* sc, ia_image_t* iaf,
+                         ia_image_t* iar, int tile, uint64_t n )
+{
+    const int w = bh->i_width;
+    const int h = bh->i_height;
+    const int rmax = bh->radius[bh->i_scales-1];
+    const int y0 = tile * BHATTA_TILE_ROWS;
+    const int y1 = y0 + BHATTA_TILE_ROWS < h ? y0 + BHATTA_TILE_ROWS : h;
+    const int b0 = y0 - rmax > 0 ? y0 - rmax : 0;
+    const int b1 = y1 + rmax < h ? y1 + rmax : h;
+    const size_t row_size = (size_t)(w+1) * bh->i_bins;
+    const uint16_t* rd = bh->bg[n & 1];
+    uint16_t* wr = bh->bg[(n+1) & 1];
+    int x, y, c, i;
+
+    /* the first frame is the background */
+    if( n == 0 ) {
+        for( y = y0; y < y1; y++ ) {
+            const ia_pixel_t* q = iaf->pix + (size_t)y * iaf->i_pitch;
+            for( x = 0; x < 3*w; x++ )
+                wr[(size_t)y*w*3 + x] = q[x] << 8;
+            memset( iar->pix + (size_t)y * iar->i_pitch, 0, 3*w );
+        }
+        return;
+    }
+
+    bhatta_integrate( bh, sc, sc->ih[0], iaf, NULL, b0, b1 );
+    bhatta_integrate( bh, sc, sc->ih[1], NULL, rd, b0, b1 );
+
+    for( y = y0; y < y1; y++ )
+    {
+        const ia_pixel_t* q = iaf->pix + (size_t)y * iaf->i_pitch;
+        ia_pixel_t* dst = iar->pix + (size_t)y * iar->i_pitch;
+        const size_t row = (size_t)y * w * 3;
+
+        for( x = 0; x < w; x++ )
+        {
+            float best = 2, dist = 0;
+            uint8_t d;
+
+            for( i = 0; i < bh->i_scales; i++ )
+            {
+                const int r = bh->radius[i];
+                const int px0 = x - r > 0 ? x - r : 0;
+                const int px1 = x + r + 1 < w ? x + r + 1 : w;
+                const int py0 = (y - r > 0 ? y - r : 0) - b0;
+                const int py1 = (y + r + 1 < h ? y + r + 1 : h) - b0;
+                const size_t o[4] = { py0 * row_size + px0 * bh->i_bins,
+                                      py0 * row_size + px1 * bh->i_bins,
+                                      py1 * row_size + px0 * bh->i_bins,
+                                      py1 * row_size + px1 * bh->i_bins };
+                float dd = 1 - bhatta_coeff( bh, sc, o ) / ((px1-px0) * (py1-py0));
+
+                if( dd + bh->penalty[i] < best ) {
+                    best = dd + bh->penalty[i];
+                    dist = dd;
+                }
+            }
+
+            dist = dist > 0 ? sqrtf( dist ) : 0;
+            d = dist * 255 + 0.5;
+            dst[3*x] = dst[3*x+1] = dst[3*x+2] = d;
+
+            for( c = 0; c < 3; c++ ) {
+                const size_t k = row + 3*x + c;
+                if( bh->b_update_mask && dist > bh->f_threshold )
+                    wr[k] = rd[k];
+                else
+                    wr[k] = rd[k] + ((((int64_t)q[3*x+c] << 8) - rd[k]) * bh->i_alpha >> 16);
+            }
+        }
+    }
+}
+
+/* keeps the background of a tile as it is */
+static void bhatta_carry( bhatta_t* bh, int tile, uint64_t n )
+{
+    const int y0 = tile * BHATTA_TILE_ROWS;
+    const int y1 = y0 + BHATTA_TILE_ROWS < bh->i_height ? y0 + BHATTA_TILE_ROWS : bh->i_height;
+    const size_t row = (size_t)bh->i_width * 3;
+
+    memcpy( bh->bg[(n+1) & 1] + y0 * row, bh->bg[n & 1] + y0 * row,
+            (y1 - y0) * row * sizeof(uint16_t) );
+}
+
+void bhatta_exec( ia_seq_t* s, ia_filter_param_t* fp, ia_image_t** iaim, ia_image_t* iar )
+{
+    bhatta_t* bh = (bhatta_t*) fp;
+    ia_image_t* iaf = iaim[s->param->i_maxrefs-1];
+    bhatta_scratch_t* sc;
+    int tile, last, rc;
+
+    if( bh == NULL )
+        return;
+
+    if( 0 != (rc = ia_pthread_mutex_lock( &bh->mutex )) )
+        ia_pthread_error( rc, "bhatta_exec()", "ia_pthread_mutex_lock()" );
+    sc = bhatta_scratch_get( bh );
+    if( sc == NULL )
+        fprintf( stderr, "ERROR: bhatta_exec(): couldnt alloc integral histograms\n" );
+    if( 0 != (rc = ia_pthread_mutex_unlock( &bh->mutex )) )
+        ia_pthread_error( rc, "bhatta_exec()", "ia_pthread_mutex_unlock()" );
+
+    for( tile = 0; tile < bh->i_tiles; tile++ )
+    {
+        last = tile + bh->i_lookahead < bh->i_tiles ? tile + bh->i_lookahead : bh->i_tiles-1;
+
+        if( 0 != (rc = ia_pthread_mutex_lock( &bh->mutex )) )
+            ia_pthread_error( rc, "bhatta_exec()", "ia_pthread_mutex_lock()" );
+        while( bh->tile_turn[tile] != iar->i_frame || bh->tile_turn[last] < iar->i_frame ) {
+            if( 0 != (rc = ia_pthread_cond_wait( &bh->cond, &bh->mutex )) )
+                ia_pthread_error( rc, "bhatta_exec()", "ia_pthread_cond_wait()" );
+        }
+        if( 0 != (rc = ia_pthread_mutex_unlock( &bh->mutex )) )
+            ia_pthread_error( rc, "bhatta_exec()", "ia_pthread_mutex_unlock()" );
+
+        /* without scratch the background still has to move on */
+        if( sc != NULL || iar->i_frame == bh->i_first )
+            bhatta_tile( bh, sc, iaf, iar, tile, iar->i_frame - bh->i_first );
+        else
+            bhatta_carry( bh, tile, iar->i_frame - bh->i_first );
+
+        if( 0 != (rc = ia_pthread_mutex_lock( &bh->mutex )) )
+            ia_pthread_error( rc, "bhatta_exec()", "ia_pthread_mutex_lock()" );
+        bh->tile_turn[tile]++;
+        if( 0 != (rc = ia_pthread_cond_broadcast( &bh->cond )) )
+            ia_pthread_error( rc, "bhatta_exec()", "ia_pthread_cond_broadcast()" );
+        if( 0 != (rc = ia_pthread_mutex_unlock( &bh->mutex )) )
+            ia_pthread_error( rc, "bhatta_exec()", "ia_pthread_mutex_unlock()" );
+    }
+
+    if( sc != NULL ) {
+        if( 0 != (rc = ia_pthread_mutex_lock( &bh->mutex )) )
+            ia_pthread_error( rc, "bhatta_exec()", "ia_pthread_mutex_lock()" );
+        sc->next = bh->scratch;
+        bh->scratch = sc;
+        if( 0 != (rc = ia_pthread_mutex_unlock( &bh->mutex )) )
+            ia_pthread_error( rc, "bhatta_exec()", "ia_pthread_mutex_unlock()" );
+    }
+}
+
+void bhatta_clos( ia_filter_param_t* fp )
+{
+    bhatta_t* bh = (bhatta_t*) fp;
+
+    if( bh == NULL )
+        return;
+
+    while( bh->scratch != NULL ) {
+        bhatta_scratch_t* next = bh->scratch->next;
+        bhatta_scratch_free( bh->scratch );
+        bh->scratch = next;
+    }
+    pthread_mutex_destroy( &bh->mutex );
+    pthread_cond_destroy( &bh->cond );
+    ia_free( bh->sqrt_tab );
+    ia_free( bh->bg[0] );
+    ia_free( bh->bg[1] );
+    ia_free( bh->tile_turn );
+    ia_free( bh );
+}
@@ -0,0 +1,83 @@
+/******************************************************************************
+ * Copyright (c) 2008 Joey Degges
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *****************************************************************************/
+
+#ifndef _H_BHATTA
+#define _H_BHATTA
+
+#include "filters.h"
+
+#define BHATTA_MAX_BINS     512
+#define BHATTA_MAX_PATCH    255     // keeps a patch count in 16 bits
+#define BHATTA_MAX_SCALES   8
+
+/* rows in a tile, see BGSUB_TILE_ROWS. a tile also reads the background
+ * i_lookahead tiles further down, so it waits for the frame before to be
+ * done with those as well */
+#define BHATTA_TILE_ROWS    16
+
+/* per worker buffers, kept on a free list between frames */
+typedef struct bhatta_scratch_t
+{
+    struct bhatta_scratch_t* next;
+    uint16_t*   ih[2];      // integral histograms of the frame and background
+    uint16_t*   bins;       // bin of each pixel of a row
+} bhatta_scratch_t;
+
+/* every pixel is compared to the background through the histograms of the
+ * patches around it. the histograms of a tile come from integral histograms
+ * over the rows it needs: i_bins counts per sample, each the count of that
+ * bin above and left of it, so any patch costs 4*i_bins lookups whatever its
+ * size. counts are 16 bit and wrap, patch counts still come out right. */
+typedef struct bhatta_t
+{
+    int         i_width;
+    int         i_height;
+    int         i_bins;
+    uint16_t    lut[3][256];    // bin of a pixel is lut[0][b]+lut[1][g]+lut[2][r]
+
+    int         i_scales;       // patch radii tried, 1 unless --bhatta-max-patch
+    int         radius[BHATTA_MAX_SCALES];
+    float       penalty[BHATTA_MAX_SCALES]; // Regularizer*bins/area
+    float*      sqrt_tab;       // sqrt of every possible count
+
+    int32_t     i_alpha;        // background update rate, Q16
+    bool        b_update_mask;  // only update the background where it matched
+    float       f_threshold;
+    uint64_t    i_first;        // first frame the filter sees
+
+    /* background in Q8 BGR, frame n reads bg[n&1] and writes the other */
+    uint16_t*   bg[2];
+
+    int         i_tiles;
+    int         i_lookahead;
+    size_t      i_scratch_size; // values in one integral histogram
+    uint64_t*   tile_turn;      // frame each tile takes next
+    bhatta_scratch_t* scratch;
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;
+} bhatta_t;
+
+void bhatta_init( ia_seq_t*, ia_filter_param_t** );
+void bhatta_exec( ia_seq_t*, ia_filter_param_t*, ia_image_t**, ia_image_t* );
+void bhatta_clos( ia_filter_param_t* );
+
+#endif
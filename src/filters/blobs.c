@@ -0,0 +1,174 @@
+/******************************************************************************
+ * Copyright (c) 2008 Joey Degges
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *****************************************************************************/
+
+#include "blobs.h"
+
+void blobs_init( ia_seq_t* s, ia_filter_param_t** fp )
+{
+    const ia_param_t* p = s->param;
+    blobs_t* b;
+
+    *fp = NULL;
+    if( (b = ia_calloc( 1, sizeof(blobs_t) )) == NULL )
+        return;
+
+    b->i_threshold = p->BlobsSettings.Threshold;
+    b->i_min_area = p->BlobsSettings.MinArea;
+    b->i_first = p->i_maxrefs - 1;
+    b->i_turn = b->i_first;
+
+    if( p->BlobsSettings.ListFile[0] ) {
+        if( !strcmp(p->BlobsSettings.ListFile, "-") )
+            b->list = stdout;
+        else if( (b->list = fopen( p->BlobsSettings.ListFile, "w" )) == NULL )
+            fprintf( stderr, "ERROR: blobs_init(): couldnt open blob list %s\n",
+                     p->BlobsSettings.ListFile );
+        if( b->list )
+            fprintf( b->list, "# frame blob area cx cy left top right bottom, picture pixels from the top left\n" );
+    }
+
+    pthread_mutex_init( &b->mutex, NULL );
+    ia_pthread_cond_init( &b->cond, NULL );
+    *fp = (ia_filter_param_t*) b;
+}
+
+/* writes the blobs of frame i_frame to the list once every earlier frame has.
+ * rows of a bottom up frame are flipped to picture rows with i_last, the
+ * last row of the frame, or passed through when i_last is negative */
+static void blobs_write( blobs_t* b, ia_ccl_t* l, int i_last, uint64_t i_frame )
+{
+    int i, rc;
+
+    if( 0 != (rc = ia_pthread_mutex_lock( &b->mutex )) )
+        ia_pthread_error( rc, "blobs_write()", "ia_pthread_mutex_lock()" );
+    while( b->i_turn != i_frame ) {
+        if( 0 != (rc = ia_pthread_cond_wait( &b->cond, &b->mutex )) )
+            ia_pthread_error( rc, "blobs_write()", "ia_pthread_cond_wait()" );
+    }
+
+    for( i = 0; l != NULL && i < l->i_blobs; i++ ) {
+        const ia_blob_t* bl = &l->blobs[i];
+        fprintf( b->list, "%llu %d %u %.2f %.2f %d %d %d %d\n",
+                 (long long unsigned) i_frame, i, bl->i_area, bl->f_cx,
+                 i_last < 0 ? bl->f_cy : i_last - bl->f_cy,
+                 bl->i_left, i_last < 0 ? bl->i_top : i_last - bl->i_bottom,
+                 bl->i_right, i_last < 0 ? bl->i_bottom : i_last - bl->i_top );
+    }
+
+    b->i_turn++;
+    if( 0 != (rc = ia_pthread_cond_broadcast( &b->cond )) )
+        ia_pthread_error( rc, "blobs_write()", "ia_pthread_cond_broadcast()" );
+    if( 0 != (rc = ia_pthread_mutex_unlock( &b->mutex )) )
+        ia_pthread_error( rc, "blobs_write()", "ia_pthread_mutex_unlock()" );
+}
+
+/* b->mutex must be held */
+static blobs_ccl_t* blobs_ccl_get( blobs_t* b )
+{
+    blobs_ccl_t* c = b->ccl;
+
+    if( c != NULL ) {
+        b->ccl = c->next;
+        return c;
+    }
+    return ia_calloc( 1, sizeof(blobs_ccl_t) );
+}
+
+/* labels the pixels of the current frame with luma above the threshold into
+ * 8-connected blobs, see ia_ccl_t. the output shows every blob of at least
+ * the minimum area in its own colour. */
+void blobs_exec( ia_seq_t* s, ia_filter_param_t* fp, ia_image_t** iaim, ia_image_t* iar )
+{
+    blobs_t* b = (blobs_t*) fp;
+    ia_cache_entry_t* luma;
+    blobs_ccl_t* c;
+    ia_ccl_t* l = NULL;
+    int i, x, rc;
+
+    if( b == NULL )
+        return;
+
+    memset( iar->pix, 0, iar->i_pitch * s->param->i_height );
+
+    if( 0 != (rc = ia_pthread_mutex_lock( &b->mutex )) )
+        ia_pthread_error( rc, "blobs_exec()", "ia_pthread_mutex_lock()" );
+    c = blobs_ccl_get( b );
+    if( 0 != (rc = ia_pthread_mutex_unlock( &b->mutex )) )
+        ia_pthread_error( rc, "blobs_exec()", "ia_pthread_mutex_unlock()" );
+
+    luma = ia_cache_get( iaim[s->param->i_maxrefs-1], IA_CACHE_LUMA );
+    if( c == NULL || luma == NULL || ia_ccl_label( &c->l, luma, b->i_threshold, b->i_min_area ) )
+        fprintf( stderr, "ERROR: blobs_exec(): couldnt alloc blob labels\n" );
+    else
+        l = &c->l;
+
+    for( i = 0; l != NULL && i < l->i_runs; i++ )
+    {
+        const ia_ccl_run_t* r = &l->runs[i];
+        ia_pixel_t* p = iar->pix + (size_t)r->y * iar->i_pitch;
+
+        if( r->blob < 0 )
+            continue;
+        for( x = r->x0; x < r->x1; x++ ) {
+            p[3*x]   = 64 + (r->blob * 37) % 192;
+            p[3*x+1] = 64 + (r->blob * 101) % 192;
+            p[3*x+2] = 64 + (r->blob * 173) % 192;
+        }
+    }
+
+    if( b->list )
+        blobs_write( b, l,
+                     iaim[s->param->i_maxrefs-1]->b_bottom_up ? s->param->i_height - 1 : -1,
+                     iar->i_frame );
+
+    ia_cache_release( luma );
+    if( c != NULL ) {
+        if( 0 != (rc = ia_pthread_mutex_lock( &b->mutex )) )
+            ia_pthread_error( rc, "blobs_exec()", "ia_pthread_mutex_lock()" );
+        c->next = b->ccl;
+        b->ccl = c;
+        if( 0 != (rc = ia_pthread_mutex_unlock( &b->mutex )) )
+            ia_pthread_error( rc, "blobs_exec()", "ia_pthread_mutex_unlock()" );
+    }
+}
+
+void blobs_clos( ia_filter_param_t* fp )
+{
+    blobs_t* b = (blobs_t*) fp;
+
+    if( b == NULL )
+        return;
+
+    while( b->ccl != NULL ) {
+        blobs_ccl_t* next = b->ccl->next;
+        ia_ccl_free( &b->ccl->l );
+        ia_free( b->ccl );
+        b->ccl = next;
+    }
+    if( b->list && b->list != stdout )
+        fclose( b->list );
+    else if( b->list )
+        fflush( b->list );
+    pthread_mutex_destroy( &b->mutex );
+    pthread_cond_destroy( &b->cond );
+    ia_free( b );
+}
@@ -0,0 +1,54 @@
+/******************************************************************************
+ * Copyright (c) 2008 Joey Degges
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *****************************************************************************/
+
+#ifndef _H_BLOBS
+#define _H_BLOBS
+
+#include "filters.h"
+#include "ccl.h"
+
+/* per worker labels, kept on a free list between frames */
+typedef struct blobs_ccl_t
+{
+    struct blobs_ccl_t* next;
+    ia_ccl_t    l;
+} blobs_ccl_t;
+
+typedef struct blobs_t
+{
+    int         i_threshold;    // luma above this is foreground
+    int         i_min_area;
+    uint64_t    i_first;        // first frame the filter sees
+
+    /* the blob list, written in frame order */
+    FILE*       list;
+    uint64_t    i_turn;         // next frame allowed to write
+    blobs_ccl_t* ccl;
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;
+} blobs_t;
+
+void blobs_init( ia_seq_t*, ia_filter_param_t** );
+void blobs_exec( ia_seq_t*, ia_filter_param_t*, ia_image_t**, ia_image_t* );
+void blobs_clos( ia_filter_param_t* );
+
+#endif
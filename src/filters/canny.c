@@ -0,0 +1,162 @@
+/******************************************************************************
+ * Copyright (c) 2008 Joey Degges
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *****************************************************************************/
+
+#include "canny.h"
+
+/* tan(22.5) and tan(67.5) in Q15, the edges of the direction sectors */
+#define CANNY_TAN22     13573
+#define CANNY_TAN67     79109
+
+enum { CANNY_NONE, CANNY_WEAK, CANNY_EDGE };
+enum { CANNY_DIR_H, CANNY_DIR_V, CANNY_DIR_DIAG, CANNY_DIR_ANTI };
+
+/* l1 magnitude and the gradient direction rounded to 45 degrees. both loops
+ * are straight integer arithmetic over a row so they vectorize. */
+static void canny_row( const int16_t* gx, const int16_t* gy, uint16_t* mag, uint8_t* dir, int w )
+{
+    int x;
+
+    for( x = 0; x < w; x++ )
+        mag[x] = abs( gx[x] ) + abs( gy[x] );
+
+    if( dir == NULL )
+        return;
+    for( x = 0; x < w; x++ )
+    {
+        const int32_t ax = abs( gx[x] );
+        const int32_t ay = abs( gy[x] ) << 15;
+        dir[x] = ay < ax * CANNY_TAN22 ? CANNY_DIR_H :
+                 ay > ax * CANNY_TAN67 ? CANNY_DIR_V :
+                 (gx[x] ^ gy[x]) >= 0 ? CANNY_DIR_DIAG : CANNY_DIR_ANTI;
+    }
+}
+
+/* sobel gradients of luma, non maximum suppression along them and hysteresis
+ * between --canny-low and --canny-high. magnitudes and directions are only
+ * kept for a band of rows (and a row either side of it) at a time, the
+ * thinned pixels go to a class map for the whole frame. strong ones are
+ * pushed on a stack as they are found and the stack then pulls in the weak
+ * ones they touch, so every pixel is looked at a fixed number of times. the
+ * outermost pixels never are edges. */
+void canny_exec( ia_seq_t* s, ia_filter_param_t* fp, ia_image_t** iaim, ia_image_t* iar )
+{
+    ia_image_t* iaf = iaim[s->param->i_maxrefs-1];
+    const int low = s->param->CannySettings.Low;
+    const int high = s->param->CannySettings.High;
+    const int w = iaf->i_width;
+    const int h = iaf->i_height;
+    ia_cache_entry_t *gx = NULL, *gy = NULL;
+    uint16_t* mag = NULL;
+    uint8_t* dir = NULL;
+    uint8_t* map = NULL;
+    uint32_t* stack = NULL;
+    size_t top = 0;
+    int x, y, y0;
+
+    memset( iar->pix, 0, (size_t)iar->i_pitch * h );
+    if( w < 3 || h < 3 )
+        return;
+
+    gx = ia_cache_get( iaf, IA_CACHE_GRAD_X );
+    gy = ia_cache_get( iaf, IA_CACHE_GRAD_Y );
+    mag = ia_malloc( (CANNY_BAND_ROWS+2) * w * sizeof(uint16_t) );
+    dir = ia_malloc( CANNY_BAND_ROWS * w );
+    map = ia_calloc( (size_t)w * h, 1 );
+    stack = ia_malloc( (size_t)w * h * sizeof(uint32_t) );
+    if( gx == NULL || gy == NULL || mag == NULL || dir == NULL || map == NULL || stack == NULL ) {
+        fprintf( stderr, "ERROR: canny_exec(): couldnt alloc edge buffers\n" );
+        goto out;
+    }
+
+    for( y0 = 1; y0 < h-1; y0 += CANNY_BAND_ROWS )
+    {
+        const int y1 = y0 + CANNY_BAND_ROWS < h-1 ? y0 + CANNY_BAND_ROWS : h-1;
+
+        /* mag row 0 is y0-1, dir row 0 is y0 */
+        for( y = y0-1; y <= y1; y++ ) {
+            const size_t o = (size_t)y * gx->i_stride;
+            canny_row( (int16_t*) gx->data + o, (int16_t*) gy->data + o, mag + (y-y0+1) * w,
+                       y >= y0 && y < y1 ? dir + (y-y0) * w : NULL, w );
+        }
+
+        for( y = y0; y < y1; y++ )
+        {
+            const uint16_t* m = mag + (y-y0+1) * w;
+            const uint8_t* d = dir + (y-y0) * w;
+            uint8_t* c = map + (size_t)y * w;
+
+            for( x = 1; x < w-1; x++ )
+            {
+                int a, b;
+
+                if( m[x] < low )
+                    continue;
+                switch( d[x] ) {
+                    case CANNY_DIR_H:   a = m[x-1];   b = m[x+1];   break;
+                    case CANNY_DIR_V:   a = m[x-w];   b = m[x+w];   break;
+                    case CANNY_DIR_DIAG:a = m[x-w-1]; b = m[x+w+1]; break;
+                    default:            a = m[x-w+1]; b = m[x+w-1]; break;
+                }
+                /* plateaus keep their first pixel only */
+                if( m[x] <= a || m[x] < b )
+                    continue;
+                if( m[x] >= high ) {
+                    c[x] = CANNY_EDGE;
+                    stack[top++] = (uint32_t)y * w + x;
+                } else {
+                    c[x] = CANNY_WEAK;
+                }
+            }
+        }
+    }
+
+    while( top > 0 )
+    {
+        const uint32_t i = stack[--top];
+        const uint32_t n[8] = { i-w-1, i-w, i-w+1, i-1, i+1, i+w-1, i+w, i+w+1 };
+        int k;
+
+        for( k = 0; k < 8; k++ ) {
+            if( map[n[k]] == CANNY_WEAK ) {
+                map[n[k]] = CANNY_EDGE;
+                stack[top++] = n[k];
+            }
+        }
+    }
+
+    for( y = 1; y < h-1; y++ ) {
+        ia_pixel_t* p = iar->pix + (size_t)y * iar->i_pitch;
+        const uint8_t* c = map + (size_t)y * w;
+        for( x = 1; x < w-1; x++ )
+            if( c[x] == CANNY_EDGE )
+                p[3*x] = p[3*x+1] = p[3*x+2] = 255;
+    }
+
+out:
+    ia_cache_release( gx );
+    ia_cache_release( gy );
+    ia_free( mag );
+    ia_free( dir );
+    ia_free( map );
+    ia_free( stack );
+    fp = fp;
+}
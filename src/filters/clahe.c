@@ -0,0 +1,153 @@
+/******************************************************************************
+ * Copyright (c) 2008 Joey Degges
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *****************************************************************************/
+
+#include "clahe.h"
+
+/* the lut of a tile of area pixels: its histogram clipped at --clahe-clip
+ * times the mean bin, the clipped counts spread evenly over all bins, and
+ * the cdf of that scaled to 0..255 */
+static void clahe_lut( const uint32_t* hist, uint32_t area, double clip, uint8_t* lut )
+{
+    const uint32_t limit = clip * area / 256 > 1 ? clip * area / 256 : 1;
+    uint32_t h[256];
+    uint32_t excess = 0, cdf = 0;
+    int i, rem;
+
+    for( i = 0; i < 256; i++ ) {
+        h[i] = hist[i] > limit ? limit : hist[i];
+        excess += hist[i] - h[i];
+    }
+    for( i = 0; i < 256; i++ )
+        h[i] += excess / 256;
+    rem = excess % 256;
+    for( i = 0; i < rem; i++ )
+        h[i * 256 / rem]++;
+
+    for( i = 0; i < 256; i++ ) {
+        cdf += h[i];
+        lut[i] = ((uint64_t) cdf * 255 + area / 2) / area;
+    }
+}
+
+/* twice the centre of tile t of a side size long */
+static inline int clahe_centre( int t, int size )
+{
+    return t * IA_CACHE_TILE + ((t+1) * IA_CACHE_TILE < size ? (t+1) * IA_CACHE_TILE : size);
+}
+
+/* the tiles whose centres are either side of position x and the weight of
+ * the second in 1/256, the first and last tile hold their lut out to the edge */
+static int clahe_weight( int x, int size, int tiles, int* t0, int* t1 )
+{
+    int t = x / IA_CACHE_TILE;
+    int c0, c1;
+
+    if( 2*x < clahe_centre( t, size ) )
+        t--;
+    if( t < 0 || t+1 >= tiles ) {
+        *t0 = *t1 = t < 0 ? 0 : tiles-1;
+        return 0;
+    }
+    c0 = clahe_centre( t, size );
+    c1 = clahe_centre( t+1, size );
+    *t0 = t;
+    *t1 = t+1;
+    return (256 * (2*x - c0) + (c1 - c0) / 2) / (c1 - c0);
+}
+
+/* contrast limited adaptive histogram equalisation over the cached luma
+ * tile histograms. every tile gets its own clipped lut and the new luma of
+ * a pixel is the bilinear mix of the luts of the four tiles around it, its
+ * channels are scaled to it like equalize does. */
+void clahe_exec( ia_seq_t* s, ia_filter_param_t* fp, ia_image_t** iaim, ia_image_t* iar )
+{
+    ia_image_t* iaf = iaim[s->param->i_maxrefs-1];
+    const int w = iaf->i_width;
+    const int h = iaf->i_height;
+    ia_cache_entry_t* th = ia_cache_get( iaf, IA_CACHE_TILE_HIST );
+    ia_cache_entry_t* luma = ia_cache_get( iaf, IA_CACHE_LUMA );
+    uint8_t* lut = NULL;
+    int* col = NULL;
+    int row[3];
+    int tx, ty, x, y, c;
+
+    if( th != NULL ) {
+        lut = ia_malloc( th->i_width * th->i_height * 256 );
+        col = ia_malloc( 3 * w * sizeof(int) );
+    }
+    if( th == NULL || luma == NULL || lut == NULL || col == NULL ) {
+        fprintf( stderr, "ERROR: clahe_exec(): couldnt alloc tile luts\n" );
+        goto out;
+    }
+
+    for( ty = 0; ty < th->i_height; ty++ ) {
+        const int tht = ((ty+1) * IA_CACHE_TILE < h ? (ty+1) * IA_CACHE_TILE : h) - ty * IA_CACHE_TILE;
+        for( tx = 0; tx < th->i_width; tx++ ) {
+            const int tw = ((tx+1) * IA_CACHE_TILE < w ? (tx+1) * IA_CACHE_TILE : w) - tx * IA_CACHE_TILE;
+            const int t = ty * th->i_width + tx;
+            clahe_lut( (uint32_t*) th->data + t * 256, tw * tht, s->param->ClaheSettings.Clip, lut + t * 256 );
+        }
+    }
+
+    for( x = 0; x < w; x++ )
+        col[2*w+x] = clahe_weight( x, w, th->i_width, &col[x], &col[w+x] );
+
+    for( y = 0; y < h; y++ )
+    {
+        const ia_pixel_t* p = iaf->pix + (size_t)y * iaf->i_pitch;
+        const uint8_t* l = (uint8_t*) luma->data + y * luma->i_stride;
+        ia_pixel_t* d = iar->pix + (size_t)y * iar->i_pitch;
+        const uint8_t *l0, *l1;
+
+        row[2] = clahe_weight( y, h, th->i_height, &row[0], &row[1] );
+        l0 = lut + row[0] * th->i_width * 256;
+        l1 = lut + row[1] * th->i_width * 256;
+
+        for( x = 0; x < w; x++ )
+        {
+            const uint8_t* a = l0 + col[x] * 256;
+            const uint8_t* b = l0 + col[w+x] * 256;
+            const uint8_t* e = l1 + col[x] * 256;
+            const uint8_t* f = l1 + col[w+x] * 256;
+            const int wx = col[2*w+x];
+            const int wy = row[2];
+
+            const int v = l[x];
+            const int top = a[v] * (256-wx) + b[v] * wx;
+            const int bot = e[v] * (256-wx) + f[v] * wx;
+            const int yn = top * (256-wy) + bot * wy;     // Y' in 1/65536
+            const int gain = v ? (yn / v + 128) >> 8 : 0;   // Y'/Y in 1/256
+
+            for( c = 0; c < 3; c++ ) {
+                const int o = v ? (p[3*x+c] * gain + 128) >> 8 : (yn + 32768) >> 16;
+                d[3*x+c] = o < 255 ? o : 255;
+            }
+        }
+    }
+
+out:
+    ia_cache_release( th );
+    ia_cache_release( luma );
+    ia_free( lut );
+    ia_free( col );
+    fp = fp;
+}
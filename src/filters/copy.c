@@ -24,11 +24,7 @@
 
 inline void copy_exec( ia_seq_t* s, ia_filter_param_t* fp, ia_image_t** iaf, ia_image_t* iar )
 {
-    FIBITMAP* dib = iar->dib;
-    iar->dib = iaf[0]->dib;
-    iar->pix = FreeImage_GetBits( iar->dib );
-    iaf[0]->dib = dib;
-    iaf[0]->pix = FreeImage_GetBits( iaf[0]->dib );
+    ia_image_swap( iar, iaf[0] );
 
     fp = fp;
 }
@@ -0,0 +1,182 @@
+/******************************************************************************
+ * Copyright (c) 2008 Joey Degges
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *****************************************************************************/
+
+#include "corners.h"
+
+void corners_init( ia_seq_t* s, ia_filter_param_t** fp )
+{
+    const ia_param_t* p = s->param;
+    corners_t* c;
+
+    *fp = NULL;
+    if( (c = ia_calloc( 1, sizeof(corners_t) )) == NULL )
+        return;
+
+    c->i_method = p->CornersSettings.Method;
+    c->i_threshold = p->CornersSettings.Threshold;
+    c->i_cell_width = p->CornersSettings.CellWidth;
+    c->i_cell_height = p->CornersSettings.CellHeight;
+    c->i_max_per_cell = p->CornersSettings.MaxPerCell;
+    c->i_turn = p->i_maxrefs - 1;
+
+    if( p->CornersSettings.ListFile[0] ) {
+        if( !strcmp(p->CornersSettings.ListFile, "-") )
+            c->list = stdout;
+        else if( (c->list = fopen( p->CornersSettings.ListFile, "wb" )) == NULL )
+            fprintf( stderr, "ERROR: corners_init(): couldnt open keypoint list %s\n",
+                     p->CornersSettings.ListFile );
+    }
+
+    pthread_mutex_init( &c->mutex, NULL );
+    ia_pthread_cond_init( &c->cond, NULL );
+    *fp = (ia_filter_param_t*) c;
+}
+
+/* c->mutex must be held */
+static corners_kp_t* corners_kp_get( corners_t* c )
+{
+    corners_kp_t* kp = c->kp;
+
+    if( kp != NULL ) {
+        c->kp = kp->next;
+        return kp;
+    }
+    return ia_calloc( 1, sizeof(corners_kp_t) );
+}
+
+/* writes the keypoints of frame i_frame to the list once every earlier frame
+ * has. the rows of k are flipped to picture rows. */
+static void corners_write( corners_t* c, ia_keypoints_t* k, ia_image_t* iaf, uint64_t i_frame )
+{
+    corners_list_header_t hdr;
+    int i, rc;
+
+    hdr.i_frame = i_frame;
+    hdr.i_count = k != NULL ? k->i_kp : 0;
+    hdr.i_reserved = 0;
+
+    /* keypoint rows are image rows, the list has picture rows */
+    if( iaf->b_bottom_up )
+        for( i = 0; i < (int)hdr.i_count; i++ )
+            k->kp[i].y = iaf->i_height-1 - k->kp[i].y;
+
+    if( 0 != (rc = ia_pthread_mutex_lock( &c->mutex )) )
+        ia_pthread_error( rc, "corners_write()", "ia_pthread_mutex_lock()" );
+    while( c->i_turn != i_frame ) {
+        if( 0 != (rc = ia_pthread_cond_wait( &c->cond, &c->mutex )) )
+            ia_pthread_error( rc, "corners_write()", "ia_pthread_cond_wait()" );
+    }
+
+    if( fwrite( &hdr, sizeof(hdr), 1, c->list ) != 1 ||
+        (hdr.i_count && fwrite( k->kp, sizeof(ia_keypoint_t), hdr.i_count, c->list ) != hdr.i_count) )
+        fprintf( stderr, "ERROR: corners_write(): couldnt write keypoints of frame %llu\n",
+                 (long long unsigned) i_frame );
+
+    c->i_turn++;
+    if( 0 != (rc = ia_pthread_cond_broadcast( &c->cond )) )
+        ia_pthread_error( rc, "corners_write()", "ia_pthread_cond_broadcast()" );
+    if( 0 != (rc = ia_pthread_mutex_unlock( &c->mutex )) )
+        ia_pthread_error( rc, "corners_write()", "ia_pthread_mutex_unlock()" );
+}
+
+/* keypoints of the current frame, see ia_keypoints_detect. the output is the
+ * frame with a green square around every keypoint. */
+void corners_exec( ia_seq_t* s, ia_filter_param_t* fp, ia_image_t** iaim, ia_image_t* iar )
+{
+    corners_t* c = (corners_t*) fp;
+    ia_image_t* iaf = iaim[s->param->i_maxrefs-1];
+    corners_kp_t* kp;
+    ia_keypoints_t* k = NULL;
+    int i, j, rc;
+
+    if( c == NULL )
+        return;
+
+    memcpy( iar->pix, iaf->pix, iaf->i_pitch * iaf->i_height );
+
+    if( 0 != (rc = ia_pthread_mutex_lock( &c->mutex )) )
+        ia_pthread_error( rc, "corners_exec()", "ia_pthread_mutex_lock()" );
+    kp = corners_kp_get( c );
+    if( 0 != (rc = ia_pthread_mutex_unlock( &c->mutex )) )
+        ia_pthread_error( rc, "corners_exec()", "ia_pthread_mutex_unlock()" );
+
+    if( kp == NULL || ia_keypoints_detect( &kp->k, iaf, c->i_method, c->i_threshold, c->i_cell_width,
+                                           c->i_cell_height, c->i_max_per_cell ) )
+        fprintf( stderr, "ERROR: corners_exec(): couldnt alloc keypoint buffers\n" );
+    else
+        k = &kp->k;
+
+    for( i = 0; k != NULL && i < k->i_kp; i++ )
+    {
+        const int x = k->kp[i].x;
+        const int y = k->kp[i].y;
+
+        /* keypoints are at least IA_KEYPOINTS_BORDER from the edge */
+        for( j = -2; j <= 2; j++ ) {
+            ia_pixel_t* p[4] = {
+                iar->pix + offset( iar->i_pitch, x+j, y-2, 0 ),
+                iar->pix + offset( iar->i_pitch, x+j, y+2, 0 ),
+                iar->pix + offset( iar->i_pitch, x-2, y+j, 0 ),
+                iar->pix + offset( iar->i_pitch, x+2, y+j, 0 ) };
+            int e;
+            for( e = 0; e < 4; e++ ) {
+                p[e][0] = 0;
+                p[e][1] = 255;
+                p[e][2] = 0;
+            }
+        }
+    }
+
+    if( c->list )
+        corners_write( c, k, iaf, iar->i_frame );
+
+    if( kp != NULL ) {
+        if( 0 != (rc = ia_pthread_mutex_lock( &c->mutex )) )
+            ia_pthread_error( rc, "corners_exec()", "ia_pthread_mutex_lock()" );
+        kp->next = c->kp;
+        c->kp = kp;
+        if( 0 != (rc = ia_pthread_mutex_unlock( &c->mutex )) )
+            ia_pthread_error( rc, "corners_exec()", "ia_pthread_mutex_unlock()" );
+    }
+}
+
+void corners_clos( ia_filter_param_t* fp )
+{
+    corners_t* c = (corners_t*) fp;
+
+    if( c == NULL )
+        return;
+
+    while( c->kp != NULL ) {
+        corners_kp_t* next = c->kp->next;
+        ia_keypoints_free( &c->kp->k );
+        ia_free( c->kp );
+        c->kp = next;
+    }
+    if( c->list && c->list != stdout )
+        fclose( c->list );
+    else if( c->list )
+        fflush( c->list );
+    pthread_mutex_destroy( &c->mutex );
+    pthread_cond_destroy( &c->cond );
+    ia_free( c );
+}
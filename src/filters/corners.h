@@ -0,0 +1,66 @@
+/******************************************************************************
+ * Copyright (c) 2008 Joey Degges
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *****************************************************************************/
+
+#ifndef _H_CORNERS
+#define _H_CORNERS
+
+#include "filters.h"
+#include "keypoints.h"
+
+/* --corners-list is binary, in frame order: for every frame this header
+ * followed by i_count ia_keypoint_t, all in host byte order. keypoint rows
+ * count from the top of the picture. */
+typedef struct corners_list_header_t
+{
+    uint64_t    i_frame;
+    uint32_t    i_count;
+    uint32_t    i_reserved;     // 0
+} corners_list_header_t;
+
+/* per worker keypoint buffers, kept on a free list between frames */
+typedef struct corners_kp_t
+{
+    struct corners_kp_t* next;
+    ia_keypoints_t k;
+} corners_kp_t;
+
+typedef struct corners_t
+{
+    int         i_method;       // IA_KEYPOINTS_FAST or IA_KEYPOINTS_HARRIS
+    int         i_threshold;
+    int         i_cell_width;
+    int         i_cell_height;
+    int         i_max_per_cell;
+
+    /* the keypoint list, written in frame order */
+    FILE*       list;
+    uint64_t    i_turn;         // next frame allowed to write
+    corners_kp_t* kp;
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;
+} corners_t;
+
+void corners_init( ia_seq_t*, ia_filter_param_t** );
+void corners_exec( ia_seq_t*, ia_filter_param_t*, ia_image_t**, ia_image_t* );
+void corners_clos( ia_filter_param_t* );
+
+#endif
@@ -24,11 +24,19 @@
 
 inline void diff_exec( ia_seq_t* s, ia_filter_param_t* fp, ia_image_t** iaim, ia_image_t* iar )
 {
-    int i;
+    int x, y;
 
     assert( s->param->i_maxrefs > 1 );
-    
-    for(i = 0; i < s->param->i_size*3; i++)
-        iar->pix[i] = fabs( iaim[0]->pix[i] - iaim[1]->pix[i] );
+
+    /* rows are i_pitch apart, the padding at their ends is left alone */
+    for( y = 0; y < iar->i_height; y++ )
+    {
+        const ia_pixel_t* a = iaim[0]->pix + (size_t)y * iaim[0]->i_pitch;
+        const ia_pixel_t* b = iaim[1]->pix + (size_t)y * iaim[1]->i_pitch;
+        ia_pixel_t* r = iar->pix + (size_t)y * iar->i_pitch;
+
+        for( x = 0; x < iar->i_width*3; x++ )
+            r[x] = abs( a[x] - b[x] );
+    }
     fp = fp;
 }
@@ -26,16 +26,21 @@ void draw_best_box_exec( ia_seq_t* s, ia_filter_param_t* fp, ia_image_t** iaim,
 {
     int i, j;
     int top, bottom, left, right;
-    ia_image_t* iaf = iaim[0];
+    ia_cache_entry_t* luma = ia_cache_get( iaim[0], IA_CACHE_LUMA );
+
+    if( luma == NULL )
+        return;
 
     top    = left  =  INT_MAX;
     bottom = right = -INT_MAX;
 
     for( i = 0; i < s->param->i_height; i++ )
     {
+        const uint8_t* l = (uint8_t*) luma->data + i * luma->i_stride;
+
         for( j = 0; j < s->param->i_width; j++ )
         {
-            if( iaf->pix[O(i,j)] > 128 )
+            if( l[j] > 128 )
             {
                 top    = (   top > i) ? i : top;
                 left   = (  left > j) ? j : left;
@@ -43,9 +48,9 @@ void draw_best_box_exec( ia_seq_t* s, ia_filter_param_t* fp, ia_image_t** iaim,
                 right  = ( right < j) ? j : right;
             }
 
-            iar->pix[O(i,j)+0] = 0;
-            iar->pix[O(i,j)+1] = 0;
-            iar->pix[O(i,j)+2] = 0;
+            iar->pix[offset(iar->i_pitch,j,i,0)] = 0;
+            iar->pix[offset(iar->i_pitch,j,i,1)] = 0;
+            iar->pix[offset(iar->i_pitch,j,i,2)] = 0;
         }
     }
 
@@ -53,10 +58,11 @@ void draw_best_box_exec( ia_seq_t* s, ia_filter_param_t* fp, ia_image_t** iaim,
     {
         for( j = left; j <= right; j++ )
         {
-            iar->pix[O(i,j)+0] = 255;
-            iar->pix[O(i,j)+1] = 255;
-            iar->pix[O(i,j)+2] = 255;
+            iar->pix[offset(iar->i_pitch,j,i,0)] = 255;
+            iar->pix[offset(iar->i_pitch,j,i,1)] = 255;
+            iar->pix[offset(iar->i_pitch,j,i,2)] = 255;
         }
     }
+    ia_cache_release( luma );
     fp = fp;
 }
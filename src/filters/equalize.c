@@ -0,0 +1,80 @@
+/******************************************************************************
+ * Copyright (c) 2008 Joey Degges
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *****************************************************************************/
+
+#include "equalize.h"
+
+/* histogram equalisation. the luma histogram of the frame is the sum of its
+ * cached tile histograms, its cdf stretched over 0..255 is a lut from the
+ * luma Y of a pixel to its new luma Y'. the channels are all scaled by Y'/Y
+ * so colours keep their balance, black pixels just become grey Y'. */
+void equalize_exec( ia_seq_t* s, ia_filter_param_t* fp, ia_image_t** iaim, ia_image_t* iar )
+{
+    ia_image_t* iaf = iaim[s->param->i_maxrefs-1];
+    ia_cache_entry_t* th = ia_cache_get( iaf, IA_CACHE_TILE_HIST );
+    ia_cache_entry_t* luma = ia_cache_get( iaf, IA_CACHE_LUMA );
+    uint32_t hist[256] = { 0 };
+    uint8_t lut[256];
+    int gain[256];      // Y'/Y in 1/256
+    uint32_t cdf = 0, first, total;
+    int i, t, x, y, c;
+
+    if( th == NULL || luma == NULL ) {
+        fprintf( stderr, "ERROR: equalize_exec(): couldnt alloc tile histograms\n" );
+        ia_cache_release( th );
+        ia_cache_release( luma );
+        return;
+    }
+
+    for( t = 0; t < th->i_width * th->i_height; t++ ) {
+        const uint32_t* h = (uint32_t*) th->data + t * 256;
+        for( i = 0; i < 256; i++ )
+            hist[i] += h[i];
+    }
+    ia_cache_release( th );
+
+    /* the darkest level present goes to 0, the brightest to 255 */
+    for( i = 0; i < 255 && hist[i] == 0; i++ );
+    first = hist[i];
+    total = (uint32_t) iaf->i_width * iaf->i_height;
+    for( i = 0; i < 256; i++ ) {
+        cdf += hist[i];
+        lut[i] = total > first && cdf > first ? (int)(((uint64_t)(cdf - first) * 255 + (total - first) / 2) / (total - first))
+                                              : total > first ? 0 : i;
+    }
+
+    for( i = 1; i < 256; i++ )
+        gain[i] = ((lut[i] << 8) + i/2) / i;
+
+    for( y = 0; y < iaf->i_height; y++ ) {
+        const ia_pixel_t* p = iaf->pix + (size_t)y * iaf->i_pitch;
+        const uint8_t* l = (uint8_t*) luma->data + y * luma->i_stride;
+        ia_pixel_t* d = iar->pix + (size_t)y * iar->i_pitch;
+        for( x = 0; x < iaf->i_width; x++ ) {
+            for( c = 0; c < 3; c++ ) {
+                const int v = l[x] ? (p[3*x+c] * gain[l[x]] + 128) >> 8 : lut[0];
+                d[3*x+c] = v < 255 ? v : 255;
+            }
+        }
+    }
+    ia_cache_release( luma );
+    fp = fp;
+}
@@ -23,29 +23,72 @@
 #include "filters.h"
 
 /* Import filters */
+#include "bgsub.h"
+#include "bhatta.h"
+#include "blobs.h"
 #include "blur.h"
+#include "canny.h"
+#include "clahe.h"
+#include "closing.h"
 #include "copy.h"
+#include "corners.h"
 #include "curvature.h"
 #include "diff.h"
+#include "dilate.h"
 #include "draw_best_box.h"
 #include "edges.h"
+#include "equalize.h"
+#include "erode.h"
 #include "flow.h"
 #include "grayscale.h"
+#include "median.h"
 #include "monkey.h"
 #include "normal.h"
+#include "opening.h"
 #include "sad.h"
 #include "ssd.h"
+#include "template.h"
+#include "tmedian.h"
+#include "track.h"
 
 void init_filters( void )
 {
+    filters.init[BGSUB]                = &bgsub_init;
+    filters.exec[BGSUB]                = &bgsub_exec;
+    filters.clos[BGSUB]                = &bgsub_clos;
+
+    filters.init[BHATTA]               = &bhatta_init;
+    filters.exec[BHATTA]               = &bhatta_exec;
+    filters.clos[BHATTA]               = &bhatta_clos;
+
+    filters.init[BLOBS]                = &blobs_init;
+    filters.exec[BLOBS]                = &blobs_exec;
+    filters.clos[BLOBS]                = &blobs_clos;
+
     filters.init[BLUR]                 = NULL;
     filters.exec[BLUR]                 = &blur_exec;
     filters.clos[BLUR]                 = NULL;
 
+    filters.init[CANNY]                = NULL;
+    filters.exec[CANNY]                = &canny_exec;
+    filters.clos[CANNY]                = NULL;
+
+    filters.init[CLAHE]                = NULL;
+    filters.exec[CLAHE]                = &clahe_exec;
+    filters.clos[CLAHE]                = NULL;
+
+    filters.init[CLOSING]              = NULL;
+    filters.exec[CLOSING]              = &closing_exec;
+    filters.clos[CLOSING]              = NULL;
+
     filters.init[COPY]                 = NULL;
     filters.exec[COPY]                 = &copy_exec;
     filters.clos[COPY]                 = NULL;
 
+    filters.init[CORNERS]              = &corners_init;
+    filters.exec[CORNERS]              = &corners_exec;
+    filters.clos[CORNERS]              = &corners_clos;
+
     filters.init[CURVATURE]            = NULL;
     filters.exec[CURVATURE]            = &curvature_exec;
     filters.clos[CURVATURE]            = NULL;
@@ -54,6 +97,10 @@ void init_filters( void )
     filters.exec[DIFF]                 = &diff_exec;
     filters.clos[DIFF]                 = NULL;
 
+    filters.init[DILATE]               = NULL;
+    filters.exec[DILATE]               = &dilate_exec;
+    filters.clos[DILATE]               = NULL;
+
     filters.init[DRAW_BEST_BOX]        = NULL;
     filters.exec[DRAW_BEST_BOX]        = &draw_best_box_exec;
     filters.clos[DRAW_BEST_BOX]        = NULL;
@@ -62,6 +109,14 @@ void init_filters( void )
     filters.exec[EDGES]                = &fstderiv_exec;
     filters.clos[EDGES]                = NULL;
 
+    filters.init[EQUALIZE]             = NULL;
+    filters.exec[EQUALIZE]             = &equalize_exec;
+    filters.clos[EQUALIZE]             = NULL;
+
+    filters.init[ERODE]                = NULL;
+    filters.exec[ERODE]                = &erode_exec;
+    filters.clos[ERODE]                = NULL;
+
     filters.init[FLOW]                 = NULL;
     filters.exec[FLOW]                 = &flow_exec;
     filters.clos[FLOW]                 = NULL;
@@ -70,7 +125,11 @@ void init_filters( void )
     filters.exec[GRAYSCALE]            = &grayscale_exec;
     filters.clos[GRAYSCALE]            = NULL;
 
-    filters.init[MONKEY]               = NULL;
+    filters.init[MEDIAN]               = &median_init;
+    filters.exec[MEDIAN]               = &median_exec;
+    filters.clos[MEDIAN]               = &median_clos;
+
+    filters.init[MONKEY]               = &monkey_init;
     filters.exec[MONKEY]               = &monkey_exec;
     filters.clos[MONKEY]               = NULL;
 
@@ -78,6 +137,10 @@ void init_filters( void )
     filters.exec[NORMAL]               = &normal_exec;
     filters.clos[NORMAL]               = NULL;
 
+    filters.init[OPENING]              = NULL;
+    filters.exec[OPENING]              = &opening_exec;
+    filters.clos[OPENING]              = NULL;
+
     filters.init[SAD]                  = NULL;
     filters.exec[SAD]                  = &sad_exec;
     filters.clos[SAD]                  = NULL;
@@ -86,4 +149,16 @@ void init_filters( void )
     filters.exec[SSD]                  = &ssd_exec;
     filters.clos[SSD]                  = NULL;
 
+    filters.init[TEMPLATE]             = &template_init;
+    filters.exec[TEMPLATE]             = &template_exec;
+    filters.clos[TEMPLATE]             = &template_clos;
+
+    filters.init[TMEDIAN]              = &tmedian_init;
+    filters.exec[TMEDIAN]              = &tmedian_exec;
+    filters.clos[TMEDIAN]              = NULL;
+
+    filters.init[TRACK]                = &track_init;
+    filters.exec[TRACK]                = &track_exec;
+    filters.clos[TRACK]                = &track_clos;
+
 }
@@ -34,34 +34,66 @@
 #include "common.h"
 #include "image_analyzer.h"
 #include "ia_sequence.h"
+#include "cache.h"
+#include "tstats.h"
 
 /* Filters Indexes */
-#define BLUR            1
-#define COPY            2
-#define CURVATURE       3
-#define DIFF            4
-#define DRAW_BEST_BOX   5
-#define EDGES           6
-#define FLOW            7
-#define GRAYSCALE       8
-#define MONKEY          9
-#define NORMAL          10
-#define SAD             11
-#define SSD             12
+#define BGSUB           1
+#define BHATTA          2
+#define BLOBS           3
+#define BLUR            4
+#define CANNY           5
+#define CLAHE           6
+#define CLOSING         7
+#define COPY            8
+#define CORNERS         9
+#define CURVATURE       10
+#define DIFF            11
+#define DILATE          12
+#define DRAW_BEST_BOX   13
+#define EDGES           14
+#define EQUALIZE        15
+#define ERODE           16
+#define FLOW            17
+#define GRAYSCALE       18
+#define MEDIAN          19
+#define MONKEY          20
+#define NORMAL          21
+#define OPENING         22
+#define SAD             23
+#define SSD             24
+#define TEMPLATE        25
+#define TMEDIAN         26
+#define TRACK           27
 
 static const char FILTERS[][30] = {
+    {"BGSUB"},
+    {"BHATTA"},
+    {"BLOBS"},
     {"BLUR"},
+    {"CANNY"},
+    {"CLAHE"},
+    {"CLOSING"},
     {"COPY"},
+    {"CORNERS"},
     {"CURVATURE"},
     {"DIFF"},
+    {"DILATE"},
     {"DRAW_BEST_BOX"},
     {"EDGES"},
+    {"EQUALIZE"},
+    {"ERODE"},
     {"FLOW"},
     {"GRAYSCALE"},
+    {"MEDIAN"},
     {"MONKEY"},
     {"NORMAL"},
+    {"OPENING"},
     {"SAD"},
     {"SSD"},
+    {"TEMPLATE"},
+    {"TMEDIAN"},
+    {"TRACK"},
     {0}
 };
 
@@ -70,8 +102,6 @@ static inline int offset( int w, int x, int y, int p )
     return w*y + x*3+p;
 }
 
-#define O( y,x ) (s->param->i_width*3*y + x*3)
-
 
 /* Set up the filter function pointers */
 typedef void (*init_funcs)(ia_seq_t*, ia_filter_param_t**);
@@ -80,9 +110,9 @@ typedef void (*clos_funcs)(ia_filter_param_t*);
 
 typedef struct ia_filters_t
 {
-    init_funcs      init[20];
-    exec_funcs      exec[20];
-    clos_funcs      clos[20];
+    init_funcs      init[IA_MAX_FILTERS];
+    exec_funcs      exec[IA_MAX_FILTERS];
+    clos_funcs      clos[IA_MAX_FILTERS];
 } ia_filters_t;
 
 ia_filters_t filters;
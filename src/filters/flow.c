@@ -26,20 +26,30 @@ inline void flow_exec( ia_seq_t* s, ia_filter_param_t* fp, ia_image_t** iaim, ia
 {
     int i;
     double lmin, op;
+    ia_cache_entry_t *sum0, *sum2;
 
     lmin = -255*9;
     op = 255.0 / (255*9*2);  //  = max / (lmax - lmin)
 
     assert( s->param->i_maxrefs > 2 );
 
+    /* the window sums of both frames come from their integral images, which
+     * every other output frame using them as refs shares */
+    sum0 = ia_cache_get( iaim[0], IA_CACHE_INTEGRAL_BGR );
+    sum2 = ia_cache_get( iaim[2], IA_CACHE_INTEGRAL_BGR );
+    if( sum0 == NULL || sum2 == NULL ) {
+        ia_cache_release( sum0 );
+        ia_cache_release( sum2 );
+        return;
+    }
+
     for ( i = 0; i < s->param->i_height; i++ )
     {
         int j;
 
         for ( j = 0; j < s->param->i_width; j++)
         {
-            int h, k;
-            double dzr, dzg, dzb;
+            int pix;
 
             if ( i == 0 || j == 0 || j == s->param->i_width-1 || i == s->param->i_height-1 )
             {
@@ -47,24 +57,16 @@ inline void flow_exec( ia_seq_t* s, ia_filter_param_t* fp, ia_image_t** iaim, ia
                 continue;
             }
 
-            dzr = dzg = dzb = 0;
-            for( h = i-1; h < i+1; h++ )
+            /* 2x2 window ending at (j,i) */
+            for( pix = 0; pix < 3; pix++ )
             {
-                for( k = j-1; k < j+1; k++ )
-                {
-                    dzr += (iaim[2]->pix[offset(iar->i_pitch,k,h,0)]
-                         - iaim[0]->pix[offset(iar->i_pitch,k,h,0)]);
-                    dzg += (iaim[2]->pix[offset(iar->i_pitch,k,h,1)]
-                         - iaim[0]->pix[offset(iar->i_pitch,k,h,1)]);
-                    dzb += (iaim[2]->pix[offset(iar->i_pitch,k,h,2)]
-                         - iaim[0]->pix[offset(iar->i_pitch,k,h,2)]);
-                }
+                double dz = (int)ia_cache_box32( sum2, j-1, i-1, j+1, i+1, pix )
+                          - (int)ia_cache_box32( sum0, j-1, i-1, j+1, i+1, pix );
+                iar->pix[offset(iar->i_pitch,j,i,pix)] = ( dz - lmin ) * op;
             }
-
-            iar->pix[offset(iar->i_pitch,j,i,0)] = ( dzr - lmin ) * op;
-            iar->pix[offset(iar->i_pitch,j,i,1)] = ( dzg - lmin ) * op;
-            iar->pix[offset(iar->i_pitch,j,i,2)] = ( dzb - lmin ) * op;
         }
     }
+    ia_cache_release( sum0 );
+    ia_cache_release( sum2 );
     fp = fp;
 }
@@ -24,21 +24,23 @@
 
 inline void grayscale_exec( ia_seq_t* s, ia_filter_param_t* fp, ia_image_t** iaim, ia_image_t* iar )
 {
-    ia_image_t* iaf = iaim[0];
+    ia_cache_entry_t* luma = ia_cache_get( iaim[0], IA_CACHE_LUMA );
     int i;
 
+    if( luma == NULL )
+        return;
+
     for( i = s->param->i_height; i--; )
     {
+        const uint8_t* l = (uint8_t*) luma->data + i * luma->i_stride;
         int j;
         for( j = s->param->i_width; j--; )
         {
             int pix;
-            double gray = 0.30 * iaf->pix[offset(iaf->i_pitch,j,i,0)]
-                        + 0.59 * iaf->pix[offset(iaf->i_pitch,j,i,1)]
-                        + 0.11 * iaf->pix[offset(iaf->i_pitch,j,i,2)];
             for( pix = 3; pix--; )
-                iar->pix[offset(iaf->i_pitch,j,i,pix)] = gray;
+                iar->pix[offset(iar->i_pitch,j,i,pix)] = l[j];
         }
     }
+    ia_cache_release( luma );
     fp = fp;
 }
@@ -0,0 +1,314 @@
+/******************************************************************************
+ * Copyright (c) 2008 Joey Degges
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *****************************************************************************/
+
+#include "median.h"
+
+/* perreault-hebert constant time median. every column keeps the histogram of
+ * its 2r+1 samples around the row, which moves down by one add and one
+ * remove. the window histogram is the sum of 2r+1 column histograms and moves
+ * right by one column add and one remove. histograms are 16 coarse bins of 16
+ * fine ones: the coarse level is kept up to date, a fine one only when the
+ * median falls into it, catching up on the columns it missed. per pixel that
+ * is a fixed number of 16 bin adds whatever the radius. */
+
+typedef struct median_hist_t
+{
+    uint16_t    coarse[16];
+    uint16_t    fine[256];
+} median_hist_t;
+
+static inline int median_clamp( int v, int max )
+{
+    return v < 0 ? 0 : v > max ? max : v;
+}
+
+/* the bin loops have a fixed length of 16 so they vectorize */
+static inline void median_add16( uint16_t* d, const uint16_t* a, const uint16_t* b )
+{
+    int i;
+    for( i = 0; i < 16; i++ )
+        d[i] += a[i] - b[i];
+}
+
+static inline void median_sum16( uint16_t* d, const uint16_t* a )
+{
+    int i;
+    for( i = 0; i < 16; i++ )
+        d[i] += a[i];
+}
+
+/* rows [y0,y1) of channel c */
+static void median_band( ia_image_t* src, ia_image_t* dst, int r, int c, int y0, int y1,
+                         median_hist_t* col )
+{
+    const int w = src->i_width;
+    const int h = src->i_height;
+    const int t = (2*r+1) * (2*r+1) / 2;
+    median_hist_t k;
+    int luc[16];    // fine bin b holds the columns before luc[b]
+    int x, y, i, b;
+
+#define PIX(x,y) src->pix[(size_t)(y) * src->i_pitch + 3*(x) + c]
+
+    memset( col, 0, w * sizeof(median_hist_t) );
+    for( i = y0 - r; i <= y0 + r; i++ ) {
+        for( x = 0; x < w; x++ ) {
+            const uint8_t v = PIX( x, median_clamp(i, h-1) );
+            col[x].coarse[v >> 4]++;
+            col[x].fine[v]++;
+        }
+    }
+
+    for( y = y0; y < y1; y++ )
+    {
+        ia_pixel_t* d = dst->pix + (size_t)y * dst->i_pitch + c;
+
+        if( y > y0 ) {
+            const int yo = median_clamp( y - r - 1, h-1 );
+            const int yi = median_clamp( y + r, h-1 );
+            for( x = 0; x < w; x++ ) {
+                const uint8_t vo = PIX( x, yo );
+                const uint8_t vi = PIX( x, yi );
+                col[x].coarse[vo >> 4]--;
+                col[x].fine[vo]--;
+                col[x].coarse[vi >> 4]++;
+                col[x].fine[vi]++;
+            }
+        }
+
+        memset( &k, 0, sizeof(k) );
+        for( i = -r; i <= r; i++ )
+            median_sum16( k.coarse, col[median_clamp(i, w-1)].coarse );
+        for( b = 0; b < 16; b++ )
+            luc[b] = -r - 1;     // nothing is valid yet
+
+        for( x = 0; x < w; x++ )
+        {
+            int sum = 0;
+
+            if( x > 0 )
+                median_add16( k.coarse, col[median_clamp(x+r, w-1)].coarse,
+                              col[median_clamp(x-r-1, w-1)].coarse );
+
+            for( b = 0; sum + k.coarse[b] <= t; b++ )
+                sum += k.coarse[b];
+
+            /* bring the fine bins of b up to the window [x-r, x+r] */
+            if( luc[b] <= x - r ) {
+                memset( &k.fine[16*b], 0, 16 * sizeof(uint16_t) );
+                for( i = x - r; i <= x + r; i++ )
+                    median_sum16( &k.fine[16*b], &col[median_clamp(i, w-1)].fine[16*b] );
+            } else {
+                for( i = luc[b]; i <= x + r; i++ )
+                    median_add16( &k.fine[16*b], &col[median_clamp(i, w-1)].fine[16*b],
+                                  &col[median_clamp(i-2*r-1, w-1)].fine[16*b] );
+            }
+            luc[b] = x + r + 1;
+
+            for( i = 16*b; sum + k.fine[i] <= t; i++ )
+                sum += k.fine[i];
+            d[3*x] = i;
+        }
+    }
+#undef PIX
+}
+
+/* takes the next band of the first frame that has one, NULL if none.
+ * m->mutex must be held */
+static median_frame_t* median_take( median_t* m, int* job )
+{
+    median_frame_t* f = m->frames;
+
+    if( f == NULL )
+        return NULL;
+    *job = f->i_next++;
+    if( f->i_next == f->i_jobs )
+        m->frames = f->next;
+    return f;
+}
+
+/* runs job of f and tells the waiting worker once it was the last */
+static void median_job( median_t* m, median_frame_t* f, int job, median_hist_t* col )
+{
+    const int y = job / 3 * MEDIAN_BAND_ROWS;
+    int rc;
+
+    median_band( f->src, f->dst, f->i_radius, job % 3, y,
+                 median_clamp( y + MEDIAN_BAND_ROWS, f->src->i_height ), col );
+
+    if( 0 != (rc = ia_pthread_mutex_lock( &m->mutex )) )
+        ia_pthread_error( rc, "median_job()", "ia_pthread_mutex_lock()" );
+    if( ++f->i_done == f->i_jobs ) {
+        if( 0 != (rc = ia_pthread_cond_broadcast( &m->done )) )
+            ia_pthread_error( rc, "median_job()", "ia_pthread_cond_broadcast()" );
+    }
+    if( 0 != (rc = ia_pthread_mutex_unlock( &m->mutex )) )
+        ia_pthread_error( rc, "median_job()", "ia_pthread_mutex_unlock()" );
+}
+
+static void* median_thread( void* arg )
+{
+    median_t* m = (median_t*) arg;
+    median_hist_t* col = ia_malloc( m->i_width * sizeof(median_hist_t) );
+    median_frame_t* f;
+    int job, rc;
+
+    if( col == NULL ) {
+        fprintf( stderr, "ERROR: median_thread(): couldnt alloc column histograms\n" );
+        return NULL;
+    }
+
+    for( ;; )
+    {
+        if( 0 != (rc = ia_pthread_mutex_lock( &m->mutex )) )
+            ia_pthread_error( rc, "median_thread()", "ia_pthread_mutex_lock()" );
+        while( !m->b_stop && (f = median_take( m, &job )) == NULL ) {
+            if( 0 != (rc = ia_pthread_cond_wait( &m->cond, &m->mutex )) )
+                ia_pthread_error( rc, "median_thread()", "ia_pthread_cond_wait()" );
+        }
+        if( 0 != (rc = ia_pthread_mutex_unlock( &m->mutex )) )
+            ia_pthread_error( rc, "median_thread()", "ia_pthread_mutex_unlock()" );
+        if( m->b_stop )
+            break;
+
+        median_job( m, f, job, col );
+    }
+
+    ia_free( col );
+    return NULL;
+}
+
+void median_init( ia_seq_t* s, ia_filter_param_t** fp )
+{
+    median_t* m;
+    long cores = sysconf( _SC_NPROCESSORS_ONLN );
+    int bands = (s->param->i_height + MEDIAN_BAND_ROWS-1) / MEDIAN_BAND_ROWS;
+    int i, rc;
+
+    *fp = NULL;
+    if( (m = ia_calloc( 1, sizeof(median_t) )) == NULL )
+        return;
+
+    /* the frame worker runs bands too, so one thread less than there are
+     * cores or jobs in a frame */
+    m->i_width = s->param->i_width;
+    m->i_threads = cores < 1 ? 0 : cores > MEDIAN_MAX_THREADS ? MEDIAN_MAX_THREADS : cores;
+    if( m->i_threads > 3 * bands )
+        m->i_threads = 3 * bands;
+    m->i_threads = m->i_threads > 0 ? m->i_threads - 1 : 0;
+
+    pthread_mutex_init( &m->mutex, NULL );
+    ia_pthread_cond_init( &m->cond, NULL );
+    ia_pthread_cond_init( &m->done, NULL );
+    for( i = 0; i < m->i_threads; i++ ) {
+        if( 0 != (rc = ia_pthread_create( &m->threads[i], NULL, &median_thread, m )) ) {
+            ia_pthread_error( rc, "median_init()", "ia_pthread_create()" );
+            m->i_threads = i;
+            break;
+        }
+    }
+    *fp = (ia_filter_param_t*) m;
+}
+
+/* median of the (2r+1)x(2r+1) square around every pixel, per channel, with
+ * the edge pixels repeated outwards. the frame is done in bands of rows that
+ * each build their column histograms from scratch, so they dont depend on
+ * each other and are shared out to the pool. */
+void median_exec( ia_seq_t* s, ia_filter_param_t* fp, ia_image_t** iaim, ia_image_t* iar )
+{
+    median_t* m = (median_t*) fp;
+    ia_image_t* iaf = iaim[s->param->i_maxrefs-1];
+    median_hist_t* col;
+    median_frame_t f;
+    median_frame_t** pf;
+    int job, rc;
+
+    if( m == NULL )
+        return;
+
+    if( (col = ia_malloc( iaf->i_width * sizeof(median_hist_t) )) == NULL ) {
+        fprintf( stderr, "ERROR: median_exec(): couldnt alloc column histograms\n" );
+        return;
+    }
+
+    memset( &f, 0, sizeof(median_frame_t) );
+    f.src = iaf;
+    f.dst = iar;
+    f.i_radius = median_clamp( s->param->MedianSettings.Radius, MEDIAN_MAX_RADIUS );
+    f.i_jobs = 3 * ((iaf->i_height + MEDIAN_BAND_ROWS-1) / MEDIAN_BAND_ROWS);
+
+    if( 0 != (rc = ia_pthread_mutex_lock( &m->mutex )) )
+        ia_pthread_error( rc, "median_exec()", "ia_pthread_mutex_lock()" );
+    for( pf = &m->frames; *pf != NULL; pf = &(*pf)->next );
+    *pf = &f;
+    if( 0 != (rc = ia_pthread_cond_broadcast( &m->cond )) )
+        ia_pthread_error( rc, "median_exec()", "ia_pthread_cond_broadcast()" );
+
+    /* takes the bands of this frame until they are all taken, then waits
+     * for the pool to finish the ones it has */
+    while( f.i_next < f.i_jobs ) {
+        job = f.i_next++;
+        if( f.i_next == f.i_jobs ) {
+            for( pf = &m->frames; *pf != &f; pf = &(*pf)->next );
+            *pf = f.next;
+        }
+        if( 0 != (rc = ia_pthread_mutex_unlock( &m->mutex )) )
+            ia_pthread_error( rc, "median_exec()", "ia_pthread_mutex_unlock()" );
+        median_job( m, &f, job, col );
+        if( 0 != (rc = ia_pthread_mutex_lock( &m->mutex )) )
+            ia_pthread_error( rc, "median_exec()", "ia_pthread_mutex_lock()" );
+    }
+    while( f.i_done < f.i_jobs ) {
+        if( 0 != (rc = ia_pthread_cond_wait( &m->done, &m->mutex )) )
+            ia_pthread_error( rc, "median_exec()", "ia_pthread_cond_wait()" );
+    }
+    if( 0 != (rc = ia_pthread_mutex_unlock( &m->mutex )) )
+        ia_pthread_error( rc, "median_exec()", "ia_pthread_mutex_unlock()" );
+
+    ia_free( col );
+}
+
+void median_clos( ia_filter_param_t* fp )
+{
+    median_t* m = (median_t*) fp;
+    int i, rc;
+
+    if( m == NULL )
+        return;
+
+    if( 0 != (rc = ia_pthread_mutex_lock( &m->mutex )) )
+        ia_pthread_error( rc, "median_clos()", "ia_pthread_mutex_lock()" );
+    m->b_stop = true;
+    if( 0 != (rc = ia_pthread_cond_broadcast( &m->cond )) )
+        ia_pthread_error( rc, "median_clos()", "ia_pthread_cond_broadcast()" );
+    if( 0 != (rc = ia_pthread_mutex_unlock( &m->mutex )) )
+        ia_pthread_error( rc, "median_clos()", "ia_pthread_mutex_unlock()" );
+
+    for( i = 0; i < m->i_threads; i++ ) {
+        if( 0 != (rc = ia_pthread_join( m->threads[i], NULL )) )
+            ia_pthread_error( rc, "median_clos()", "ia_pthread_join()" );
+    }
+    pthread_mutex_destroy( &m->mutex );
+    pthread_cond_destroy( &m->cond );
+    pthread_cond_destroy( &m->done );
+    ia_free( m );
+}
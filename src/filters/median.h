@@ -0,0 +1,64 @@
+/******************************************************************************
+ * Copyright (c) 2008 Joey Degges
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *****************************************************************************/
+
+#ifndef _H_MEDIAN
+#define _H_MEDIAN
+
+#include "filters.h"
+
+#define MEDIAN_MAX_RADIUS   127     // keeps a window count in 16 bits
+
+/* rows a band starts its column histograms over from */
+#define MEDIAN_BAND_ROWS    64
+#define MEDIAN_MAX_THREADS  16
+
+/* the bands of one frame, every band is done once per channel */
+typedef struct median_frame_t
+{
+    struct median_frame_t* next;
+    ia_image_t* src;
+    ia_image_t* dst;
+    int         i_radius;
+    int         i_jobs;         // bands times channels
+    int         i_next;         // next job to take
+    int         i_done;
+} median_frame_t;
+
+/* the bands of the frames being filtered go to a pool of threads, the worker
+ * of a frame takes its bands as well so none of them sits waiting */
+typedef struct median_t
+{
+    int         i_width;
+    int         i_threads;
+    pthread_t   threads[MEDIAN_MAX_THREADS];
+    median_frame_t* frames;     // frames with bands not taken yet
+    bool        b_stop;
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;       // a frame came in or the pool stops
+    pthread_cond_t  done;       // a band is done
+} median_t;
+
+void median_init( ia_seq_t*, ia_filter_param_t** );
+void median_exec( ia_seq_t*, ia_filter_param_t*, ia_image_t**, ia_image_t* );
+void median_clos( ia_filter_param_t* );
+
+#endif
@@ -22,12 +22,43 @@
 
 #include "monkey.h"
 
+void monkey_init( ia_seq_t* s, ia_filter_param_t** fp )
+{
+    ia_tstats_require( s, IA_TSTATS_MEAN|IA_TSTATS_RANGE );
+    fp = fp;
+}
+
+/* the value furthest from the mean is the min or the max of the window, on a
+ * tie the newer of the two wins like it does in the full scan */
+static void monkey_exec_tstats( ia_seq_t* s, ia_tstats_window_t* w, ia_image_t* iar )
+{
+    size_t i, n = iar->i_pitch * s->param->i_height;
+
+    for( i = 0; i < n; i++ )
+    {
+        double avg = ia_tstats_mean( w, i );
+        double dmin = ia_abs( avg - w->min[i] );
+        double dmax = ia_abs( avg - w->max[i] );
+
+        if( dmin > dmax || (dmin == dmax && w->argmin[i] > w->argmax[i]) )
+            iar->pix[i] = w->min[i];
+        else
+            iar->pix[i] = w->max[i];
+    }
+}
+
 inline void monkey_exec( ia_seq_t* s, ia_filter_param_t* fp, ia_image_t** iaim, ia_image_t* iar )
 {
-    int i,j;
+    int j;
+    size_t i;
     double dev, avg;
 
-    i = s->param->i_size*3-1;
+    if( iar->tstats && iar->tstats->min ) {
+        monkey_exec_tstats( s, iar->tstats, iar );
+        return;
+    }
+
+    i = iar->i_pitch * s->param->i_height;
     while( i-- )
     {
         avg = 0;
@@ -25,6 +25,7 @@
 
 #include "filters.h"
 
+void monkey_init( ia_seq_t*, ia_filter_param_t** );
 inline void monkey_exec( ia_seq_t*, ia_filter_param_t*, ia_image_t**, ia_image_t* );
 
 #endif
@@ -27,11 +27,11 @@ void normal_exec( ia_seq_t* s, ia_filter_param_t* fp, ia_image_t** iaim, ia_imag
     ia_image_t* iaf = iaim[0];
     int i;
 
-    for( i = s->param->i_height-1; i > 0; i-- )
+    for( i = s->param->i_height-1; i >= 0; i-- )
     {
         int j;
 
-        for( j = s->param->i_width-1; j > 0; j-- )
+        for( j = s->param->i_width-1; j >= 0; j-- )
         {
             double n[3]; // {r, g, b}
             int ci, cj, pix;
@@ -0,0 +1,264 @@
+/******************************************************************************
+ * Copyright (c) 2008 Joey Degges
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *****************************************************************************/
+
+#include "template.h"
+
+void template_init( ia_seq_t* s, ia_filter_param_t** fp )
+{
+    const ia_param_t* p = s->param;
+    ia_image_t* img;
+    ia_cache_entry_t* luma = NULL;
+    template_t* t;
+    float *block = NULL, *tmp = NULL;
+    double mean = 0;
+    int n = TEMPLATE_MIN_FFT;
+    int x, y;
+
+    *fp = NULL;
+    if( (img = iaio_load_image( p->TemplateSettings.File )) == NULL ) {
+        fprintf( stderr, "ERROR: template_init(): couldnt load template %s\n", p->TemplateSettings.File );
+        return;
+    }
+    if( img->i_width > p->i_width || img->i_height > p->i_height ) {
+        fprintf( stderr, "ERROR: template_init(): template %s is bigger than the frames\n",
+                 p->TemplateSettings.File );
+        ia_image_free( img );
+        return;
+    }
+    if( (t = ia_calloc( 1, sizeof(template_t) )) == NULL ) {
+        ia_image_free( img );
+        return;
+    }
+    pthread_mutex_init( &t->mutex, NULL );
+    ia_pthread_cond_init( &t->cond, NULL );
+
+    t->i_width = img->i_width;
+    t->i_height = img->i_height;
+    while( n < 2 * t->i_width || n < 2 * t->i_height )
+        n *= 2;
+
+    t->fft = ia_fft_create( n );
+    t->spec = ia_malloc( n * (n/2+1) * 2 * sizeof(float) );
+    block = ia_calloc( n * n, sizeof(float) );
+    tmp = ia_malloc( 2 * n * sizeof(float) );
+    luma = ia_cache_get( img, IA_CACHE_LUMA );
+    if( t->fft == NULL || t->spec == NULL || block == NULL || tmp == NULL || luma == NULL ) {
+        fprintf( stderr, "ERROR: template_init(): couldnt alloc template spectrum\n" );
+        ia_cache_release( luma );
+        ia_image_free( img );
+        ia_free( block );
+        ia_free( tmp );
+        template_clos( (ia_filter_param_t*) t );
+        return;
+    }
+
+    /* the template less its mean, so the correlation with it doesnt
+     * depend on the brightness of the frame under it */
+    for( y = 0; y < t->i_height; y++ )
+        for( x = 0; x < t->i_width; x++ )
+            mean += ((uint8_t*) luma->data)[y * luma->i_stride + x];
+    mean /= t->i_width * t->i_height;
+    for( y = 0; y < t->i_height; y++ ) {
+        for( x = 0; x < t->i_width; x++ ) {
+            const double v = ((uint8_t*) luma->data)[y * luma->i_stride + x] - mean;
+            block[y * n + x] = v;
+            t->f_energy += v * v;
+        }
+    }
+    ia_fft2d_r2c( t->fft, block, t->spec, tmp );
+
+    ia_cache_release( luma );
+    ia_image_free( img );
+    ia_free( block );
+    ia_free( tmp );
+
+    t->i_turn = p->i_maxrefs - 1;
+    if( p->TemplateSettings.ListFile[0] ) {
+        if( !strcmp(p->TemplateSettings.ListFile, "-") )
+            t->list = stdout;
+        else if( (t->list = fopen( p->TemplateSettings.ListFile, "w" )) == NULL )
+            fprintf( stderr, "ERROR: template_init(): couldnt open match list %s\n",
+                     p->TemplateSettings.ListFile );
+        if( t->list )
+            fprintf( t->list, "# frame left top score, picture pixels from the top left, -1 -1 0 for no match\n" );
+    }
+
+    *fp = (ia_filter_param_t*) t;
+}
+
+/* writes the best match of frame i_frame to the list once every earlier frame has */
+static void template_write( template_t* t, int bx, int by, double score, uint64_t i_frame )
+{
+    int rc;
+
+    if( 0 != (rc = ia_pthread_mutex_lock( &t->mutex )) )
+        ia_pthread_error( rc, "template_write()", "ia_pthread_mutex_lock()" );
+    while( t->i_turn != i_frame ) {
+        if( 0 != (rc = ia_pthread_cond_wait( &t->cond, &t->mutex )) )
+            ia_pthread_error( rc, "template_write()", "ia_pthread_cond_wait()" );
+    }
+
+    fprintf( t->list, "%llu %d %d %.4f\n", (long long unsigned) i_frame, bx, by, score );
+
+    t->i_turn++;
+    if( 0 != (rc = ia_pthread_cond_broadcast( &t->cond )) )
+        ia_pthread_error( rc, "template_write()", "ia_pthread_cond_broadcast()" );
+    if( 0 != (rc = ia_pthread_mutex_unlock( &t->mutex )) )
+        ia_pthread_error( rc, "template_write()", "ia_pthread_mutex_unlock()" );
+}
+
+/* normalised cross correlation of the template with every window of luma it
+ * fits in, the best one boxed in green on the frame. the numerator is the
+ * correlation with the zero mean template, done by fft over overlap-save
+ * blocks: a block of n x n pixels gives the n-w+1 x n-h+1 positions whose
+ * window lies inside it. the window sums for the denominator come from the
+ * cached integral images. */
+void template_exec( ia_seq_t* s, ia_filter_param_t* fp, ia_image_t** iaim, ia_image_t* iar )
+{
+    template_t* t = (template_t*) fp;
+    ia_image_t* iaf = iaim[s->param->i_maxrefs-1];
+    const int w = iaf->i_width;
+    const int h = iaf->i_height;
+    ia_cache_entry_t *luma = NULL, *ii = NULL, *ii2 = NULL;
+    float *block = NULL, *spec = NULL, *tmp = NULL;
+    double best = -2;
+    int bx = -1, by = -1;
+    int n, sw, sh, x0, y0, x, y, i;
+
+    if( t == NULL )
+        return;
+
+    memcpy( iar->pix, iaf->pix, iaf->i_pitch * h );
+
+    n = t->fft->i_size;
+    sw = n - t->i_width + 1;
+    sh = n - t->i_height + 1;
+    luma = ia_cache_get( iaf, IA_CACHE_LUMA );
+    ii = ia_cache_get( iaf, IA_CACHE_INTEGRAL );
+    ii2 = ia_cache_get( iaf, IA_CACHE_INTEGRAL2 );
+    block = ia_malloc( n * n * sizeof(float) );
+    spec = ia_malloc( n * (n/2+1) * 2 * sizeof(float) );
+    tmp = ia_malloc( 2 * n * sizeof(float) );
+    if( luma == NULL || ii == NULL || ii2 == NULL || block == NULL || spec == NULL || tmp == NULL ) {
+        fprintf( stderr, "ERROR: template_exec(): couldnt alloc correlation buffers\n" );
+        goto out;
+    }
+
+    for( y0 = 0; y0 + t->i_height <= h; y0 += sh )
+    {
+        for( x0 = 0; x0 + t->i_width <= w; x0 += sw )
+        {
+            const int area = t->i_width * t->i_height;
+            const float scale = 1.0f / ((float) n * n);
+
+            for( y = 0; y < n; y++ ) {
+                float* b = block + y * n;
+                const uint8_t* l = (uint8_t*) luma->data + (y0+y) * luma->i_stride + x0;
+                const int xn = x0 + n < w ? n : w - x0;
+                if( y0 + y >= h ) {
+                    memset( b, 0, n * sizeof(float) );
+                    continue;
+                }
+                for( x = 0; x < xn; x++ )
+                    b[x] = l[x];
+                for( ; x < n; x++ )
+                    b[x] = 0;
+            }
+
+            /* correlation is the product with the conjugate */
+            ia_fft2d_r2c( t->fft, block, spec, tmp );
+            for( i = 0; i < n * (n/2+1); i++ ) {
+                const float ar = spec[2*i], ai = spec[2*i+1];
+                const float br = t->spec[2*i], bi = t->spec[2*i+1];
+                spec[2*i] = ar*br + ai*bi;
+                spec[2*i+1] = ai*br - ar*bi;
+            }
+            ia_fft2d_c2r( t->fft, spec, block, tmp );
+
+            for( y = 0; y < sh && y0 + y + t->i_height <= h; y++ )
+            {
+                for( x = 0; x < sw && x0 + x + t->i_width <= w; x++ )
+                {
+                    const int u = x0 + x, v = y0 + y;
+                    const double sum = ia_cache_box32( ii, u, v, u + t->i_width, v + t->i_height, 0 );
+                    const double sq = ia_cache_box64( ii2, u, v, u + t->i_width, v + t->i_height );
+                    const double var = sq - sum * sum / area;
+                    double score;
+
+                    /* flat windows match nothing */
+                    if( var < area )
+                        continue;
+                    score = block[y * n + x] * scale / sqrt( var * t->f_energy );
+                    if( score > best ) {
+                        best = score;
+                        bx = u;
+                        by = v;
+                    }
+                }
+            }
+        }
+    }
+
+    if( bx >= 0 ) {
+        for( x = bx; x < bx + t->i_width; x++ ) {
+            ia_pixel_t* a = iar->pix + offset( iar->i_pitch, x, by, 0 );
+            ia_pixel_t* b = iar->pix + offset( iar->i_pitch, x, by + t->i_height-1, 0 );
+            a[0] = b[0] = 0; a[1] = b[1] = 255; a[2] = b[2] = 0;
+        }
+        for( y = by; y < by + t->i_height; y++ ) {
+            ia_pixel_t* a = iar->pix + offset( iar->i_pitch, bx, y, 0 );
+            ia_pixel_t* b = iar->pix + offset( iar->i_pitch, bx + t->i_width-1, y, 0 );
+            a[0] = b[0] = 0; a[1] = b[1] = 255; a[2] = b[2] = 0;
+        }
+    }
+
+out:
+    /* rows of pix go up the picture in bottom up frames */
+    if( t->list )
+        template_write( t, bx, bx < 0 ? -1 : iaf->b_bottom_up ? h - by - t->i_height : by,
+                        bx >= 0 ? best : 0, iar->i_frame );
+
+    ia_cache_release( luma );
+    ia_cache_release( ii );
+    ia_cache_release( ii2 );
+    ia_free( block );
+    ia_free( spec );
+    ia_free( tmp );
+}
+
+void template_clos( ia_filter_param_t* fp )
+{
+    template_t* t = (template_t*) fp;
+
+    if( t == NULL )
+        return;
+
+    if( t->list && t->list != stdout )
+        fclose( t->list );
+    else if( t->list )
+        fflush( t->list );
+    pthread_mutex_destroy( &t->mutex );
+    pthread_cond_destroy( &t->cond );
+    ia_fft_free( t->fft );
+    ia_free( t->spec );
+    ia_free( t );
+}
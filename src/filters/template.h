@@ -0,0 +1,51 @@
+/******************************************************************************
+ * Copyright (c) 2008 Joey Degges
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *****************************************************************************/
+
+#ifndef _H_TEMPLATE
+#define _H_TEMPLATE
+
+#include "filters.h"
+#include "fft.h"
+
+/* fft blocks are at least this big, and at least twice the template */
+#define TEMPLATE_MIN_FFT    32
+
+typedef struct template_t
+{
+    int         i_width;        // of the template
+    int         i_height;
+    ia_fft_t*   fft;            // i_size x i_size blocks
+    float*      spec;           // half spectrum of the zero mean template
+    double      f_energy;       // sum of its squares
+
+    /* the match list, written in frame order */
+    FILE*       list;
+    uint64_t    i_turn;         // next frame allowed to write
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;
+} template_t;
+
+void template_init( ia_seq_t*, ia_filter_param_t** );
+void template_exec( ia_seq_t*, ia_filter_param_t*, ia_image_t**, ia_image_t* );
+void template_clos( ia_filter_param_t* );
+
+#endif
@@ -0,0 +1,66 @@
+/******************************************************************************
+ * Copyright (c) 2008 Joey Degges
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *****************************************************************************/
+
+#include "tmedian.h"
+
+/* median of every byte over the ref window, a background estimate for
+ * --refs 25 and up. the running histograms of ia_tstats make the cost per
+ * byte the same whatever the window length. */
+void tmedian_init( ia_seq_t* s, ia_filter_param_t** fp )
+{
+    ia_tstats_require( s, IA_TSTATS_MEDIAN );
+    fp = fp;
+}
+
+/* windows too long for the histograms: insertion sort per byte */
+static void tmedian_exec_sort( ia_seq_t* s, ia_image_t** iaim, ia_image_t* iar )
+{
+    const int n = s->param->i_maxrefs;
+    size_t i, size = iar->i_pitch * s->param->i_height;
+    uint8_t* v = ia_malloc( n );
+    int j, k;
+
+    if( v == NULL )
+        return;
+
+    for( i = 0; i < size; i++ )
+    {
+        for( j = 0; j < n; j++ )
+        {
+            uint8_t x = iaim[j]->pix[i];
+            for( k = j; k > 0 && v[k-1] > x; k-- )
+                v[k] = v[k-1];
+            v[k] = x;
+        }
+        iar->pix[i] = v[(n-1) / 2];
+    }
+    ia_free( v );
+}
+
+inline void tmedian_exec( ia_seq_t* s, ia_filter_param_t* fp, ia_image_t** iaim, ia_image_t* iar )
+{
+    if( iar->tstats && iar->tstats->median )
+        memcpy( iar->pix, iar->tstats->median, iar->i_pitch * s->param->i_height );
+    else
+        tmedian_exec_sort( s, iaim, iar );
+    fp = fp;
+}
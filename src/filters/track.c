@@ -0,0 +1,374 @@
+/******************************************************************************
+ * Copyright (c) 2008 Joey Degges
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *****************************************************************************/
+
+#include "track.h"
+
+#include <math.h>
+
+/* a possible match of a track and a blob */
+typedef struct track_pair_t
+{
+    double      f_score;
+    int         i_track;
+    int         i_blob;
+} track_pair_t;
+
+void track_init( ia_seq_t* s, ia_filter_param_t** fp )
+{
+    const ia_param_t* p = s->param;
+    track_t* t;
+
+    *fp = NULL;
+    if( (t = ia_calloc( 1, sizeof(track_t) )) == NULL )
+        return;
+
+    t->i_threshold = p->BlobsSettings.Threshold;
+    t->i_min_area = p->BlobsSettings.MinArea;
+    t->f_min_iou = p->TrackSettings.MinIou;
+    t->f_gate = p->TrackSettings.Gate;
+    t->i_max_misses = p->TrackSettings.MaxMisses;
+    t->i_turn = p->i_maxrefs - 1;
+
+    if( p->TrackSettings.ListFile[0] ) {
+        if( !strcmp(p->TrackSettings.ListFile, "-") )
+            t->list = stdout;
+        else if( (t->list = fopen( p->TrackSettings.ListFile, "w" )) == NULL )
+            fprintf( stderr, "ERROR: track_init(): couldnt open track list %s\n",
+                     p->TrackSettings.ListFile );
+        if( t->list ) {
+            fprintf( t->list, "# p frame track cx cy left top right bottom, picture pixels from the top left\n" );
+            fprintf( t->list, "# t track first last hits length\n" );
+        }
+    }
+
+    pthread_mutex_init( &t->mutex, NULL );
+    ia_pthread_cond_init( &t->cond, NULL );
+    *fp = (ia_filter_param_t*) t;
+}
+
+static double track_iou( const ia_blob_t* a, const ia_blob_t* b, int dx, int dy )
+{
+    const int l = a->i_left + dx > b->i_left ? a->i_left + dx : b->i_left;
+    const int r = a->i_right + dx < b->i_right ? a->i_right + dx : b->i_right;
+    const int t = a->i_top + dy > b->i_top ? a->i_top + dy : b->i_top;
+    const int bt = a->i_bottom + dy < b->i_bottom ? a->i_bottom + dy : b->i_bottom;
+    double in, area_a, area_b;
+
+    if( l > r || t > bt )
+        return 0;
+    in = (double)(r - l + 1) * (bt - t + 1);
+    area_a = (double)(a->i_right - a->i_left + 1) * (a->i_bottom - a->i_top + 1);
+    area_b = (double)(b->i_right - b->i_left + 1) * (b->i_bottom - b->i_top + 1);
+    return in / (area_a + area_b - in);
+}
+
+/* best first, ties broken by position so the result doesnt depend on qsort */
+static int track_pair_cmp( const void* a, const void* b )
+{
+    const track_pair_t* pa = a;
+    const track_pair_t* pb = b;
+
+    if( pa->f_score != pb->f_score )
+        return pa->f_score < pb->f_score ? 1 : -1;
+    if( pa->i_track != pb->i_track )
+        return pa->i_track - pb->i_track;
+    return pa->i_blob - pb->i_blob;
+}
+
+static void track_end( track_t* t, track_obj_t* o )
+{
+    if( t->list )
+        fprintf( t->list, "t %d %llu %llu %u %.1f\n", o->i_id, (long long unsigned) o->i_first,
+                 (long long unsigned) o->i_last, o->i_hits, o->f_length );
+}
+
+/* rows of a bottom up frame are flipped to picture rows */
+static void track_seen( track_t* t, track_obj_t* o, uint64_t i_frame )
+{
+    const ia_blob_t* b = &o->blob;
+    const int last = t->i_last_row;
+
+    if( t->list )
+        fprintf( t->list, "p %llu %d %.2f %.2f %d %d %d %d\n", (long long unsigned) i_frame,
+                 o->i_id, b->f_cx, last < 0 ? b->f_cy : last - b->f_cy, b->i_left,
+                 last < 0 ? b->i_top : last - b->i_bottom, b->i_right,
+                 last < 0 ? b->i_bottom : last - b->i_top );
+}
+
+/* matches the blobs of frame i_frame to the tracks, greedily from the best
+ * pair down. a track is predicted to have kept moving as it did, it pairs
+ * with blobs whose box overlaps the predicted one by f_min_iou, scored by
+ * the overlap, or whose centroid is within f_gate of the predicted one,
+ * scored lower and by the distance. ids gets the track of every blob.
+ * retval: 0 ok, 1 couldnt allocate */
+static int track_update( track_t* t, ia_ccl_t* l, uint64_t i_frame, int32_t* ids )
+{
+    track_pair_t* pairs = NULL;
+    int* taken = NULL;
+    int i, j, n = 0;
+
+    if( t->i_tracks && l->i_blobs ) {
+        pairs = ia_malloc( (size_t)t->i_tracks * l->i_blobs * sizeof(track_pair_t) );
+        taken = ia_calloc( t->i_tracks, sizeof(int) );
+        if( pairs == NULL || taken == NULL ) {
+            ia_free( pairs );
+            ia_free( taken );
+            return 1;
+        }
+    }
+
+    for( i = 0; pairs && i < t->i_tracks; i++ )
+    {
+        const track_obj_t* o = &t->tracks[i];
+        const double gap = i_frame - o->i_last;
+        const double cx = o->blob.f_cx + o->f_vx * gap;
+        const double cy = o->blob.f_cy + o->f_vy * gap;
+        const int dx = lrint( o->f_vx * gap );
+        const int dy = lrint( o->f_vy * gap );
+
+        for( j = 0; j < l->i_blobs; j++ )
+        {
+            const ia_blob_t* b = &l->blobs[j];
+            const double iou = track_iou( &o->blob, b, dx, dy );
+            const double dist = hypot( b->f_cx - cx, b->f_cy - cy );
+
+            if( iou > 0 && iou >= t->f_min_iou )
+                pairs[n].f_score = 1 + iou;
+            else if( dist <= t->f_gate )
+                pairs[n].f_score = 1 - dist / (t->f_gate + 1);
+            else
+                continue;
+            pairs[n].i_track = i;
+            pairs[n].i_blob = j;
+            n++;
+        }
+    }
+    qsort( pairs, n, sizeof(track_pair_t), track_pair_cmp );
+
+    for( j = 0; j < l->i_blobs; j++ )
+        ids[j] = -1;
+    for( i = 0; i < n; i++ )
+    {
+        track_obj_t* o = &t->tracks[pairs[i].i_track];
+        const ia_blob_t* b = &l->blobs[pairs[i].i_blob];
+        const double gap = i_frame - o->i_last;
+        double mx, my;
+
+        if( taken[pairs[i].i_track] || ids[pairs[i].i_blob] >= 0 )
+            continue;
+        taken[pairs[i].i_track] = 1;
+        ids[pairs[i].i_blob] = o->i_id;
+
+        mx = (b->f_cx - o->blob.f_cx) / gap;
+        my = (b->f_cy - o->blob.f_cy) / gap;
+        o->f_vx = o->i_hits > 1 ? (o->f_vx + mx) / 2 : mx;
+        o->f_vy = o->i_hits > 1 ? (o->f_vy + my) / 2 : my;
+        o->f_length += hypot( b->f_cx - o->blob.f_cx, b->f_cy - o->blob.f_cy );
+        o->blob = *b;
+        o->i_last = i_frame;
+        o->i_hits++;
+        track_seen( t, o, i_frame );
+    }
+
+    /* tracks unseen for too long end, keeping the rest in order */
+    for( i = j = 0; i < t->i_tracks; i++ ) {
+        if( i_frame - t->tracks[i].i_last > (uint64_t) t->i_max_misses )
+            track_end( t, &t->tracks[i] );
+        else
+            t->tracks[j++] = t->tracks[i];
+    }
+    t->i_tracks = j;
+
+    /* blobs nothing matched start tracks of their own */
+    for( j = 0; j < l->i_blobs; j++ )
+    {
+        track_obj_t* o;
+
+        if( ids[j] >= 0 )
+            continue;
+        if( t->i_tracks == t->i_size ) {
+            int size = t->i_size ? 2 * t->i_size : 64;
+            track_obj_t* tracks = realloc( t->tracks, size * sizeof(track_obj_t) );
+            if( tracks == NULL )
+                break;
+            t->tracks = tracks;
+            t->i_size = size;
+        }
+        o = &t->tracks[t->i_tracks++];
+        memset( o, 0, sizeof(track_obj_t) );
+        o->i_id = ids[j] = t->i_next_id++;
+        o->i_first = o->i_last = i_frame;
+        o->i_hits = 1;
+        o->blob = l->blobs[j];
+        track_seen( t, o, i_frame );
+    }
+
+    ia_free( pairs );
+    ia_free( taken );
+    return 0;
+}
+
+static void track_draw_box( ia_image_t* iar, const ia_blob_t* b, int32_t id )
+{
+    const uint8_t c[3] = { 64 + (id * 37) % 192, 64 + (id * 101) % 192, 64 + (id * 173) % 192 };
+    int x, y, k;
+
+    for( x = b->i_left; x <= b->i_right; x++ ) {
+        for( k = 0; k < 3; k++ ) {
+            iar->pix[offset(iar->i_pitch,x,b->i_top,k)] = c[k];
+            iar->pix[offset(iar->i_pitch,x,b->i_bottom,k)] = c[k];
+        }
+    }
+    for( y = b->i_top; y <= b->i_bottom; y++ ) {
+        for( k = 0; k < 3; k++ ) {
+            iar->pix[offset(iar->i_pitch,b->i_left,y,k)] = c[k];
+            iar->pix[offset(iar->i_pitch,b->i_right,y,k)] = c[k];
+        }
+    }
+}
+
+/* t->mutex must be held */
+static track_ccl_t* track_ccl_get( track_t* t )
+{
+    track_ccl_t* c = t->ccl;
+
+    if( c != NULL ) {
+        t->ccl = c->next;
+        return c;
+    }
+    return ia_calloc( 1, sizeof(track_ccl_t) );
+}
+
+/* labels the blobs of luma into c and makes room for their ids
+ * retval: 0 ok, 1 couldnt allocate */
+static int track_label( track_t* t, track_ccl_t* c, ia_cache_entry_t* luma )
+{
+    if( ia_ccl_label( &c->l, luma, t->i_threshold, t->i_min_area ) )
+        return 1;
+    if( c->i_ids_size < c->l.i_blobs || c->ids == NULL ) {
+        const int n = c->l.i_blobs ? c->l.i_blobs : 1;
+        ia_free( c->ids );
+        if( (c->ids = ia_malloc( n * sizeof(int32_t) )) == NULL ) {
+            c->i_ids_size = 0;
+            return 1;
+        }
+        c->i_ids_size = n;
+    }
+    return 0;
+}
+
+/* detects blobs in the current frame like blobs does (so the output of diff,
+ * say, can be fed in) and follows them from frame to frame. what is meant to
+ * be kept is the track list: a p line per track and frame it was seen in and
+ * a t line when it ends. the image only shows the box of every track. */
+void track_exec( ia_seq_t* s, ia_filter_param_t* fp, ia_image_t** iaim, ia_image_t* iar )
+{
+    track_t* t = (track_t*) fp;
+    ia_cache_entry_t* luma;
+    track_ccl_t* c;
+    ia_ccl_t none;
+    ia_ccl_t* l;
+    bool b_fail;
+    int i, rc;
+
+    if( t == NULL )
+        return;
+
+    memset( iar->pix, 0, iar->i_pitch * s->param->i_height );
+    memset( &none, 0, sizeof(ia_ccl_t) );
+
+    if( 0 != (rc = ia_pthread_mutex_lock( &t->mutex )) )
+        ia_pthread_error( rc, "track_exec()", "ia_pthread_mutex_lock()" );
+    c = track_ccl_get( t );
+    if( 0 != (rc = ia_pthread_mutex_unlock( &t->mutex )) )
+        ia_pthread_error( rc, "track_exec()", "ia_pthread_mutex_unlock()" );
+    l = c != NULL ? &c->l : &none;
+
+    /* labelling runs in parallel, only the matching is in frame order */
+    luma = ia_cache_get( iaim[s->param->i_maxrefs-1], IA_CACHE_LUMA );
+    b_fail = c == NULL || luma == NULL || track_label( t, c, luma );
+
+    if( 0 != (rc = ia_pthread_mutex_lock( &t->mutex )) )
+        ia_pthread_error( rc, "track_exec()", "ia_pthread_mutex_lock()" );
+    while( t->i_turn != iar->i_frame ) {
+        if( 0 != (rc = ia_pthread_cond_wait( &t->cond, &t->mutex )) )
+            ia_pthread_error( rc, "track_exec()", "ia_pthread_cond_wait()" );
+    }
+
+    /* a frame that failed counts as one with nothing in it */
+    if( b_fail ) {
+        l->i_blobs = 0;
+        fprintf( stderr, "ERROR: track_exec(): couldnt alloc blob labels\n" );
+    }
+    t->i_last_row = iaim[s->param->i_maxrefs-1]->b_bottom_up ? s->param->i_height - 1 : -1;
+    if( track_update( t, l, iar->i_frame, c != NULL ? c->ids : NULL ) ) {
+        l->i_blobs = 0;
+        fprintf( stderr, "ERROR: track_exec(): couldnt alloc track pairs\n" );
+    }
+
+    t->i_turn++;
+    if( 0 != (rc = ia_pthread_cond_broadcast( &t->cond )) )
+        ia_pthread_error( rc, "track_exec()", "ia_pthread_cond_broadcast()" );
+    if( 0 != (rc = ia_pthread_mutex_unlock( &t->mutex )) )
+        ia_pthread_error( rc, "track_exec()", "ia_pthread_mutex_unlock()" );
+
+    for( i = 0; i < l->i_blobs; i++ )
+        if( c->ids[i] >= 0 )
+            track_draw_box( iar, &l->blobs[i], c->ids[i] );
+
+    ia_cache_release( luma );
+    if( c != NULL ) {
+        if( 0 != (rc = ia_pthread_mutex_lock( &t->mutex )) )
+            ia_pthread_error( rc, "track_exec()", "ia_pthread_mutex_lock()" );
+        c->next = t->ccl;
+        t->ccl = c;
+        if( 0 != (rc = ia_pthread_mutex_unlock( &t->mutex )) )
+            ia_pthread_error( rc, "track_exec()", "ia_pthread_mutex_unlock()" );
+    }
+}
+
+void track_clos( ia_filter_param_t* fp )
+{
+    track_t* t = (track_t*) fp;
+    int i;
+
+    if( t == NULL )
+        return;
+
+    for( i = 0; i < t->i_tracks; i++ )
+        track_end( t, &t->tracks[i] );
+    while( t->ccl != NULL ) {
+        track_ccl_t* next = t->ccl->next;
+        ia_ccl_free( &t->ccl->l );
+        ia_free( t->ccl->ids );
+        ia_free( t->ccl );
+        t->ccl = next;
+    }
+    if( t->list && t->list != stdout )
+        fclose( t->list );
+    else if( t->list )
+        fflush( t->list );
+    pthread_mutex_destroy( &t->mutex );
+    pthread_cond_destroy( &t->cond );
+    ia_free( t->tracks );
+    ia_free( t );
+}
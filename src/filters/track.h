@@ -0,0 +1,77 @@
+/******************************************************************************
+ * Copyright (c) 2008 Joey Degges
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *****************************************************************************/
+
+#ifndef _H_TRACK
+#define _H_TRACK
+
+#include "filters.h"
+#include "ccl.h"
+
+/* an object followed from frame to frame */
+typedef struct track_obj_t
+{
+    int32_t     i_id;
+    uint64_t    i_first;        // frames it was first and last seen in
+    uint64_t    i_last;
+    uint32_t    i_hits;         // frames it was seen in
+    ia_blob_t   blob;           // where it was last seen
+    double      f_vx;           // centroid motion per frame
+    double      f_vy;
+    double      f_length;       // distance its centroid travelled
+} track_obj_t;
+
+/* per worker labels and track ids of their blobs, kept on a free list
+ * between frames */
+typedef struct track_ccl_t
+{
+    struct track_ccl_t* next;
+    ia_ccl_t    l;
+    int32_t*    ids;
+    int         i_ids_size;
+} track_ccl_t;
+
+typedef struct track_t
+{
+    int         i_threshold;    // detection, as for blobs
+    int         i_min_area;
+    double      f_min_iou;      // boxes overlapping this much match
+    double      f_gate;         // and so do centroids this close, in pixels
+    int         i_max_misses;   // frames a track survives unseen
+
+    /* the tracks are only touched by one frame at a time, in frame order */
+    track_obj_t* tracks;
+    int         i_tracks;
+    int         i_size;
+    int32_t     i_next_id;
+    uint64_t    i_turn;         // next frame allowed to update them
+    FILE*       list;
+    int         i_last_row;     // of a bottom up frame being listed, else -1
+    track_ccl_t* ccl;
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;
+} track_t;
+
+void track_init( ia_seq_t*, ia_filter_param_t** );
+void track_exec( ia_seq_t*, ia_filter_param_t*, ia_image_t**, ia_image_t* );
+void track_clos( ia_filter_param_t* );
+
+#endif
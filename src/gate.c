@@ -0,0 +1,94 @@
+#include "gate.h"
+
+ia_gate_t* ia_gate_open( const ia_param_t* p )
+{
+    ia_gate_t* g = ia_calloc( 1, sizeof(ia_gate_t) );
+
+    if( g == NULL )
+        return NULL;
+    g->f_threshold = p->GateSettings.Threshold;
+    g->b_drop = p->GateSettings.Drop;
+    g->i_first = p->i_maxrefs - 1;
+    pthread_mutex_init( &g->mutex, NULL );
+    ia_pthread_cond_init( &g->cond, NULL );
+    return g;
+}
+
+/* sum of absolute differences, written so it vectorizes to psadbw */
+static uint64_t ia_gate_sad( const ia_cache_entry_t* a, const ia_cache_entry_t* b )
+{
+    uint64_t sad = 0;
+    int x, y;
+
+    for( y = 0; y < a->i_height; y++ )
+    {
+        const uint8_t* pa = (uint8_t*) a->data + y * a->i_stride;
+        const uint8_t* pb = (uint8_t*) b->data + y * b->i_stride;
+        uint32_t row = 0;
+
+        for( x = 0; x < a->i_width; x++ )
+            row += abs( pa[x] - pb[x] );
+        sad += row;
+    }
+    return sad;
+}
+
+bool ia_gate_frame( ia_gate_t* g, ia_image_t* iaf )
+{
+    ia_cache_entry_t* thumb = ia_cache_get( iaf, IA_CACHE_PYR8 );
+    bool b_gated = false;
+    int rc;
+
+    if( 0 != (rc = ia_pthread_mutex_lock( &g->mutex )) )
+        ia_pthread_error( rc, "ia_gate_frame()", "ia_pthread_mutex_lock()" );
+    while( g->i_turn != iaf->i_frame ) {
+        if( 0 != (rc = ia_pthread_cond_wait( &g->cond, &g->mutex )) )
+            ia_pthread_error( rc, "ia_gate_frame()", "ia_pthread_cond_wait()" );
+    }
+
+    /* frames too small for the pyramid, or without it, are always filtered */
+    if( iaf->i_frame > g->i_first && thumb != NULL && g->ref != NULL &&
+        thumb->i_width > 0 && thumb->i_height > 0 ) {
+        const double n = (double) thumb->i_width * thumb->i_height;
+        b_gated = ia_gate_sad( thumb, g->ref ) <= g->f_threshold * n;
+    }
+    if( iaf->i_frame >= g->i_first ) {
+        g->i_frames++;
+        g->i_gated += b_gated;
+    }
+
+    if( b_gated )
+        ia_cache_release( thumb );
+    else {
+        ia_cache_release( g->ref );
+        g->ref = thumb;
+    }
+
+    g->i_turn++;
+    if( 0 != (rc = ia_pthread_cond_broadcast( &g->cond )) )
+        ia_pthread_error( rc, "ia_gate_frame()", "ia_pthread_cond_broadcast()" );
+    if( 0 != (rc = ia_pthread_mutex_unlock( &g->mutex )) )
+        ia_pthread_error( rc, "ia_gate_frame()", "ia_pthread_mutex_unlock()" );
+
+    return b_gated;
+}
+
+void ia_gate_report( ia_gate_t* g, FILE* fp )
+{
+    if( g == NULL )
+        return;
+    fprintf( fp, "motion gate: %llu of %llu frames gated (%.1f%%), %s\n",
+             (long long unsigned) g->i_gated, (long long unsigned) g->i_frames,
+             g->i_frames ? 100.0 * g->i_gated / g->i_frames : 0.0,
+             g->b_drop ? "dropped" : "repeated" );
+}
+
+void ia_gate_close( ia_gate_t* g )
+{
+    if( g == NULL )
+        return;
+    ia_cache_release( g->ref );
+    pthread_mutex_destroy( &g->mutex );
+    pthread_cond_destroy( &g->cond );
+    ia_free( g );
+}
@@ -0,0 +1,41 @@
+#ifndef _H_GATE
+#define _H_GATE
+
+#include "common.h"
+#include "cache.h"
+#include "image_analyzer.h"
+
+/* motion gating of the filters. every frame is compared with the last one
+ * that went through them, on the 8x pyramid, and if the mean absolute
+ * difference of the two is at or below the threshold nothing moved enough
+ * to be worth filtering it again: the frame is gated. decisions are taken
+ * in frame order, the frames before the first output and the first output
+ * are never gated. */
+typedef struct ia_gate_t
+{
+    double      f_threshold;    // mean absolute luma difference per 8x8 block
+    bool        b_drop;         // gated frames arent output instead of repeating
+    uint64_t    i_first;        // first frame that has an output
+    uint64_t    i_turn;         // next frame allowed to decide
+    ia_cache_entry_t* ref;      // 8x pyramid of the last frame that wasnt gated
+    uint64_t    i_frames;       // output frames looked at
+    uint64_t    i_gated;        // and gated
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;
+} ia_gate_t;
+
+/* retval: the gate set up from p->GateSettings, NULL if it couldnt be
+ * allocated */
+ia_gate_t* ia_gate_open( const ia_param_t* p );
+
+/* frames have to come in consecutively from 0, a call waits until the
+ * previous frame has been decided on.
+ * retval: true if iaf is gated */
+bool ia_gate_frame( ia_gate_t* g, ia_image_t* iaf );
+
+/* writes the counters */
+void ia_gate_report( ia_gate_t* g, FILE* fp );
+
+void ia_gate_close( ia_gate_t* g );
+
+#endif
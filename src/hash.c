@@ -0,0 +1,103 @@
+#include "hash.h"
+
+#define IA_HASH_P1 11400714785074694791ULL
+#define IA_HASH_P2 14029467366897019727ULL
+#define IA_HASH_P3 1609587929392839161ULL
+#define IA_HASH_P4 9650029242287828579ULL
+#define IA_HASH_P5 2870177450012600261ULL
+
+static inline uint64_t ia_hash_rotl( uint64_t x, int r )
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t ia_hash_read64( const uint8_t* p )
+{
+    uint64_t v;
+    memcpy( &v, p, sizeof(v) );
+    return v;
+}
+
+static inline uint32_t ia_hash_read32( const uint8_t* p )
+{
+    uint32_t v;
+    memcpy( &v, p, sizeof(v) );
+    return v;
+}
+
+static inline uint64_t ia_hash_round( uint64_t acc, uint64_t v )
+{
+    acc += v * IA_HASH_P2;
+    return ia_hash_rotl( acc, 31 ) * IA_HASH_P1;
+}
+
+static inline uint64_t ia_hash_merge( uint64_t h, uint64_t v )
+{
+    h ^= ia_hash_round( 0, v );
+    return h * IA_HASH_P1 + IA_HASH_P4;
+}
+
+uint64_t ia_hash64( const void* data, size_t len, uint64_t seed )
+{
+    const uint8_t* p = data;
+    const uint8_t* end = p + len;
+    uint64_t h;
+
+    if( len >= 32 ) {
+        uint64_t v1 = seed + IA_HASH_P1 + IA_HASH_P2;
+        uint64_t v2 = seed + IA_HASH_P2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - IA_HASH_P1;
+
+        for( ; p + 32 <= end; p += 32 ) {
+            v1 = ia_hash_round( v1, ia_hash_read64(p) );
+            v2 = ia_hash_round( v2, ia_hash_read64(p+8) );
+            v3 = ia_hash_round( v3, ia_hash_read64(p+16) );
+            v4 = ia_hash_round( v4, ia_hash_read64(p+24) );
+        }
+        h = ia_hash_rotl( v1, 1 ) + ia_hash_rotl( v2, 7 ) +
+            ia_hash_rotl( v3, 12 ) + ia_hash_rotl( v4, 18 );
+        h = ia_hash_merge( h, v1 );
+        h = ia_hash_merge( h, v2 );
+        h = ia_hash_merge( h, v3 );
+        h = ia_hash_merge( h, v4 );
+    } else
+        h = seed + IA_HASH_P5;
+
+    h += len;
+    for( ; p + 8 <= end; p += 8 ) {
+        h ^= ia_hash_round( 0, ia_hash_read64(p) );
+        h = ia_hash_rotl( h, 27 ) * IA_HASH_P1 + IA_HASH_P4;
+    }
+    if( p + 4 <= end ) {
+        h ^= ia_hash_read32( p ) * IA_HASH_P1;
+        h = ia_hash_rotl( h, 23 ) * IA_HASH_P2 + IA_HASH_P3;
+        p += 4;
+    }
+    for( ; p < end; p++ ) {
+        h ^= *p * IA_HASH_P5;
+        h = ia_hash_rotl( h, 11 ) * IA_HASH_P1;
+    }
+
+    h ^= h >> 33;
+    h *= IA_HASH_P2;
+    h ^= h >> 29;
+    h *= IA_HASH_P3;
+    h ^= h >> 32;
+    return h;
+}
+
+uint64_t ia_hash_image( const ia_image_t* iaf )
+{
+    const size_t row = (size_t) iaf->i_width * 3;
+    uint64_t h = 0;
+    int y;
+
+    if( iaf->encoded )
+        return ia_hash64( iaf->encoded, iaf->i_encoded, 0 );
+    if( iaf->i_pitch == row )
+        return ia_hash64( iaf->pix, row * iaf->i_height, 0 );
+    for( y = 0; y < iaf->i_height; y++ )
+        h = ia_hash64( iaf->pix + y * iaf->i_pitch, row, h );
+    return h;
+}
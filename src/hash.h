@@ -0,0 +1,15 @@
+#ifndef _H_HASH
+#define _H_HASH
+
+#include "common.h"
+
+/* xxh64: four independent 64 bit lanes over 32 byte stripes, so the
+ * multiplies of one stripe run in parallel, then a final avalanche.
+ * chaining calls through seed hashes data that isnt contiguous. */
+uint64_t ia_hash64( const void* data, size_t len, uint64_t seed );
+
+/* the pixels of iaf, without the padding at the end of rows, or its file
+ * when it hasnt been decoded yet */
+uint64_t ia_hash_image( const ia_image_t* iaf );
+
+#endif
@@ -34,6 +34,12 @@
 #include "ia_sequence.h"
 #include "analyze.h"
 #include "queue.h"
+#include "numa.h"
+#include "tstats.h"
+#include "stabilize.h"
+#include "scene.h"
+#include "gate.h"
+#include "hash.h"
 
 /*
  * ia_seq_manage_input:
@@ -49,7 +55,10 @@ void* ia_seq_manage_input( void* vptr )
     struct timeval oa_start_time, oa_current_time;
     struct timeval frame_start_time, frame_end_time;
     int32_t frame_remaining_time, spf;
+    uint64_t hash, prev_hash = 0;
+    int run = 0;    // frames in a row the same as the one before them
 
+    ia_numa_pin( ias->param->input_cpus, -1 );
     gettimeofday( &oa_start_time, NULL );
 
     /* while there is more input */
@@ -57,7 +66,10 @@ void* ia_seq_manage_input( void* vptr )
     {
         gettimeofday( &frame_start_time, NULL );
 
-        iaf = ia_image_create( ias->param->i_width, ias->param->i_height );
+        /* on the node of the worker that takes it when the workers go round
+         * in turn, not on the node of this thread which fills it */
+        iaf = ia_image_create_node( ias->param->i_width, ias->param->i_height,
+                                    ia_numa_list_node( ias->param->worker_cpus, i_frame % i_threads ) );
         iaf->i_frame = i_frame;
 
         gettimeofday( &oa_current_time, NULL );
@@ -84,6 +96,22 @@ void* ia_seq_manage_input( void* vptr )
         snprintf( iaf->name, 1031, "%s/image-%010lld.%s", ias->param->output_directory, (long long int)i_frame, ias->param->ext );
         iaf->i_frame = ias->i_frame = i_frame++;
 
+        /* the output of a frame only depends on its ref window, when the
+         * last i_maxrefs frames all repeat the one before them it is the
+         * previous output */
+        if( ias->param->DedupSettings.Enable ) {
+            hash = ia_hash_image( iaf );
+            if( iaf->i_frame > 0 && hash == prev_hash )
+                run = run < ias->param->i_maxrefs ? run+1 : run;
+            else
+                run = 0;
+            prev_hash = hash;
+            if( run >= ias->param->i_maxrefs ) {
+                iaf->b_dup = true;
+                ias->i_dups++;
+            }
+        }
+
         ia_queue_push( ias->input_queue, iaf, iaf->i_frame );
 
         gettimeofday( &frame_end_time, NULL );
@@ -103,10 +131,13 @@ void* ia_seq_manage_output( void* vptr )
 {
     ia_seq_t* ias = (ia_seq_t*) vptr;
     ia_image_t* iar;
+    ia_image_t* last = NULL;    // previous output, kept for gated frames to repeat
     uint64_t i_threads = ias->param->i_threads;
     uint64_t i_frame = (uint32_t) ias->param->i_maxrefs - 1;
     int end = i_threads;
 
+    ia_numa_pin( ias->param->output_cpus, -1 );
+
     /* while there is more output */
     for( ;; )
     {
@@ -121,24 +152,44 @@ void* ia_seq_manage_output( void* vptr )
         {
             end--;
             ia_image_free( iar );
-            if( end == 0 )
+            if( end == 0 ) {
+                if( last )
+                    ia_image_free( last );
                 ia_pthread_exit( NULL );
+            }
             i_frame++;
             continue;
         }
 
-        snprintf( iar->name, 1031, "%s/image-%010lld.%s",
-                  ias->param->output_directory, (long long int)i_frame, ias->param->ext );
-        snprintf( iar->thumbname, 1031, "%s/_thumb.image-%010lld.%s",
-                  ias->param->output_directory, (long long int)i_frame, ias->param->ext );
-        if( iaio_outputimage(ias->iaio, iar) )
+        if( iar->b_repeat && last != NULL ) {
+            memcpy( iar->pix, last->pix, iar->i_pitch * iar->i_height );
+            /* last is done with once iar replaces it */
+            ia_free( iar->planes );
+            iar->planes = last->planes;
+            last->planes = NULL;
+        }
+
+        if( !iar->b_drop )
         {
-            fprintf( stderr, "ERROR: Unable to save image to %s\n", iar->name );
-            ia_pthread_exit( NULL );
+            snprintf( iar->name, 1031, "%s/image-%010lld.%s",
+                      ias->param->output_directory, (long long int)i_frame, ias->param->ext );
+            snprintf( iar->thumbname, 1031, "%s/_thumb.image-%010lld.%s",
+                      ias->param->output_directory, (long long int)i_frame, ias->param->ext );
+            if( iar->b_repeat && last != NULL ? iaio_repeatimage(ias->iaio, iar, last)
+                                              : iaio_outputimage(ias->iaio, iar) )
+            {
+                fprintf( stderr, "ERROR: Unable to save image to %s\n", iar->name );
+                ia_pthread_exit( NULL );
+            }
         }
         i_frame++;
 
-        ia_image_free( iar );
+        if( (ias->gate && !ias->gate->b_drop) || ias->param->DedupSettings.Enable ) {
+            if( last )
+                ia_image_free( last );
+            last = iar;
+        } else
+            ia_image_free( iar );
     }
     return NULL;
 }
@@ -256,6 +307,10 @@ inline void ia_seq_close( ia_seq_t* s )
     ia_free( s->refs_cond_nonempty );
 
     iaio_close( s->iaio );
+    ia_tstats_close( s->tstats );
+    ia_stab_close( s->stab );
+    ia_scene_close( s->scene );
+    ia_gate_close( s->gate );
 
     ia_queue_close( s->output_queue );
     ia_queue_close( s->input_queue );
@@ -50,19 +50,21 @@ typedef struct ia_seq_t
 
     uint64_t            i_frame;        // position of iaf in sequence
     ia_param_t*         param;          // contains all sequence parameters
-    ia_filter_param_t   fparam[20];     // contains filter parameters
+    ia_filter_param_t   fparam[IA_MAX_FILTERS];     // contains filter parameters
 
     pthread_t           tio[2];         // 0 - id of read thread
                                         // 1 - id of write thread
     pthread_attr_t      attr;
 
     struct iaio_t*      iaio;           // used to hold specifics of io
+    struct ia_tstats_t* tstats;         // running ref window statistics, NULL
+                                        // unless a filter asked for them
+    struct ia_stab_t*   stab;           // input stabiliser, NULL unless --stabilize
+    struct ia_scene_t*  scene;          // scene cut detector, NULL unless --keyframes
+                                        // or --scene-list
+    struct ia_gate_t*   gate;           // motion gate, NULL unless --gate
+    uint64_t            i_dups;         // frames marked b_dup
     pthread_mutex_t     eoi_mutex;
-
-    /* FIXME these should be moved to analyze.c. returned by init() as void*
-     * and passed to bhatta() .. or just created in bhatta() each time */
-    uint8_t*            mask;           // used in bhatta
-    uint8_t*            diffImage;      // bhatta
 } ia_seq_t;
 
 
@@ -23,10 +23,12 @@
 #include <sys/time.h>
 #include <time.h>
 #include <assert.h>
+#include <errno.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <regex.h>
+#include <strings.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -46,8 +48,8 @@ static inline int iaio_displayimage( iaio_t* iaio, ia_image_t* iar )
     }
 
     for( i = 0; i < iaio->i_height; i++ )
-        ia_memcpy_pixel_to_uint8( (uint8_t*)iaio->screen->pixels + iar->i_pitch * i,
-                                  iar->pix + iar->i_pitch * (iaio->i_height-i-1),
+        ia_memcpy_pixel_to_uint8( (uint8_t*)iaio->screen->pixels + iaio->screen->pitch * i,
+                                  ia_image_row( iar, i ),
                                   iaio->i_width*3 );
 
     if( SDL_MUSTLOCK(iaio->screen) ) {
@@ -59,51 +61,124 @@ static inline int iaio_displayimage( iaio_t* iaio, ia_image_t* iar )
     return 0;
 }
 
+/* wraps a copy of the pixels of iar in a FIBITMAP for FreeImage to save */
+static FIBITMAP* iaio_image_to_dib( ia_image_t* iar )
+{
+    FIBITMAP* dib = FreeImage_ConvertFromRawBits( iar->pix, iar->i_width, iar->i_height,
+                                                  iar->i_pitch, 24,
+                                                  FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK,
+                                                  FI_RGBA_BLUE_MASK, !iar->b_bottom_up );
+    if( dib == NULL )
+        fprintf( stderr, "iaio_image_to_dib(): couldnt create bitmap for %s\n", iar->name );
+    return dib;
+}
+
+/* copies a bitmap FreeImage loaded into the pixels of iaf
+ * retval: 0 ok, 1 error */
+static int iaio_dib_to_image( FIBITMAP* dib, ia_image_t* iaf )
+{
+    FIBITMAP* dib24;
+
+    if( (int)FreeImage_GetWidth(dib) != iaf->i_width ||
+        (int)FreeImage_GetHeight(dib) != iaf->i_height ) {
+        fprintf( stderr, "iaio_dib_to_image(): image is %ux%u, the sequence is %dx%d\n",
+                 FreeImage_GetWidth(dib), FreeImage_GetHeight(dib),
+                 iaf->i_width, iaf->i_height );
+        return 1;
+    }
+
+    if( NULL == (dib24 = FreeImage_ConvertTo24Bits(dib)) )
+        return 1;
+    FreeImage_ConvertToRawBits( iaf->pix, dib24, iaf->i_pitch, 24,
+                                FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK,
+                                FI_RGBA_BLUE_MASK, !iaf->b_bottom_up );
+    FreeImage_Unload( dib24 );
+    return 0;
+}
+
 static inline int iaio_saveimage ( iaio_t* iaio, ia_image_t* iar )
 {
+    FIBITMAP* dib = NULL;
+    int result = 0;
+
     if( iaio->fin.output_stream != NULL )
     {
         fprintf( iaio->fin.output_stream,
                  "--myboundary\nContent-type: image/%s\n\n",
                  iaio->fin.mime_type );
 
-        if( !FreeImage_SaveToHandle(FreeImage_GetFIFFromFilename(iar->name),
-                               (FIBITMAP*)iar->dib,
+        if( NULL == (dib = iaio_image_to_dib(iar)) ||
+            !FreeImage_SaveToHandle(FreeImage_GetFIFFromFilename(iar->name),
+                               dib,
                                &iaio->fin.io,
                                (fi_handle)iaio->fin.output_stream,
                                0) )
         {
             fprintf( stderr, "iaio_saveimage(): FAILED to write to stream\n" );
-            return 1;
+            result = 1;
         }
     }
     else
     {
-        assert( iar->dib != NULL );
-        if( !FreeImage_Save(FreeImage_GetFIFFromFilename(iar->name),
-                           (FIBITMAP*)iar->dib,
-                           iar->name,
-                           0) )
+        /* bmp, ppm and pgm are written directly, the rest by FreeImage */
+        result = ia_rawimg_write( iar->name, iar, iaio->i_width, iaio->i_height );
+        if( result > 0 )
         {
-            fprintf( stderr, "iaio_saveimage(): FAILED to write %s\n", iar->name );
-            return 1;
+            result = 0;
+            if( NULL == (dib = iaio_image_to_dib(iar)) ||
+                !FreeImage_Save(FreeImage_GetFIFFromFilename(iar->name),
+                               dib,
+                               iar->name,
+                               0) )
+            {
+                fprintf( stderr, "iaio_saveimage(): FAILED to write %s\n", iar->name );
+                result = 1;
+            }
         }
 
-        if( iaio->b_thumbnail )
+        if( !result && iaio->b_thumbnail )
         {
-            FIBITMAP* thumbnail = FreeImage_MakeThumbnail( (FIBITMAP*)iar->dib, 100, true );
+            FIBITMAP* thumbnail;
+            if( dib == NULL && NULL == (dib = iaio_image_to_dib(iar)) )
+                return 1;
+            thumbnail = FreeImage_MakeThumbnail( dib, 100, true );
             if( !FreeImage_Save(FreeImage_GetFIFFromFilename(iar->name),
                                thumbnail,
                                iar->thumbname,
                                0) )
             {
                 fprintf( stderr, "iaio_saveimage(): FAILED to write %s\n", iar->name );
-                return 1;
+                result = 1;
             }
             FreeImage_Unload( thumbnail );
         }
     }
 
+    if( dib )
+        FreeImage_Unload( dib );
+    return result ? 1 : 0;
+}
+
+/* every output but files on disk */
+static int iaio_outputstreams( iaio_t* iaio, ia_image_t* iar )
+{
+    if( iaio->output_type & IAIO_Y4M_OUT )
+    {
+        if( ia_y4m_write_frame(iaio->y4m_out, iar) )
+            return 1;
+    }
+#ifdef HAVE_FFMPEG
+    if( iaio->output_type & IAIO_VIDEO )
+    {
+        if( ia_ffmpeg_enc_write(iaio->enc, iar) )
+            return 1;
+    }
+#endif
+    if( iaio->output_type & IAIO_DISPLAY )
+    {
+        if( iaio_displayimage(iaio, iar) )
+            return 1;
+    }
     return 0;
 }
 
@@ -114,12 +189,36 @@ int iaio_outputimage( iaio_t* iaio, ia_image_t* iar )
         if( iaio_saveimage(iaio, iar) )
             return 1;
     }
-    if( iaio->output_type & IAIO_DISPLAY )
+    return iaio_outputstreams( iaio, iar );
+}
+
+/* retval: 0 ok, 1 couldnt link, to is left alone or removed */
+static int iaio_linkimage( const char* from, const char* to )
+{
+    if( link(from, to) == 0 )
+        return 0;
+    if( errno != EEXIST || unlink(to) || link(from, to) )
+        return 1;
+    return 0;
+}
+
+int iaio_repeatimage( iaio_t* iaio, ia_image_t* iar, ia_image_t* prev )
+{
+    if( iaio->output_type & IAIO_DISK )
     {
-        if( iaio_displayimage(iaio, iar) )
+        bool b_linked = iaio->fin.output_stream == NULL && prev->name[0] != '\0' &&
+                        iaio_linkimage( prev->name, iar->name ) == 0;
+
+        if( b_linked && iaio->b_thumbnail &&
+            iaio_linkimage( prev->thumbname, iar->thumbname ) ) {
+            /* dont write through the link into the previous file */
+            unlink( iar->name );
+            b_linked = false;
+        }
+        if( !b_linked && iaio_saveimage(iaio, iar) )
             return 1;
     }
-    return 0;
+    return iaio_outputstreams( iaio, iar );
 }
 
 inline int offset ( int width, int row, int col, int color )
@@ -244,6 +343,7 @@ int iaio_file_probeimage( iaio_t* iaio )
 {
     FIBITMAP* dib = NULL;
     FREE_IMAGE_FORMAT fif = FIF_UNKNOWN;
+    int width, height;
 
     if( iaio->fin.filp == NULL ) {
         iaio->fin.filp = fopen( iaio->fin.filename, "r" );
@@ -260,6 +360,15 @@ int iaio_file_probeimage( iaio_t* iaio )
     fclose( iaio->fin.filp );
     iaio->fin.filp = NULL;
 
+    /* the native formats only need their header read */
+    if( ia_rawimg_probe(fn, &width, &height) == 0 )
+    {
+        iaio->i_width   = width;
+        iaio->i_height  = height;
+        iaio->i_size    = iaio->i_width * iaio->i_height;
+        return 0;
+    }
+
     fif = FreeImage_GetFileType( fn, 0 );
     if( fif == FIF_UNKNOWN )
         fif = FreeImage_GetFIFFromFilename( fn );
@@ -279,9 +388,42 @@ int iaio_file_probeimage( iaio_t* iaio )
     return 0;
 }
 
+ia_image_t* iaio_load_image( const char* file )
+{
+    FIBITMAP* dib = NULL;
+    FREE_IMAGE_FORMAT fif;
+    ia_image_t* iaf;
+    int width, height;
+
+    if( ia_rawimg_probe(file, &width, &height) == 0 ) {
+        if( (iaf = ia_image_create( width, height )) == NULL )
+            return NULL;
+        if( ia_rawimg_read( file, iaf, width, height ) == 0 )
+            return iaf;
+        ia_image_free( iaf );
+        return NULL;
+    }
+
+    fif = FreeImage_GetFileType( file, 0 );
+    if( fif == FIF_UNKNOWN )
+        fif = FreeImage_GetFIFFromFilename( file );
+    if( (fif != FIF_UNKNOWN) && FreeImage_FIFSupportsReading(fif) )
+        dib = FreeImage_Load( fif, file, 0 );
+    if( dib == NULL )
+        return NULL;
+
+    iaf = ia_image_create( FreeImage_GetWidth(dib), FreeImage_GetHeight(dib) );
+    if( iaf != NULL && iaio_dib_to_image( dib, iaf ) ) {
+        ia_image_free( iaf );
+        iaf = NULL;
+    }
+    FreeImage_Unload( dib );
+    return iaf;
+}
+
 int iaio_freeimage_decode_image( iaio_t* iaio, ia_image_t* iaf )
 {
-    FIMEMORY *hmem = FreeImage_OpenMemory( iaf->pix, iaf->i_size );
+    FIMEMORY *hmem = FreeImage_OpenMemory( iaf->encoded, iaf->i_encoded );
     if( NULL == hmem ) {
         fprintf( stderr, "iaio_freeimage_decode_image(): FreeImage_OpenMemory(): failed to open memory stream\n" );
         return 1;
@@ -290,25 +432,27 @@ int iaio_freeimage_decode_image( iaio_t* iaio, ia_image_t* iaf )
     FREE_IMAGE_FORMAT fif = FreeImage_GetFileTypeFromMemory( hmem, 0 );
     if( FIF_UNKNOWN == fif ) {
         fprintf( stderr, "iaio_freeimage_decode_image(): FreeImage_GetFileTypeFromMemory(): couldnt figure out file type\n" );
+        FreeImage_CloseMemory( hmem );
         return 1;
     }
 
     FIBITMAP *dib = FreeImage_LoadFromMemory( fif, hmem, 0 );
     if( NULL == dib ) {
         fprintf( stderr, "iaio_freeimage_decode_image(): FreeImage_LoadFromMemory(): couldnt load from memory\n" );
+        FreeImage_CloseMemory( hmem );
         return 1;
     }
 
-    ia_pixel_t* pix = iaf->pix;
-    iaf->dib = FreeImage_ConvertTo24Bits( dib );
-    iaf->pix = FreeImage_GetBits( (FIBITMAP*)iaf->dib );
-    iaf->i_size = iaio->i_size;
+    int result = iaio_dib_to_image( dib, iaf );
 
     FreeImage_Unload( dib );
     FreeImage_CloseMemory( hmem );
-    free( pix );
+    ia_free( iaf->encoded );
+    iaf->encoded = NULL;
+    iaf->i_encoded = 0;
 
-    return 0;
+    iaio = iaio;
+    return result;
 }
 
 /*
@@ -335,17 +479,23 @@ int iaio_file_getimage( iaio_t* iaio, ia_image_t* iaf )
         return 1;
     }
 
+    /* uncompressed files are read straight into iaf, theres nothing left
+     * for the analyze threads to decode */
+    result = ia_rawimg_read( str, iaf, iaio->i_width, iaio->i_height );
+    if( result < 0 ) {
+        return 1;
+    }
+    if( result == 0 ) {
+        return 0;
+    }
+
     switch( iaio->b_decode ) {
         case true:
             if( 0 != (result = stat(str, &buf)) ) {
                 return 1;
             }
 
-            if( iaf->dib ) {
-                FreeImage_Unload( (FIBITMAP*)iaf->dib );
-            }
-
-            if( NULL == (iaf->pix = malloc(buf.st_size * sizeof(uint8_t))) ) {
+            if( NULL == (iaf->encoded = malloc(buf.st_size * sizeof(uint8_t))) ) {
                 return 1;
             }
 
@@ -353,7 +503,7 @@ int iaio_file_getimage( iaio_t* iaio, ia_image_t* iaf )
                 return 1;
             }
 
-            if( buf.st_size != (result = fread(iaf->pix, sizeof(uint8_t), buf.st_size, stream)) ) {
+            if( buf.st_size != (result = fread(iaf->encoded, sizeof(uint8_t), buf.st_size, stream)) ) {
                 fprintf( stderr, "iaio_file_getimage(): fread(): read only %d/%d items\n", result, (int)buf.st_size );
                 return 1;
             }
@@ -363,7 +513,7 @@ int iaio_file_getimage( iaio_t* iaio, ia_image_t* iaf )
                 return 1;
             }
 
-            iaf->i_size = buf.st_size * sizeof(uint8_t);
+            iaf->i_encoded = buf.st_size * sizeof(uint8_t);
 
             break;
 
@@ -381,12 +531,11 @@ int iaio_file_getimage( iaio_t* iaio, ia_image_t* iaf )
                 return 1;
             }
 
-            if( iaf->dib ) {
-                FreeImage_Unload( (FIBITMAP*)iaf->dib );
-            }
-            iaf->dib = FreeImage_ConvertTo24Bits( dib );
-            iaf->pix = FreeImage_GetBits( (FIBITMAP*)iaf->dib );
+            result = iaio_dib_to_image( dib, iaf );
             FreeImage_Unload( dib );
+            if( result ) {
+                return 1;
+            }
 
             break;
 
@@ -424,6 +573,19 @@ int iaio_cam_getimage( iaio_t* iaio, ia_image_t* iaf )
     return -1;
 }
 
+/* drop the next name off the image list without loading it
+ * ret val:
+ * 1 = error
+ * 0 = no error
+ */
+static inline int iaio_file_skipimage( iaio_t* iaio )
+{
+    if( ia_fgets(iaio->fin.buf, 1031, iaio->fin.filp) == NULL ) {
+        return 1;
+    }
+    return 0;
+}
+
 /*
  * retval:
  * 1 = error
@@ -431,28 +593,71 @@ int iaio_cam_getimage( iaio_t* iaio, ia_image_t* iaf )
  */
 int iaio_getimage( iaio_t* iaio, ia_image_t* iaf )
 {
+    if( iaio->i_end && iaio->i_next >= iaio->i_end ) {
+        return 1;
+    }
+
     /* if reading from list of images */
     if( iaio->input_type == IAIO_FILE ) {
+        for( ; iaio->i_pos < iaio->i_next; iaio->i_pos++ ) {
+            if( iaio_file_skipimage(iaio) ) {
+                return 1;
+            }
+        }
         if( iaio_file_getimage(iaio, iaf) ) {
             //fprintf( stderr, "ERROR: iaio_getimage(): couldn't open image from file\n" );
             return 1;
         }
+        iaio->i_pos++;
     }
     /* if reading from camera */
     if( iaio->input_type == IAIO_CAMERA ) {
-        if( iaio_cam_getimage(iaio, iaf) < 0 ) {
-            fprintf( stderr, "ERROR: iaio_getimage(): couldn't get image from cam\n" );
+        /* a camera cant skip ahead, so frames in between are captured into
+         * iaf and overwritten */
+        for( ; iaio->i_pos <= iaio->i_next; iaio->i_pos++ ) {
+            if( iaio_cam_getimage(iaio, iaf) < 0 ) {
+                fprintf( stderr, "ERROR: iaio_getimage(): couldn't get image from cam\n" );
+                return 1;
+            }
+        }
+    }
+    if( iaio->input_type == IAIO_Y4M ) {
+        for( ; iaio->i_pos < iaio->i_next; iaio->i_pos++ ) {
+            if( ia_y4m_skip_frame(iaio->y4m) ) {
+                return 1;
+            }
+        }
+        if( ia_y4m_read_frame(iaio->y4m, iaf) ) {
             return 1;
         }
+        iaio->i_pos++;
     }
     if( iaio->input_type == IAIO_MOVIE ) {
 #ifdef HAVE_FFMPEG
-        if( ia_ffmpeg_read_frame(iaio->ffio, iaf) < 0 ) {
-            fprintf( stderr, "ERROR: iaio_getimage(): couldn't get image from movie file\n" );
+        if( iaio->shard ) {
+            /* the shard workers already applied the range and step */
+            if( ia_ffmpeg_shard_read_frame(iaio->shard, iaf) < 0 ) {
+                return 1;
+            }
+            iaio->i_next = iaio->shard->i_frame;
+            iaio->i_pos = iaio->i_next + 1;
+        }
+        else if( ia_ffmpeg_read_frame(iaio->ffio, iaf, iaio->i_next) < 0 ) {
             return 1;
         }
+        else {
+            /* the decoder may land past the frame we asked for if the stream
+             * skips frames, continue stepping from where it actually is */
+            iaio->i_next = iaio->ffio->i_frame;
+            iaio->i_pos = iaio->i_next + 1;
+            if( iaio->i_end && iaio->i_next >= iaio->i_end ) {
+                return 1;
+            }
+        }
 #endif
     }
+
+    iaio->i_next += iaio->i_step;
     return 0;
 }
 
@@ -563,6 +768,80 @@ static inline void iaio_display_close( void )
 #endif
 }
 
+/* returns true if name ends in extension ext */
+static bool iaio_has_ext( const char* name, const char* ext )
+{
+    const char* dot = ia_strrchr( name, '.' );
+    return dot != NULL && !strcasecmp( dot+1, ext );
+}
+
+/* frame rate for video outputs: the rate of the source slowed down by the
+ * step, or one frame per --spf seconds, or 25 fps if neither is known */
+static void iaio_output_rate( iaio_t* iaio, ia_param_t* p, int* num, int* den )
+{
+    int64_t n = 25, d = 1, a, b, t;
+
+    if( iaio->y4m && iaio->y4m->i_fps_num > 0 && iaio->y4m->i_fps_den > 0 ) {
+        n = iaio->y4m->i_fps_num;
+        d = (int64_t)iaio->y4m->i_fps_den * iaio->i_step;
+    }
+#ifdef HAVE_FFMPEG
+    else if( iaio->ffio && iaio->ffio->frame_duration.num > 0 ) {
+        n = iaio->ffio->frame_duration.den;
+        d = (int64_t)iaio->ffio->frame_duration.num * iaio->i_step;
+    }
+    else if( iaio->shard && iaio->shard->frame_duration.num > 0 ) {
+        n = iaio->shard->frame_duration.den;
+        d = (int64_t)iaio->shard->frame_duration.num * iaio->i_step;
+    }
+#endif
+    else if( p->i_spf > 0 ) {
+        n = 1;
+        d = p->i_spf;
+    }
+
+    for( a = n, b = d; b; t = a % b, a = b, b = t );
+    *num = n / a;
+    *den = d / a;
+}
+
+/* opens the YUV4MPEG2 writer when -o names a .y4m file or -x is y4m. the
+ * chroma layout of y4m input is kept, and so are the planes of the frames
+ * no filter changed. anything else is written as 4:4:4
+ * retval: 0 ok, 1 error */
+static int iaio_y4m_init( iaio_t* iaio, ia_param_t* p )
+{
+    ia_y4m_chroma_t chroma = iaio->y4m ? iaio->y4m->chroma : IA_Y4M_444;
+    int num, den;
+
+    iaio_output_rate( iaio, p, &num, &den );
+    iaio->y4m_out = ia_y4m_open_write( p->output_directory, iaio->i_width,
+                                       iaio->i_height, num, den, chroma );
+    if( !iaio->y4m_out )
+        return 1;
+    if( iaio->y4m )
+        iaio->y4m->b_keep = true;
+    return 0;
+}
+
+#ifdef HAVE_FFMPEG
+/* opens the encoder when -o names a video file instead of a directory
+ * retval: 0 ok, 1 error */
+static int iaio_video_init( iaio_t* iaio, ia_param_t* p )
+{
+    AVRational fps;
+
+    iaio_output_rate( iaio, p, &fps.num, &fps.den );
+
+    iaio->enc = ia_ffmpeg_enc_open( p->output_directory, p->vcodec,
+                                    iaio->i_width, iaio->i_height, fps,
+                                    p->b_thumbnail, sysconf(_SC_NPROCESSORS_ONLN) );
+    if( !iaio->enc )
+        return 1;
+    return 0;
+}
+#endif
+
 iaio_t* iaio_open( ia_param_t* p )
 {
     char pattern[] = "^.+\\.([tT][xX][tT])$";
@@ -574,7 +853,12 @@ iaio_t* iaio_open( ia_param_t* p )
     iaio->fin.buf = NULL;
     iaio->input_type =
     iaio->output_type = 0;
-    iaio->b_decode = 1 < p->i_threads ? true : false;
+
+    iaio->i_start = p->Settings.StartFrame;
+    iaio->i_step = p->Settings.Step ? p->Settings.Step : 1;
+    iaio->i_end = p->Settings.NumFrames ? iaio->i_start + p->Settings.NumFrames : 0;
+    iaio->i_next = iaio->i_start;
+    iaio->i_pos = 0;
 
     /* if cam input */
     if( p->b_vdev )
@@ -598,8 +882,22 @@ iaio_t* iaio_open( ia_param_t* p )
         status = regexec( &re, p->input_file, (size_t) 0, NULL, 0 );
         regfree( &re );
 
+        // raw video input, from a file or stdin
+        if( !strcmp(p->input_file, "-") || iaio_has_ext(p->input_file, "y4m") )
+        {
+            iaio->input_type = IAIO_Y4M;
+            iaio->y4m = ia_y4m_open_read( p->input_file );
+            if( !iaio->y4m )
+            {
+                fprintf( stderr, "ERROR: iaio_open(): failed to open y4m input %s\n", p->input_file );
+                return NULL;
+            }
+            iaio->i_width = iaio->y4m->i_width;
+            iaio->i_height = iaio->y4m->i_height;
+            iaio->i_size = iaio->i_width * iaio->i_height;
+        }
         // text file input
-        if( status == 0 )
+        else if( status == 0 )
         {
             iaio->input_type = IAIO_FILE;
             if( iaio_file_init(iaio, p) )
@@ -613,14 +911,27 @@ iaio_t* iaio_open( ia_param_t* p )
         {
 #ifdef HAVE_FFMPEG
             iaio->input_type = IAIO_MOVIE;
-            iaio->ffio = ia_ffmpeg_init( p->input_file );
-            if( !iaio->ffio ) {
-                fprintf(stderr,"failed to open ffmpeg stuff\n");
-                return NULL;
+            if( 1 < p->i_shards ) {
+                iaio->shard = ia_ffmpeg_shard_open( p->input_file, p->i_shards,
+                                                    iaio->i_start, iaio->i_end,
+                                                    iaio->i_step );
+                if( !iaio->shard )
+                    fprintf( stderr, "WARNING: iaio_open(): couldnt shard %s, decoding it serially\n", p->input_file );
+            }
+            if( iaio->shard ) {
+                iaio->i_width = iaio->shard->i_width;
+                iaio->i_height = iaio->shard->i_height;
+                iaio->i_size = iaio->shard->i_size;
+            } else {
+                iaio->ffio = ia_ffmpeg_init( p->input_file );
+                if( !iaio->ffio ) {
+                    fprintf(stderr,"failed to open ffmpeg stuff\n");
+                    return NULL;
+                }
+                iaio->i_width = iaio->ffio->i_width;
+                iaio->i_height = iaio->ffio->i_height;
+                iaio->i_size = iaio->ffio->i_size;
             }
-            iaio->i_width = iaio->ffio->i_width;
-            iaio->i_height = iaio->ffio->i_height;
-            iaio->i_size = iaio->ffio->i_size;
 #else
             fprintf( stderr, "Video IO is not supported, recompile with ffmpeg to gain support.\n" );
             return NULL;
@@ -628,6 +939,32 @@ iaio_t* iaio_open( ia_param_t* p )
         }
     }
     
+    /* only list files hand encoded images to the analyze threads */
+    iaio->b_decode = iaio->input_type == IAIO_FILE && 1 < p->i_threads;
+
+    if( p->output_directory[0] && !p->stream &&
+        (!strcmp(p->ext, "y4m") || iaio_has_ext(p->output_directory, "y4m")) )
+    {
+        iaio->output_type |= IAIO_Y4M_OUT;
+        if( iaio_y4m_init(iaio, p) )
+        {
+            fprintf( stderr, "ERROR: iaio_open(): failed to open y4m output %s\n", p->output_directory );
+            return NULL;
+        }
+    }
+    else
+#ifdef HAVE_FFMPEG
+    if( p->output_directory[0] && !p->stream && ia_ffmpeg_enc_is_video(p->output_directory) )
+    {
+        iaio->output_type |= IAIO_VIDEO;
+        if( iaio_video_init(iaio, p) )
+        {
+            fprintf( stderr, "ERROR: iaio_open(): failed to open video output %s\n", p->output_directory );
+            return NULL;
+        }
+    }
+    else
+#endif
     if( p->output_directory[0] )
     {
         iaio->output_type |= IAIO_DISK;
@@ -680,9 +1017,17 @@ iaio_t* iaio_open( ia_param_t* p )
 inline void iaio_close( iaio_t* iaio )
 {
 #ifdef HAVE_FFMPEG
-    if( iaio->input_type == IAIO_MOVIE )
+    if( iaio->input_type == IAIO_MOVIE && iaio->shard )
+        ia_ffmpeg_shard_close( iaio->shard );
+    else if( iaio->input_type == IAIO_MOVIE )
         ia_ffmpeg_close( iaio->ffio );
+    if( iaio->output_type & IAIO_VIDEO )
+        ia_ffmpeg_enc_close( iaio->enc );
 #endif
+    if( iaio->input_type == IAIO_Y4M )
+        ia_y4m_close( iaio->y4m );
+    if( iaio->output_type & IAIO_Y4M_OUT )
+        ia_y4m_close( iaio->y4m_out );
     if( iaio->output_type & IAIO_DISPLAY )
         iaio_display_close();
 #if (HAVE_V4L || HAVE_V4L2) && HAVE_LIBSWSCALE
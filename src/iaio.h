@@ -29,8 +29,12 @@
 #include <SDL/SDL.h>
 #endif
 #include "image_analyzer.h"
+#include "y4m.h"
+#include "rawimg.h"
 #ifdef HAVE_FFMPEG
 #include "ffmpeg.h"
+#include "ffmpeg_shard.h"
+#include "ffmpeg_encode.h"
 #endif
 #ifdef HAVE_V4L
 #include "v4l.h"
@@ -47,6 +51,9 @@
 #define IAIO_CAMERA     3
 #define IAIO_FILE       4
 #define IAIO_MOVIE      5
+#define IAIO_Y4M        6
+#define IAIO_VIDEO      8
+#define IAIO_Y4M_OUT    16
 
 /* image list-file io parameters */
 typedef struct iaio_file_t
@@ -76,12 +83,22 @@ typedef struct iaio_t
     uint32_t        i_size;
     uint32_t        i_width;
     uint32_t        i_height;
+    uint64_t        i_start;    // first source frame to read
+    uint64_t        i_step;     // read every i_step'th source frame
+    uint64_t        i_end;      // stop before this source frame, 0 = never
+    uint64_t        i_next;     // index of the next source frame wanted
+    uint64_t        i_pos;      // index of the frame the source delivers next
     bool            eoi;
     bool            b_thumbnail;
     bool            b_decode;
 
+    ia_y4m_t*       y4m;        // for YUV4MPEG2 input
+    ia_y4m_t*       y4m_out;    // for YUV4MPEG2 output
+
 #ifdef HAVE_FFMPEG
     ia_ffmpeg_t*    ffio;
+    ia_ffmpeg_shard_t* shard;   // used instead of ffio when decoding in parallel
+    ia_ffmpeg_enc_t* enc;       // for video file output
 #endif
 #ifdef HAVE_V4L
     ia_v4l_t*       v4l;
@@ -100,6 +117,16 @@ int iaio_getimage( iaio_t* iaio, ia_image_t* iaf );
 /* stores image data from iaf into file specified by str */
 int iaio_outputimage( iaio_t* iaio, ia_image_t* iar );
 
+/* outputs iar, whose pixels are those of prev, the frame output before it.
+ * files on disk are hard links to the ones of prev when it was written to
+ * disk, instead of being encoded again */
+int iaio_repeatimage( iaio_t* iaio, ia_image_t* iar, ia_image_t* prev );
+
+/* loads an image that isnt part of the sequence, a template say, at its
+ * own size
+ * retval: the image, NULL on error */
+ia_image_t* iaio_load_image( const char* file );
+
 /* open iaio object */
 iaio_t* iaio_open( ia_param_t* p );
 
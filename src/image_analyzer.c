@@ -33,7 +33,10 @@
 
 #include "common.h"
 #include "analyze.h"
+#include "numa.h"
 #include "filters/filters.h"
+#include "filters/median.h"
+#include "keypoints.h"
 
 int parse_args ( ia_param_t* p,int argc,char** argv );
 void usage ( void );
@@ -47,11 +50,14 @@ int main ( int argc,char** argv )
     {
 		return 1;
     }
+    ia_numa_set_policy( param.i_numa, param.b_hugepages,
+                        param.b_verbose || param.i_numa != IA_NUMA_NONE || param.b_hugepages );
     if ( analyze(&param) )
     {
         fprintf( stderr,"analyze error\n" );
 		return 1;
     }
+    ia_numa_report( stderr );
 /*
     if ( !print_statistics() )
         return 1;
@@ -70,12 +76,17 @@ int main ( int argc,char** argv )
 int parse_args ( ia_param_t* p,int argc,char** argv )
 {
 	int c;
+    int end = 0;
 
     memset( p->input_file,0,sizeof(char)*1031 );
     memset( p->output_directory,0,sizeof(char)*1031 );
     memset( p->filter,0,sizeof(int)*15 );
     strncpy( p->video_device,"/dev/video0",1031 );
     strncpy( p->ext,"bmp",16 );
+    memset( p->vcodec,0,sizeof(char)*16 );
+    memset( p->worker_cpus,0,sizeof(char)*256 );
+    memset( p->input_cpus,0,sizeof(char)*256 );
+    memset( p->output_cpus,0,sizeof(char)*256 );
 
     p->b_thumbnail = 0;
     p->i_duration = 0;
@@ -88,27 +99,84 @@ int parse_args ( ia_param_t* p,int argc,char** argv )
     p->Settings.BgStartFrame = 0;
     p->Settings.StartFrame = 0;
     p->Settings.NumBgFrames = 20;
-    p->Settings.NumFrames = 100;
+    p->Settings.NumFrames = 0;
     p->Settings.bgCount = 0;
     p->Settings.BgStep = 1;
     p->Settings.Step = 1;
-    p->Settings.Threshold = 128;
+    p->Settings.Threshold = 2.5;
     p->Settings.nChannels = 3;
     p->Settings.useHSV = 0;
+    p->Settings.Model = 0;
 
     p->BhattaSettings.NumBins1 = 16;
     p->BhattaSettings.NumBins2 = 2;
     p->BhattaSettings.NumBins3 = 2;
     p->BhattaSettings.SizePatch = 30;
     p->BhattaSettings.Alpha = 0;
+    p->BhattaSettings.useBgUpdateMask = 0;
+    p->BhattaSettings.Threshold = 0.5;
 
+    p->BhattaOptSettings.NumBins1 = 16;
+    p->BhattaOptSettings.NumBins2 = 2;
+    p->BhattaOptSettings.NumBins3 = 2;
+    p->BhattaOptSettings.MaxSizePatch = 0;
+    p->BhattaOptSettings.Regularizer = 0.1;
+    p->BhattaOptSettings.Alpha = 0;
     p->BhattaOptSettings.useBgUpdateMask = 0;
+    p->BhattaOptSettings.Threshold = 0.5;
+
+    p->BlobsSettings.Threshold = 128;
+    p->BlobsSettings.MinArea = 1;
+    memset( p->BlobsSettings.ListFile,0,sizeof(char)*1031 );
+
+    p->TrackSettings.MinIou = 0.1;
+    p->TrackSettings.Gate = 32;
+    p->TrackSettings.MaxMisses = 5;
+    memset( p->TrackSettings.ListFile,0,sizeof(char)*1031 );
+
+    p->MorphSettings.Width = 0;
+    p->MorphSettings.Height = 0;
+    p->MorphSettings.Threshold = 128;
+    p->MorphSettings.Gray = 0;
+
+    p->MedianSettings.Radius = 1;
+
+    p->CannySettings.Low = 50;
+    p->CannySettings.High = 150;
+
+    p->CornersSettings.Method = IA_KEYPOINTS_FAST;
+    p->CornersSettings.Threshold = -1;
+    p->CornersSettings.CellWidth = 32;
+    p->CornersSettings.CellHeight = 32;
+    p->CornersSettings.MaxPerCell = 4;
+    memset( p->CornersSettings.ListFile,0,sizeof(char)*1031 );
+
+    p->StabSettings.Enable = 0;
+    p->StabSettings.Window = 0;
+
+    p->ClaheSettings.Clip = 2.0;
+
+    memset( p->TemplateSettings.File,0,sizeof(char)*1031 );
+    memset( p->TemplateSettings.ListFile,0,sizeof(char)*1031 );
+
+    p->SceneSettings.Keyframes = 0;
+    p->SceneSettings.Threshold = 4.0;
+    p->SceneSettings.MinDist = 0.2;
+    memset( p->SceneSettings.ListFile,0,sizeof(char)*1031 );
+
+    p->GateSettings.Threshold = -1;
+    p->GateSettings.Drop = 0;
+
+    p->DedupSettings.Enable = 0;
     p->i_width = 0;
     p->i_height = 0;
     p->b_vdev = 1;
     p->display = 0;
     p->i_threads = 1;
+    p->i_shards = 0;
     p->i_vframes = 0;
+    p->i_numa = IA_NUMA_NONE;
+    p->b_hugepages = 0;
 
 	for ( ;; )
 	{
@@ -132,6 +200,58 @@ int parse_args ( ia_param_t* p,int argc,char** argv )
             {"thumbnail"    ,0,0,0},
             {"duration"     ,1,0,0},
             {"spf"          ,1,0,0},
+            {"start"        ,1,0,0},
+            {"end"          ,1,0,0},
+            {"step"         ,1,0,0},
+            {"shards"       ,1,0,0},
+            {"vcodec"       ,1,0,0},
+            {"numa"         ,1,0,0},
+            {"hugepages"    ,0,0,0},
+            {"worker-cpus"  ,1,0,0},
+            {"input-cpus"   ,1,0,0},
+            {"output-cpus"  ,1,0,0},
+            {"bg-model"     ,1,0,0},
+            {"bg-frames"    ,1,0,0},
+            {"bg-threshold" ,1,0,0},
+            {"bg-step"      ,1,0,0},
+            {"bg-gray"      ,0,0,0},
+            {"bhatta-bins"  ,1,0,0},
+            {"bhatta-patch" ,1,0,0},
+            {"bhatta-max-patch",1,0,0},
+            {"bhatta-regularizer",1,0,0},
+            {"bhatta-alpha" ,1,0,0},
+            {"bhatta-threshold",1,0,0},
+            {"bhatta-update-mask",0,0,0},
+            {"blobs-threshold",1,0,0},
+            {"blobs-min-area",1,0,0},
+            {"blobs-list"   ,1,0,0},
+            {"track-iou"    ,1,0,0},
+            {"track-gate"   ,1,0,0},
+            {"track-max-misses",1,0,0},
+            {"track-list"   ,1,0,0},
+            {"morph-size"   ,1,0,0},
+            {"morph-threshold",1,0,0},
+            {"morph-gray"   ,0,0,0},
+            {"median-radius",1,0,0},
+            {"canny-low"    ,1,0,0},
+            {"canny-high"   ,1,0,0},
+            {"corners-method",1,0,0},
+            {"corners-threshold",1,0,0},
+            {"corners-cell" ,1,0,0},
+            {"corners-max"  ,1,0,0},
+            {"corners-list" ,1,0,0},
+            {"stabilize"    ,0,0,0},
+            {"stab-window"  ,1,0,0},
+            {"clahe-clip"   ,1,0,0},
+            {"template"     ,1,0,0},
+            {"template-list",1,0,0},
+            {"keyframes"    ,0,0,0},
+            {"scene-threshold",1,0,0},
+            {"scene-min"    ,1,0,0},
+            {"scene-list"   ,1,0,0},
+            {"gate"         ,1,0,0},
+            {"gate-drop"    ,0,0,0},
+            {"dedup"        ,0,0,0},
 			{0              ,0,0,0}
 		};
 
@@ -262,6 +382,196 @@ int parse_args ( ia_param_t* p,int argc,char** argv )
             p->i_duration = strtoul( optarg, NULL, 10 );
         else if( (option_index == 17 && c == 0) || (option_index == 0 && c == 'u') )
             p->i_spf = strtoul( optarg, NULL, 10 );
+        else if( (option_index == 18 && c == 0) )
+            p->Settings.StartFrame = strtoul( optarg, NULL, 10 );
+        else if( (option_index == 19 && c == 0) )
+            end = strtoul( optarg, NULL, 10 );
+        else if( (option_index == 20 && c == 0) )
+        {
+            p->Settings.Step = strtoul( optarg, NULL, 10 );
+            p->Settings.Step = p->Settings.Step ? p->Settings.Step : 1;
+        }
+        else if( (option_index == 21 && c == 0) )
+            p->i_shards = strtoul( optarg, NULL, 10 );
+        else if( (option_index == 22 && c == 0) )
+            strncpy( p->vcodec, optarg, 15 );
+        else if( (option_index == 23 && c == 0) )
+        {
+            p->i_numa = ia_numa_parse_policy( optarg );
+            if( p->i_numa < 0 )
+            {
+                fprintf( stderr,"Unknown numa policy %s\n", optarg );
+                usage();
+                return 1;
+            }
+        }
+        else if( (option_index == 24 && c == 0) )
+            p->b_hugepages = true;
+        else if( (option_index >= 25 && option_index <= 27 && c == 0) )
+        {
+            char* cpus = option_index == 25 ? p->worker_cpus :
+                         option_index == 26 ? p->input_cpus : p->output_cpus;
+            int list[IA_NUMA_MAX_CPUS];
+
+            if( ia_numa_parse_cpus(optarg, list, IA_NUMA_MAX_CPUS) <= 0 )
+            {
+                fprintf( stderr,"Bad cpu list %s\n", optarg );
+                usage();
+                return 1;
+            }
+            strncpy( cpus, optarg, 255 );
+        }
+        else if( (option_index == 28 && c == 0) )
+        {
+            if( !strcmp(optarg, "gauss") )
+                p->Settings.Model = 0;
+            else if( !strcmp(optarg, "mog") )
+                p->Settings.Model = 1;
+            else
+            {
+                fprintf( stderr,"Unknown background model %s\n", optarg );
+                usage();
+                return 1;
+            }
+        }
+        else if( (option_index == 29 && c == 0) )
+        {
+            p->Settings.NumBgFrames = strtoul( optarg, NULL, 10 );
+            p->Settings.NumBgFrames = p->Settings.NumBgFrames ? p->Settings.NumBgFrames : 1;
+        }
+        else if( (option_index == 30 && c == 0) )
+        {
+            p->Settings.Threshold = strtod( optarg, NULL );
+            p->Settings.Threshold = p->Settings.Threshold < 0 ? 0 :
+                                    p->Settings.Threshold > 10 ? 10 : p->Settings.Threshold;
+        }
+        else if( (option_index == 31 && c == 0) )
+        {
+            p->Settings.BgStep = strtoul( optarg, NULL, 10 );
+            p->Settings.BgStep = p->Settings.BgStep ? p->Settings.BgStep : 1;
+        }
+        else if( (option_index == 32 && c == 0) )
+            p->Settings.nChannels = 1;
+        else if( (option_index == 33 && c == 0) )
+        {
+            int b1, b2, b3;
+            if( sscanf( optarg, "%d,%d,%d", &b1, &b2, &b3 ) != 3 )
+            {
+                fprintf( stderr,"Bad bin counts %s\n", optarg );
+                usage();
+                return 1;
+            }
+            p->BhattaSettings.NumBins1 = p->BhattaOptSettings.NumBins1 = b1;
+            p->BhattaSettings.NumBins2 = p->BhattaOptSettings.NumBins2 = b2;
+            p->BhattaSettings.NumBins3 = p->BhattaOptSettings.NumBins3 = b3;
+        }
+        else if( (option_index == 34 && c == 0) )
+            p->BhattaSettings.SizePatch = strtoul( optarg, NULL, 10 );
+        else if( (option_index == 35 && c == 0) )
+            p->BhattaOptSettings.MaxSizePatch = strtoul( optarg, NULL, 10 );
+        else if( (option_index == 36 && c == 0) )
+            p->BhattaOptSettings.Regularizer = strtod( optarg, NULL );
+        else if( (option_index == 37 && c == 0) )
+            p->BhattaSettings.Alpha = p->BhattaOptSettings.Alpha = strtod( optarg, NULL );
+        else if( (option_index == 38 && c == 0) )
+            p->BhattaSettings.Threshold = p->BhattaOptSettings.Threshold = strtod( optarg, NULL );
+        else if( (option_index == 39 && c == 0) )
+            p->BhattaSettings.useBgUpdateMask = p->BhattaOptSettings.useBgUpdateMask = 1;
+        else if( (option_index == 40 && c == 0) )
+            p->BlobsSettings.Threshold = strtoul( optarg, NULL, 10 );
+        else if( (option_index == 41 && c == 0) )
+            p->BlobsSettings.MinArea = strtoul( optarg, NULL, 10 );
+        else if( (option_index == 42 && c == 0) )
+            strncpy( p->BlobsSettings.ListFile, optarg, 1030 );
+        else if( (option_index == 43 && c == 0) )
+            p->TrackSettings.MinIou = strtod( optarg, NULL );
+        else if( (option_index == 44 && c == 0) )
+            p->TrackSettings.Gate = strtod( optarg, NULL );
+        else if( (option_index == 45 && c == 0) )
+            p->TrackSettings.MaxMisses = strtoul( optarg, NULL, 10 );
+        else if( (option_index == 46 && c == 0) )
+            strncpy( p->TrackSettings.ListFile, optarg, 1030 );
+        else if( (option_index == 47 && c == 0) )
+        {
+            if( sscanf( optarg, "%dx%d", &p->MorphSettings.Width, &p->MorphSettings.Height ) != 2 ||
+                p->MorphSettings.Width < 1 || p->MorphSettings.Height < 1 )
+            {
+                fprintf( stderr,"Bad structuring element size %s\n", optarg );
+                usage();
+                return 1;
+            }
+        }
+        else if( (option_index == 48 && c == 0) )
+            p->MorphSettings.Threshold = strtoul( optarg, NULL, 10 );
+        else if( (option_index == 49 && c == 0) )
+            p->MorphSettings.Gray = 1;
+        else if( (option_index == 50 && c == 0) )
+        {
+            p->MedianSettings.Radius = strtol( optarg, NULL, 10 );
+            if( p->MedianSettings.Radius < 0 || p->MedianSettings.Radius > MEDIAN_MAX_RADIUS )
+            {
+                fprintf( stderr,"Median radius has to be in 0..%d\n", MEDIAN_MAX_RADIUS );
+                usage();
+                return 1;
+            }
+        }
+        else if( (option_index == 51 && c == 0) )
+            p->CannySettings.Low = strtoul( optarg, NULL, 10 );
+        else if( (option_index == 52 && c == 0) )
+            p->CannySettings.High = strtoul( optarg, NULL, 10 );
+        else if( (option_index == 53 && c == 0) )
+        {
+            if( !strcmp( optarg, "fast" ) )
+                p->CornersSettings.Method = IA_KEYPOINTS_FAST;
+            else if( !strcmp( optarg, "harris" ) )
+                p->CornersSettings.Method = IA_KEYPOINTS_HARRIS;
+            else
+            {
+                fprintf( stderr,"Unknown corner detector %s\n", optarg );
+                usage();
+                return 1;
+            }
+        }
+        else if( (option_index == 54 && c == 0) )
+            p->CornersSettings.Threshold = strtoul( optarg, NULL, 10 );
+        else if( (option_index == 55 && c == 0) )
+        {
+            if( sscanf( optarg, "%dx%d", &p->CornersSettings.CellWidth, &p->CornersSettings.CellHeight ) != 2 ||
+                p->CornersSettings.CellWidth < 1 || p->CornersSettings.CellHeight < 1 )
+            {
+                fprintf( stderr,"Bad keypoint cell size %s\n", optarg );
+                usage();
+                return 1;
+            }
+        }
+        else if( (option_index == 56 && c == 0) )
+            p->CornersSettings.MaxPerCell = strtoul( optarg, NULL, 10 );
+        else if( (option_index == 57 && c == 0) )
+            strncpy( p->CornersSettings.ListFile, optarg, 1030 );
+        else if( (option_index == 58 && c == 0) )
+            p->StabSettings.Enable = 1;
+        else if( (option_index == 59 && c == 0) )
+            p->StabSettings.Window = strtoul( optarg, NULL, 10 );
+        else if( (option_index == 60 && c == 0) )
+            p->ClaheSettings.Clip = strtod( optarg, NULL );
+        else if( (option_index == 61 && c == 0) )
+            strncpy( p->TemplateSettings.File, optarg, 1030 );
+        else if( (option_index == 62 && c == 0) )
+            strncpy( p->TemplateSettings.ListFile, optarg, 1030 );
+        else if( (option_index == 63 && c == 0) )
+            p->SceneSettings.Keyframes = 1;
+        else if( (option_index == 64 && c == 0) )
+            p->SceneSettings.Threshold = strtod( optarg, NULL );
+        else if( (option_index == 65 && c == 0) )
+            p->SceneSettings.MinDist = strtod( optarg, NULL );
+        else if( (option_index == 66 && c == 0) )
+            strncpy( p->SceneSettings.ListFile, optarg, 1030 );
+        else if( (option_index == 67 && c == 0) )
+            p->GateSettings.Threshold = strtod( optarg, NULL );
+        else if( (option_index == 68 && c == 0) )
+            p->GateSettings.Drop = 1;
+        else if( (option_index == 69 && c == 0) )
+            p->DedupSettings.Enable = 1;
 		else
 		{
 			fprintf ( stderr,"Unrecognized option -%c\n",c );
@@ -276,7 +586,69 @@ int parse_args ( ia_param_t* p,int argc,char** argv )
         usage ();
         return 1;
     }
+    if( end )
+    {
+        if( end <= p->Settings.StartFrame )
+        {
+            fprintf( stderr,"--end must be past --start\n" );
+            usage ();
+            return 1;
+        }
+        p->Settings.NumFrames = end - p->Settings.StartFrame;
+    }
+    if( p->DedupSettings.Enable && p->StabSettings.Enable )
+    {
+        fprintf( stderr,"--dedup cant be used with --stabilize, the warp of a repeated frame still changes\n" );
+        usage ();
+        return 1;
+    }
+    /* these filters carry state from every earlier frame, so a repeated
+     * ref window doesnt mean a repeated output */
+    for( c = 0; c < 15 && p->filter[c] && p->DedupSettings.Enable; c++ )
+    {
+        if( p->filter[c] == BGSUB || p->filter[c] == BHATTA || p->filter[c] == TRACK )
+        {
+            fprintf( stderr,"--dedup has no effect with %s, its output depends on every earlier frame\n",
+                     FILTERS[p->filter[c]-1] );
+            p->DedupSettings.Enable = 0;
+        }
+    }
+    /* the lists and the output stream all write "-" to stdout, only one of
+     * them can have it */
+    {
+        const char* lists[] = { p->BlobsSettings.ListFile, p->TrackSettings.ListFile,
+                                p->CornersSettings.ListFile, p->TemplateSettings.ListFile,
+                                p->SceneSettings.ListFile };
+        const char* names[] = { "--blobs-list", "--track-list", "--corners-list",
+                                "--template-list", "--scene-list" };
+        const char* user = NULL;
+
+        if( p->stream ? p->output_directory[0] == '-'
+                      : !strcmp( p->output_directory, "-" ) && !strcmp( p->ext, "y4m" ) )
+            user = "-o";
+        for( c = 0; c < 5; c++ )
+        {
+            if( strcmp( lists[c], "-" ) )
+                continue;
+            if( user )
+            {
+                fprintf( stderr,"%s - cant be used with %s -, both would write to stdout\n", names[c], user );
+                usage ();
+                return 1;
+            }
+            user = names[c];
+        }
+    }
     p->i_size = p->i_width*p->i_height;
+    if( p->MorphSettings.Width == 0 )
+    {
+        p->MorphSettings.Width = p->i_mb_size;
+        p->MorphSettings.Height = p->i_mb_size;
+    }
+    if( p->CornersSettings.Threshold < 0 )
+    {
+        p->CornersSettings.Threshold = p->CornersSettings.Method == IA_KEYPOINTS_FAST ? 20 : 100;
+    }
 
 	return 0;
 }
@@ -288,25 +660,94 @@ void usage ( void )
 	printf ( "\n" );
 	printf ( "Options:\n" );
 	printf ( "  -i, --input <string>            List of images to be processed or a video file (requires ffmpeg)\n" );
-	printf ( "  -o, --output <string>           Directory to store output into\n" );
+    printf ( "                                      .y4m files and - (stdin) are read as YUV4MPEG2\n" );
+	printf ( "  -o, --output <string>           Directory to store output into, or a video file\n" );
+    printf ( "                                      (.avi .mkv .nut .mov .mp4, requires ffmpeg)\n" );
     printf ( "  -d, --video-device <string>     Video device to capture images from [/dev/video0]\n" );
     printf ( "  -x, --ext <string>              Output file name extension [bmp]\n" );
+    printf ( "                                      y4m writes YUV4MPEG2 to the -o file, - for stdout,\n" );
+    printf ( "                                      frames of y4m input no filter changed are copied as read\n" );
 #ifdef HAVE_LIBSDL
     printf ( "  -p, --display                   Display live output\n" );
 #endif
     printf ( "  -s, --stream                    Save images to one file, specified by -o\n" );
     printf ( "  -t, --thumbnail                 Create thumbnails [disabled]\n" );
+    printf ( "  --vcodec <string>               Codec for video output: ffv1,h264,mpeg4 [ffv1, h264 for .mov/.mp4]\n" );
 	printf ( "\n" );
 	printf ( "  -f, --filter <filter list>      List of filters to be used on sequence:\n" );
 	printf ( "                                      copy,bhatta,mbox,diff,sad,deriv,flow,\n" );
-    printf ( "                                      curv,ssd,me,blobs,monkey,normal,grayscale,blur\n" );
+    printf ( "                                      curv,ssd,me,blobs,monkey,normal,grayscale,blur,\n" );
+    printf ( "                                      tmedian,bgsub,track,dilate,erode,opening,closing,\n" );
+    printf ( "                                      median,canny,corners,equalize,clahe,\n" );
+    printf ( "                                      template\n" );
     printf ( "  -w, --width <int>               Image width, must be specified in video capture mode\n" );
     printf ( "  -h, --height <int>              Image height, must be specified in video capture mode\n" );
     printf ( "  -m, --refs <int>                Maximum number of refs to cache [4]\n" );
     printf ( "  -b, --mb-size <int>             Macroblock size to use in filters that use macroblocks [15]\n" );
+    printf ( "  --bg-model <string>             Background model for bgsub: gauss,mog [gauss]\n" );
+    printf ( "  --bg-frames <int>               Frames the background model averages over [20]\n" );
+    printf ( "  --bg-threshold <float>          Standard deviations from the background that are foreground [2.5]\n" );
+    printf ( "  --bg-step <int>                 Only update the background with every n'th frame [1]\n" );
+    printf ( "  --bg-gray                       Model the background in luma instead of color\n" );
+    printf ( "  --bhatta-bins <int,int,int>     Histogram bins per channel for bhatta [16,2,2]\n" );
+    printf ( "  --bhatta-patch <int>            Side of the patches bhatta compares [30]\n" );
+    printf ( "  --bhatta-max-patch <int>        Pick the patch size per pixel, up to this side [off]\n" );
+    printf ( "  --bhatta-regularizer <float>    How strongly the variable patch size favors large patches [0.1]\n" );
+    printf ( "  --bhatta-alpha <float>          Background update amount per frame, 0 keeps the first frame [0]\n" );
+    printf ( "  --bhatta-threshold <float>      Bhattacharyya distance (0-1) that is foreground [0.5]\n" );
+    printf ( "  --bhatta-update-mask            Only update the background where it matched\n" );
+    printf ( "  --blobs-threshold <int>         Luma above this is foreground for blobs and track [128]\n" );
+    printf ( "  --blobs-min-area <int>          Drop blobs with fewer pixels than this, blobs and track [1]\n" );
+    printf ( "  --blobs-list <string>           Write frame, area, centroid and box of every blob here, - for stdout\n" );
+    printf ( "  --track-iou <float>             Box overlap at which track matches a blob to a track [0.1]\n" );
+    printf ( "  --track-gate <float>            Centroid distance at which track matches a blob to a track [32]\n" );
+    printf ( "  --track-max-misses <int>        Frames a track survives without a blob [5]\n" );
+    printf ( "  --track-list <string>           Write the positions and summary of every track here, - for stdout\n" );
+    printf ( "  --morph-size <int>x<int>        Structuring element of dilate,erode,opening,closing [mb-size square]\n" );
+    printf ( "  --morph-threshold <int>         Luma above this is set in the mask the morphology filters work on [128]\n" );
+    printf ( "  --morph-gray                    Take the min/max of the pixels instead of working on a mask\n" );
+    printf ( "  --median-radius <int>           Window of median is 2r+1 pixels square, up to %d [1]\n", MEDIAN_MAX_RADIUS );
+    printf ( "  --canny-low <int>               Gradient (|dx|+|dy| of sobel on luma) of a weak canny edge [50]\n" );
+    printf ( "  --canny-high <int>              Gradient of a strong canny edge, weak ones need to touch one [150]\n" );
+    printf ( "  --corners-method <string>       Keypoint detector of corners: fast,harris [fast]\n" );
+    printf ( "  --corners-threshold <int>       Score a keypoint needs [20 for fast, 100 for harris]\n" );
+    printf ( "                                      fast: summed difference to the centre beyond it\n" );
+    printf ( "                                      harris: square root of the response\n" );
+    printf ( "  --corners-cell <int>x<int>      Cells keypoints are capped per [32x32]\n" );
+    printf ( "  --corners-max <int>             Keypoints kept per cell, the best ones [4]\n" );
+    printf ( "  --corners-list <string>         Write the keypoints of every frame here in binary, - for stdout\n" );
+    printf ( "  --clahe-clip <float>            Contrast limit of clahe, histogram bins are clipped at this times their mean [2]\n" );
+    printf ( "  --template <string>             Image template looks for, by normalised cross correlation of luma\n" );
+    printf ( "  --template-list <string>        Write the best match of every frame here, - for stdout\n" );
+    printf ( "\n" );
+    printf ( "  --stabilize                     Take the camera motion out of the frames before filtering them\n" );
+    printf ( "  --stab-window <int>             Frames the camera path is smoothed over [refs]\n" );
+    printf ( "  --keyframes                     Only output the frames a scene starts on\n" );
+    printf ( "  --scene-threshold <float>       Standard deviations a cut is above the recent colour histogram distances [4]\n" );
+    printf ( "  --scene-min <float>             Colour histogram distance of a cut at least, 0 to 1 [0.2]\n" );
+    printf ( "  --scene-list <string>           Write the frames scenes are cut at here, - for stdout\n" );
+    printf ( "  --gate <float>                  Only filter frames whose 1/8 scale luma differs from the last filtered one\n" );
+    printf ( "                                      by more than this per sample, others repeat its output\n" );
+    printf ( "                                      (bgsub,bhatta,blobs,corners,template,track still see them)\n" );
+    printf ( "  --gate-drop                     Dont output gated frames instead of repeating\n" );
+    printf ( "  --dedup                         Repeat the previous output, hard linking files, when the input\n" );
+    printf ( "                                      frames of the ref window are bit identical to the previous ones\n" );
+    printf ( "                                      (off with bgsub,bhatta,track, which depend on every frame)\n" );
     printf ( "\n" );
     printf ( "  --vframes <int>                 The number of frames to process\n" );
+    printf ( "  --start <int>                   First input frame to process, seeks in video files [0]\n" );
+    printf ( "  --end <int>                     Stop before this input frame [end of input]\n" );
+    printf ( "  --step <int>                    Only process every n'th input frame [1]\n" );
     printf ( "  -j, --threads <int>             Parallel processing\n" );
+    printf ( "  --shards <int>                  Decode video input with this many decoders in parallel [1]\n" );
+    printf ( "  --numa <string>                 Frame buffer placement: none,local,interleave [none]\n" );
+    printf ( "                                      local puts pages on the node of the thread writing them first,\n" );
+    printf ( "                                      input frames on the node of their worker with --worker-cpus\n" );
+    printf ( "                                      interleave spreads them over all nodes\n" );
+    printf ( "  --hugepages                     Back frame buffers with 2MB huge pages when available\n" );
+    printf ( "  --worker-cpus <list>            Pin processing threads to these cpus, one each (e.g. 0-3,8)\n" );
+    printf ( "  --input-cpus <list>             Pin the input thread to these cpus\n" );
+    printf ( "  --output-cpus <list>            Pin the output thread to these cpus\n" );
     printf ( "  -l, --duration <int>            How long to record for, measured in seconds [0]\n" );
     printf ( "  -u, --spf <int>                 Length of time it takes to record one frame, measured in seconds [0]\n" );
     printf ( "  -v, --verbose                   Verbose/debug mode will display lots of additional information\n" );
@@ -25,13 +25,17 @@
 
 #include "common.h"
 
+/* most filters there can be, filter indexes are below this */
+#define IA_MAX_FILTERS 64
+
 typedef struct
 {
     char input_file[1031];
     char output_directory[1031];
     char video_device[1031];
     char ext[16];
-    int filter[20];
+    char vcodec[16];    // codec for video output, empty picks one from the container
+    int filter[IA_MAX_FILTERS];
 
     int32_t i_spf;      // seconds per frame
     int32_t i_duration; // record duration in seconds
@@ -41,6 +45,7 @@ typedef struct
     int32_t i_height;
     int32_t i_mb_size; 
     int32_t i_threads;
+    int32_t i_shards;   // number of parallel video decoders
     int32_t b_verbose;
     int32_t b_vdev;     // true if capturing from video device
     int32_t display;
@@ -48,6 +53,12 @@ typedef struct
     uint64_t i_vframes;
     bool b_thumbnail;
 
+    int32_t i_numa;         // IA_NUMA_* placement of frame buffers
+    bool b_hugepages;       // back frame buffers with explicit 2MB pages
+    char worker_cpus[256];  // cpu lists to pin threads to, empty leaves them be
+    char input_cpus[256];
+    char output_cpus[256];
+
     /* bgsub code params */
     struct {
         char ImLoc[500];
@@ -68,6 +79,8 @@ typedef struct
         int nChannels;
 
         int useHSV;
+
+        int Model;                  // bgsub model, BGSUB_GAUSS or BGSUB_MOG
     } Settings;
 
     struct {
@@ -77,6 +90,7 @@ typedef struct
         int SizePatch;
         double Alpha;               // background update amount 
         int useBgUpdateMask;
+        double Threshold;           // bhattacharyya distance that is foreground
     } BhattaSettings;
 
     struct {
@@ -87,8 +101,78 @@ typedef struct
         double Regularizer;
         double Alpha;               // background update amount 
         int useBgUpdateMask;
+        double Threshold;
     } BhattaOptSettings;
 
+    struct {
+        int Threshold;              // luma above this is foreground
+        int MinArea;                // smaller blobs are dropped
+        char ListFile[1031];        // blob list goes here, - for stdout
+    } BlobsSettings;
+
+    struct {
+        double MinIou;              // boxes overlapping this much are the same object
+        double Gate;                // and so are centroids this close, in pixels
+        int MaxMisses;              // frames a track survives unseen
+        char ListFile[1031];        // track list goes here, - for stdout
+    } TrackSettings;
+
+    struct {
+        int Width;                  // structuring element, --mb-size if 0
+        int Height;
+        int Threshold;              // luma above this is set in the mask
+        int Gray;                   // min/max of the pixels instead of a mask
+    } MorphSettings;
+
+    struct {
+        int Radius;                 // window is 2*Radius+1 pixels square
+    } MedianSettings;
+
+    struct {
+        int Low;                    // l1 sobel magnitude a weak edge needs
+        int High;                   // and a strong one
+    } CannySettings;
+
+    struct {
+        int Method;                 // IA_KEYPOINTS_FAST or IA_KEYPOINTS_HARRIS
+        int Threshold;              // score a keypoint needs, -1 for the default of Method
+        int CellWidth;              // keypoints are capped per cell of this size
+        int CellHeight;
+        int MaxPerCell;
+        char ListFile[1031];        // binary keypoint list goes here, - for stdout
+    } CornersSettings;
+
+    struct {
+        int Enable;                 // stabilise frames before the filters
+        int Window;                 // frames the camera path is smoothed over, --refs if 0
+    } StabSettings;
+
+    struct {
+        double Clip;                // histogram bins are clipped at this times their mean
+    } ClaheSettings;
+
+    struct {
+        char File[1031];            // image searched for in every frame
+        char ListFile[1031];        // best match of every frame goes here, - for stdout
+    } TemplateSettings;
+
+    struct {
+        int Keyframes;              // only output frames that start a scene
+        double Threshold;           // standard deviations above the mean distance a cut needs
+        double MinDist;             // and the histogram distance it needs at least
+        char ListFile[1031];        // cuts go here, - for stdout
+    } SceneSettings;
+
+    struct {
+        double Threshold;           // mean absolute difference on the 8x pyramid a frame
+                                    // needs to be filtered, -1 to filter every frame
+        int Drop;                   // gated frames arent output instead of repeating the last
+    } GateSettings;
+
+    struct {
+        int Enable;                 // frames repeating the ones before them repeat their output
+    } DedupSettings;
+
 } ia_param_t;
 
 #endif
@@ -0,0 +1,268 @@
+#include "keypoints.h"
+
+/* the bresenham circle of radius 3 fast tests, clockwise from the top */
+static const int8_t fast_circle[16][2] = {
+    { 0,-3}, { 1,-3}, { 2,-2}, { 3,-1}, { 3, 0}, { 3, 1}, { 2, 2}, { 1, 3},
+    { 0, 3}, {-1, 3}, {-2, 2}, {-3, 1}, {-3, 0}, {-3,-1}, {-2,-2}, {-1,-3}
+};
+
+/* 9 set bits in a row anywhere around the 16 bit circle m. the circle is
+ * doubled so runs through bit 15 to bit 0 are seen, then every bit is and'ed
+ * with the ones after it until only starts of 9 long runs are left. */
+static inline bool ia_fast_arc( uint32_t m )
+{
+    m |= m << 16;
+    m &= m >> 1;
+    m &= m >> 2;
+    m &= m >> 4;
+    m &= m >> 1;
+    return m != 0;
+}
+
+/* one row of fast scores. the brighter and darker bits of all pixels of the
+ * row are built one circle position at a time, so the inner loops are byte
+ * compares over the row that vectorize. */
+static void ia_keypoints_fast_row( ia_keypoints_t* k, const uint8_t* l, size_t stride,
+                                   int w, int t, int32_t* score )
+{
+    const int x0 = IA_KEYPOINTS_BORDER;
+    const int x1 = w - IA_KEYPOINTS_BORDER;
+    uint16_t* bright = k->mask;
+    uint16_t* dark = k->mask + w;
+    int x, i;
+
+    memset( k->mask, 0, 2 * w * sizeof(uint16_t) );
+    for( i = 0; i < 16; i++ )
+    {
+        const uint8_t* c = l + fast_circle[i][1] * (int) stride + fast_circle[i][0];
+
+        for( x = x0; x < x1; x++ ) {
+            bright[x] |= (c[x] > l[x] + t) << i;
+            dark[x] |= (c[x] < l[x] - t) << i;
+        }
+    }
+
+    for( x = x0; x < x1; x++ )
+    {
+        int sb = 0, sd = 0;
+
+        if( !ia_fast_arc( bright[x] ) && !ia_fast_arc( dark[x] ) )
+            continue;
+        for( i = 0; i < 16; i++ ) {
+            const int v = l[x + fast_circle[i][1] * (int) stride + fast_circle[i][0]];
+            if( bright[x] >> i & 1 )
+                sb += v - l[x] - t;
+            if( dark[x] >> i & 1 )
+                sd += l[x] - t - v;
+        }
+        score[x] = sb > sd ? sb : sd;
+    }
+}
+
+/* harris on the cached sobel gradients. the column sums of gx*gx, gy*gy and
+ * gx*gy move down a row with one row in and one out, the window sums along a
+ * row with one column in and one out. */
+static int ia_keypoints_harris( ia_keypoints_t* k, ia_image_t* iaf, int t )
+{
+    const int r = IA_KEYPOINTS_HARRIS_WINDOW / 2;
+    /* sobel is 4x the difference per pixel */
+    const double norm = 16.0 * IA_KEYPOINTS_HARRIS_WINDOW * IA_KEYPOINTS_HARRIS_WINDOW;
+    const int w = iaf->i_width;
+    const int h = iaf->i_height;
+    const int x0 = IA_KEYPOINTS_BORDER;
+    const int x1 = w - IA_KEYPOINTS_BORDER;
+    ia_cache_entry_t* gx = ia_cache_get( iaf, IA_CACHE_GRAD_X );
+    ia_cache_entry_t* gy = ia_cache_get( iaf, IA_CACHE_GRAD_Y );
+    int32_t* cxx = k->sums;
+    int32_t* cyy = k->sums + w;
+    int32_t* cxy = k->sums + 2*w;
+    int x, y, j;
+
+    if( gx == NULL || gy == NULL ) {
+        ia_cache_release( gx );
+        ia_cache_release( gy );
+        return 1;
+    }
+
+    /* the column sums start out over the window of the first row scored
+     * less its last row, every row adds the one coming in */
+    memset( k->sums, 0, 3 * w * sizeof(int32_t) );
+    for( y = IA_KEYPOINTS_BORDER - r; y < IA_KEYPOINTS_BORDER + r; y++ ) {
+        const int16_t* ax = (int16_t*) gx->data + y * gx->i_stride;
+        const int16_t* ay = (int16_t*) gy->data + y * gy->i_stride;
+        for( x = 0; x < w; x++ ) {
+            cxx[x] += ax[x] * ax[x];
+            cyy[x] += ay[x] * ay[x];
+            cxy[x] += ax[x] * ay[x];
+        }
+    }
+
+    for( y = IA_KEYPOINTS_BORDER; y < h - IA_KEYPOINTS_BORDER; y++ )
+    {
+        const int16_t* ax = (int16_t*) gx->data + (y+r) * gx->i_stride;
+        const int16_t* ay = (int16_t*) gy->data + (y+r) * gy->i_stride;
+        int32_t* score = k->score + (size_t)y * w;
+        int32_t sxx = 0, syy = 0, sxy = 0;
+
+        for( x = 0; x < w; x++ ) {
+            cxx[x] += ax[x] * ax[x];
+            cyy[x] += ay[x] * ay[x];
+            cxy[x] += ax[x] * ay[x];
+        }
+        if( y > IA_KEYPOINTS_BORDER ) {
+            const int16_t* bx = (int16_t*) gx->data + (y-r-1) * gx->i_stride;
+            const int16_t* by = (int16_t*) gy->data + (y-r-1) * gy->i_stride;
+            for( x = 0; x < w; x++ ) {
+                cxx[x] -= bx[x] * bx[x];
+                cyy[x] -= by[x] * by[x];
+                cxy[x] -= bx[x] * by[x];
+            }
+        }
+
+        for( j = x0 - r; j < x0 + r; j++ ) {
+            sxx += cxx[j];
+            syy += cyy[j];
+            sxy += cxy[j];
+        }
+        for( x = x0; x < x1; x++ )
+        {
+            double a, b, c, rsp;
+
+            sxx += cxx[x+r];
+            syy += cyy[x+r];
+            sxy += cxy[x+r];
+            a = sxx / norm;
+            b = syy / norm;
+            c = sxy / norm;
+            rsp = a*b - c*c - 0.04 * (a+b) * (a+b);
+            if( rsp > 0 && (rsp = sqrt( rsp )) >= t )
+                score[x] = rsp < INT32_MAX ? rsp : INT32_MAX;
+            sxx -= cxx[x-r];
+            syy -= cyy[x-r];
+            sxy -= cxy[x-r];
+        }
+    }
+
+    ia_cache_release( gx );
+    ia_cache_release( gy );
+    return 0;
+}
+
+static int ia_keypoints_alloc( ia_keypoints_t* k, int w, int h, int cells, int max_per_cell )
+{
+    const size_t n = (size_t)w * h;
+
+    if( n > k->i_score_size ) {
+        ia_free( k->score );
+        if( (k->score = ia_malloc( n * sizeof(int32_t) )) == NULL ) {
+            k->i_score_size = 0;
+            return 1;
+        }
+        k->i_score_size = n;
+    }
+    if( w > k->i_row_size ) {
+        ia_free( k->mask );
+        ia_free( k->sums );
+        k->mask = ia_malloc( 2 * w * sizeof(uint16_t) );
+        k->sums = ia_malloc( 3 * w * sizeof(int32_t) );
+        if( k->mask == NULL || k->sums == NULL ) {
+            k->i_row_size = 0;
+            return 1;
+        }
+        k->i_row_size = w;
+    }
+    if( cells * max_per_cell > k->i_size ) {
+        ia_free( k->kp );
+        if( (k->kp = ia_malloc( cells * max_per_cell * sizeof(ia_keypoint_t) )) == NULL ) {
+            k->i_size = 0;
+            return 1;
+        }
+        k->i_size = cells * max_per_cell;
+    }
+    return 0;
+}
+
+/* a local maximum over the 3x3 around it, ties go to the first in raster order */
+static inline bool ia_keypoints_is_max( const int32_t* s, int w )
+{
+    return s[0] > s[-w-1] && s[0] > s[-w] && s[0] > s[-w+1] && s[0] > s[-1] &&
+           s[0] >= s[1] && s[0] >= s[w-1] && s[0] >= s[w] && s[0] >= s[w+1];
+}
+
+int ia_keypoints_detect( ia_keypoints_t* k, ia_image_t* iaf, int method, int threshold,
+                         int cell_width, int cell_height, int max_per_cell )
+{
+    const int w = iaf->i_width;
+    const int h = iaf->i_height;
+    const int cw = (w + cell_width-1) / cell_width;
+    const int ch = (h + cell_height-1) / cell_height;
+    ia_cache_entry_t* luma;
+    int x, y, cx, cy;
+
+    k->i_kp = 0;
+    if( w <= 2*IA_KEYPOINTS_BORDER || h <= 2*IA_KEYPOINTS_BORDER || max_per_cell < 1 )
+        return 0;
+    if( ia_keypoints_alloc( k, w, h, cw * ch, max_per_cell ) )
+        return 1;
+
+    memset( k->score, 0, (size_t)w * h * sizeof(int32_t) );
+    if( method == IA_KEYPOINTS_HARRIS ) {
+        if( ia_keypoints_harris( k, iaf, threshold ) )
+            return 1;
+    } else {
+        if( (luma = ia_cache_get( iaf, IA_CACHE_LUMA )) == NULL )
+            return 1;
+        for( y = IA_KEYPOINTS_BORDER; y < h - IA_KEYPOINTS_BORDER; y++ )
+            ia_keypoints_fast_row( k, (uint8_t*) luma->data + y * luma->i_stride, luma->i_stride,
+                                   w, threshold, k->score + (size_t)y * w );
+        ia_cache_release( luma );
+    }
+
+    /* the best local maxima of every cell, insertion sorted as they turn up */
+    for( cy = 0; cy < ch; cy++ )
+    {
+        const int y0 = cy * cell_height > IA_KEYPOINTS_BORDER ? cy * cell_height : IA_KEYPOINTS_BORDER;
+        const int y1 = (cy+1) * cell_height < h - IA_KEYPOINTS_BORDER ?
+                       (cy+1) * cell_height : h - IA_KEYPOINTS_BORDER;
+
+        for( cx = 0; cx < cw; cx++ )
+        {
+            const int x0 = cx * cell_width > IA_KEYPOINTS_BORDER ? cx * cell_width : IA_KEYPOINTS_BORDER;
+            const int x1 = (cx+1) * cell_width < w - IA_KEYPOINTS_BORDER ?
+                           (cx+1) * cell_width : w - IA_KEYPOINTS_BORDER;
+            ia_keypoint_t* top = k->kp + k->i_kp;
+            int n = 0;
+
+            for( y = y0; y < y1; y++ )
+            {
+                const int32_t* s = k->score + (size_t)y * w;
+
+                for( x = x0; x < x1; x++ )
+                {
+                    int i;
+
+                    if( s[x] == 0 || (n == max_per_cell && s[x] <= top[n-1].score) ||
+                        !ia_keypoints_is_max( s + x, w ) )
+                        continue;
+                    i = n < max_per_cell ? n++ : n-1;
+                    for( ; i > 0 && top[i-1].score < s[x]; i-- )
+                        top[i] = top[i-1];
+                    top[i].x = x;
+                    top[i].y = y;
+                    top[i].score = s[x];
+                }
+            }
+            k->i_kp += n;
+        }
+    }
+    return 0;
+}
+
+void ia_keypoints_free( ia_keypoints_t* k )
+{
+    ia_free( k->kp );
+    ia_free( k->score );
+    ia_free( k->mask );
+    ia_free( k->sums );
+    memset( k, 0, sizeof(ia_keypoints_t) );
+}
@@ -0,0 +1,54 @@
+#ifndef _H_KEYPOINTS
+#define _H_KEYPOINTS
+
+#include "common.h"
+#include "cache.h"
+
+#define IA_KEYPOINTS_FAST       0   // fast-9 segment test on luma
+#define IA_KEYPOINTS_HARRIS     1   // harris response of the sobel gradients
+
+/* pixels at the frame edge without the full fast circle around them, no
+ * keypoint is closer to the edge than this */
+#define IA_KEYPOINTS_BORDER     3
+
+/* harris sums the gradient products over a square this wide */
+#define IA_KEYPOINTS_HARRIS_WINDOW 5
+
+/* a keypoint, rows in the order of pix. this is also the record written to
+ * keypoint lists. */
+typedef struct ia_keypoint_t
+{
+    uint16_t    x;
+    uint16_t    y;
+    int32_t     score;
+} ia_keypoint_t;
+
+/* keypoints of a frame and the buffers finding them. the frame is cut into
+ * cells and only the best i_max_per_cell local maxima of every cell are
+ * kept, so keypoints spread over the frame instead of piling up on its most
+ * textured part. they come out cell by cell in raster order, best first
+ * within a cell. */
+typedef struct ia_keypoints_t
+{
+    ia_keypoint_t* kp;
+    int         i_kp;
+    int         i_size;         // keypoints allocated
+    int32_t*    score;          // score of every pixel, 0 if not a corner
+    size_t      i_score_size;
+    uint16_t*   mask;           // fast: brighter and darker circle bits of a row
+    int32_t*    sums;           // harris: window column sums of a row
+    int         i_row_size;     // width mask and sums are allocated for
+} ia_keypoints_t;
+
+/* finds the keypoints of iaf with method, scoring at least threshold: the
+ * summed intensity difference to the centre beyond threshold over the
+ * segment for fast, the square root of the harris response (of gradients
+ * in intensity levels per pixel) for harris. k must be zeroed before its
+ * first use and can be reused for the next frame.
+ * retval: 0 ok, 1 couldnt allocate */
+int ia_keypoints_detect( ia_keypoints_t* k, ia_image_t* iaf, int method, int threshold,
+                         int cell_width, int cell_height, int max_per_cell );
+
+void ia_keypoints_free( ia_keypoints_t* k );
+
+#endif
@@ -0,0 +1,333 @@
+#include "morph.h"
+
+/* van herk / gil-werman: cut the line into blocks of k, keep the running max
+ * from the start of each block (g) and to its end (h). a window of k starting
+ * at s spans at most two blocks, its max is max(h[s], g[s+k-1]). three
+ * operations per sample whatever k is. */
+
+int ia_mask_init( ia_mask_t* m, int width, int height )
+{
+    m->i_width = width;
+    m->i_height = height;
+    m->i_words = (width + 63) / 64;
+    m->bits = ia_calloc( (size_t)m->i_words * height + 1, sizeof(uint64_t) );
+    return m->bits == NULL;
+}
+
+void ia_mask_free( ia_mask_t* m )
+{
+    ia_free( m->bits );
+    m->bits = NULL;
+}
+
+static inline uint64_t ia_mask_tail( ia_mask_t* m )
+{
+    return m->i_width & 63 ? (1ULL << (m->i_width & 63)) - 1 : ~0ULL;
+}
+
+void ia_mask_from_luma( ia_mask_t* m, ia_cache_entry_t* luma, int threshold )
+{
+    int x, y;
+
+    for( y = 0; y < m->i_height; y++ )
+    {
+        const uint8_t* l = (uint8_t*) luma->data + y * luma->i_stride;
+        uint64_t* row = m->bits + (size_t)y * m->i_words;
+
+        memset( row, 0, m->i_words * sizeof(uint64_t) );
+        for( x = 0; x < m->i_width; x++ )
+            row[x >> 6] |= (uint64_t)(l[x] > threshold) << (x & 63);
+    }
+}
+
+void ia_mask_to_image( ia_mask_t* m, ia_image_t* iar )
+{
+    int x, y;
+
+    for( y = 0; y < m->i_height; y++ )
+    {
+        const uint64_t* row = m->bits + (size_t)y * m->i_words;
+        ia_pixel_t* p = iar->pix + (size_t)y * iar->i_pitch;
+
+        for( x = 0; x < m->i_width; x++ )
+            p[3*x] = p[3*x+1] = p[3*x+2] = -(uint8_t)(row[x >> 6] >> (x & 63) & 1);
+    }
+}
+
+/* dst |= src moved s bits towards lower x (s > 0) or higher x (s < 0) */
+static void ia_mask_or_shifted( uint64_t* dst, const uint64_t* src, int n, int s )
+{
+    const int q = (s < 0 ? -s : s) >> 6;
+    const int r = (s < 0 ? -s : s) & 63;
+    int i;
+
+    if( s >= 0 ) {
+        for( i = 0; i + q < n; i++ ) {
+            uint64_t v = src[i+q] >> r;
+            if( r && i + q + 1 < n )
+                v |= src[i+q+1] << (64 - r);
+            dst[i] |= v;
+        }
+    } else {
+        for( i = q; i < n; i++ ) {
+            uint64_t v = src[i-q] << r;
+            if( r && i - q - 1 >= 0 )
+                v |= src[i-q-1] >> (64 - r);
+            dst[i] |= v;
+        }
+    }
+}
+
+/* t0 = the or of the k bits of row starting at each bit and going towards
+ * higher x (dir 1) or lower x (dir -1). by doubling: after each step every
+ * bit holds the or of span bits, the rest of k comes from one more shifted
+ * or. log2(k) word operations per 64 pixels. returns the buffer holding it. */
+static uint64_t* ia_mask_run( const uint64_t* row, uint64_t* t0, uint64_t* t1, int n, int k, int dir )
+{
+    int span = 1;
+
+    memcpy( t0, row, n * sizeof(uint64_t) );
+    while( span < k ) {
+        const int s = 2*span <= k ? span : k - span;
+        uint64_t* t = t0;
+
+        memcpy( t1, t0, n * sizeof(uint64_t) );
+        ia_mask_or_shifted( t1, t0, n, dir * s );
+        t0 = t1;
+        t1 = t;
+        span += s;
+    }
+    return t0;
+}
+
+/* the window of x is [x-left, x+right], the or of a run going left from x
+ * and one going right */
+static void ia_mask_dilate_row( uint64_t* row, uint64_t* t, int n, int k, uint64_t tail )
+{
+    const int left = (k-1) / 2;
+    const int right = k-1 - left;
+    uint64_t* r = ia_mask_run( row, t, t + n, n, right + 1, 1 );
+    uint64_t* l = ia_mask_run( row, t + 2*n, t + 3*n, n, left + 1, -1 );
+    int i;
+
+    for( i = 0; i < n; i++ )
+        row[i] = r[i] | l[i];
+    row[n-1] &= tail;
+}
+
+int ia_mask_dilate( ia_mask_t* m, int kw, int kh )
+{
+    const int n = m->i_words;
+    const int h = m->i_height;
+    const int above = (kh-1) / 2;
+    const uint64_t tail = ia_mask_tail( m );
+    uint64_t *t, *g, *hh;
+    int x, y, y0;
+
+    if( kw > 1 ) {
+        if( (t = ia_malloc( 4 * n * sizeof(uint64_t) )) == NULL )
+            return 1;
+        for( y = 0; y < h; y++ )
+            ia_mask_dilate_row( m->bits + (size_t)y * n, t, n, kw, tail );
+        ia_free( t );
+    }
+    if( kh <= 1 )
+        return 0;
+
+    /* vertically with van herk / gil-werman on whole words. the window of
+     * row y is [y-above, y-above+kh), rows outside the frame are 0. g and hh
+     * hold the rows -above .. h-1+kh-above, zero padded. */
+    {
+        const int rows = h + kh;
+        const size_t size = (size_t)rows * n;
+
+        g = ia_calloc( size, sizeof(uint64_t) );
+        hh = ia_calloc( size, sizeof(uint64_t) );
+        if( g == NULL || hh == NULL ) {
+            ia_free( g );
+            ia_free( hh );
+            return 1;
+        }
+
+        for( y = 0; y < h; y++ )
+            memcpy( g + (size_t)(y + above) * n, m->bits + (size_t)y * n, n * sizeof(uint64_t) );
+        memcpy( hh, g, size * sizeof(uint64_t) );
+
+        for( y0 = 0; y0 < rows; y0 += kh )
+        {
+            const int y1 = y0 + kh < rows ? y0 + kh : rows;
+            for( y = y0 + 1; y < y1; y++ ) {
+                uint64_t* a = g + (size_t)y * n;
+                const uint64_t* b = a - n;
+                for( x = 0; x < n; x++ )
+                    a[x] |= b[x];
+            }
+            for( y = y1 - 2; y >= y0; y-- ) {
+                uint64_t* a = hh + (size_t)y * n;
+                const uint64_t* b = a + n;
+                for( x = 0; x < n; x++ )
+                    a[x] |= b[x];
+            }
+        }
+
+        for( y = 0; y < h; y++ ) {
+            const uint64_t* a = hh + (size_t)y * n;
+            const uint64_t* b = g + (size_t)(y + kh - 1) * n;
+            uint64_t* d = m->bits + (size_t)y * n;
+            for( x = 0; x < n; x++ )
+                d[x] = a[x] | b[x];
+        }
+
+        ia_free( g );
+        ia_free( hh );
+    }
+    return 0;
+}
+
+static void ia_mask_invert( ia_mask_t* m )
+{
+    const uint64_t tail = ia_mask_tail( m );
+    size_t i;
+    int y;
+
+    for( i = 0; i < (size_t)m->i_words * m->i_height; i++ )
+        m->bits[i] = ~m->bits[i];
+    for( y = 0; y < m->i_height; y++ )
+        m->bits[(size_t)y * m->i_words + m->i_words-1] &= tail;
+}
+
+/* the background of the eroded mask is the dilated background */
+int ia_mask_erode( ia_mask_t* m, int kw, int kh )
+{
+    int rc;
+
+    ia_mask_invert( m );
+    rc = ia_mask_dilate( m, kw, kh );
+    ia_mask_invert( m );
+    return rc;
+}
+
+/* branchless, so the loops over rows below vectorize to byte min/max */
+static inline uint8_t ia_morph_pick( uint8_t a, uint8_t b, bool b_max )
+{
+    return b_max ? (a > b ? a : b) : (a < b ? a : b);
+}
+
+static void ia_morph_rows( uint8_t* d, const uint8_t* a, const uint8_t* b, int n, bool b_max )
+{
+    int i;
+
+    if( b_max )
+        for( i = 0; i < n; i++ )
+            d[i] = a[i] > b[i] ? a[i] : b[i];
+    else
+        for( i = 0; i < n; i++ )
+            d[i] = a[i] < b[i] ? a[i] : b[i];
+}
+
+int ia_morph_gray( ia_image_t* dst, ia_image_t* src, int kw, int kh, bool b_dilate )
+{
+    const int w = src->i_width;
+    const int h = src->i_height;
+    const int n = 3*w;
+    const uint8_t pad = b_dilate ? 0 : 255;     // neutral for max and min
+    const int lw = w + kw;                      // samples per padded line
+    const int rows = h + kh;
+    const int left = (kw-1) / 2;
+    const int above = (kh-1) / 2;
+    uint8_t *g, *hh, *line;
+    int x, y, y0, c;
+
+    g = ia_malloc( (size_t)rows * n );
+    hh = ia_malloc( (size_t)rows * n );
+    line = ia_malloc( 2 * (size_t)lw );
+    if( g == NULL || hh == NULL || line == NULL ) {
+        ia_free( g );
+        ia_free( hh );
+        ia_free( line );
+        return 1;
+    }
+
+    /* vertical pass first, whole rows at a time */
+    memset( g, pad, (size_t)rows * n );
+    for( y = 0; y < h; y++ )
+        memcpy( g + (size_t)(y + above) * n, src->pix + (size_t)y * src->i_pitch, n );
+    memcpy( hh, g, (size_t)rows * n );
+    for( y0 = 0; y0 < rows; y0 += kh )
+    {
+        const int y1 = y0 + kh < rows ? y0 + kh : rows;
+        for( y = y0 + 1; y < y1; y++ )
+            ia_morph_rows( g + (size_t)y * n, g + (size_t)y * n, g + (size_t)(y-1) * n, n, b_dilate );
+        for( y = y1 - 2; y >= y0; y-- )
+            ia_morph_rows( hh + (size_t)y * n, hh + (size_t)y * n, hh + (size_t)(y+1) * n, n, b_dilate );
+    }
+    for( y = 0; y < h; y++ )
+        ia_morph_rows( g + (size_t)y * n, hh + (size_t)y * n, g + (size_t)(y + kh - 1) * n, n, b_dilate );
+
+    /* then along each row, one channel at a time */
+    for( y = 0; y < h; y++ )
+    {
+        const uint8_t* v = g + (size_t)y * n;
+        ia_pixel_t* d = dst->pix + (size_t)y * dst->i_pitch;
+
+        for( c = 0; c < 3; c++ )
+        {
+            uint8_t* lg = line;
+            uint8_t* lh = line + lw;
+
+            memset( lg, pad, lw );
+            for( x = 0; x < w; x++ )
+                lg[x + left] = v[3*x + c];
+            memcpy( lh, lg, lw );
+
+            for( x = 0; x < lw; x++ )
+                if( x % kw )
+                    lg[x] = ia_morph_pick( lg[x], lg[x-1], b_dilate );
+            for( x = lw - 2; x >= 0; x-- )
+                if( (x+1) % kw )
+                    lh[x] = ia_morph_pick( lh[x], lh[x+1], b_dilate );
+
+            for( x = 0; x < w; x++ )
+                d[3*x + c] = ia_morph_pick( lh[x], lg[x + kw - 1], b_dilate );
+        }
+    }
+
+    ia_free( g );
+    ia_free( hh );
+    ia_free( line );
+    return 0;
+}
+
+int ia_morph( ia_image_t* iaf, ia_image_t* iar, int kw, int kh, int threshold,
+              bool b_gray, const char* ops )
+{
+    ia_cache_entry_t* luma;
+    ia_mask_t m;
+    int rc = 0;
+
+    kw = kw > 0 ? kw : 1;
+    kh = kh > 0 ? kh : 1;
+
+    if( b_gray ) {
+        for( ; *ops && !rc; ops++, iaf = iar )
+            rc = ia_morph_gray( iar, iaf, kw, kh, *ops == 'd' );
+        return rc;
+    }
+
+    if( (luma = ia_cache_get( iaf, IA_CACHE_LUMA )) == NULL )
+        return 1;
+    if( ia_mask_init( &m, iaf->i_width, iaf->i_height ) ) {
+        ia_cache_release( luma );
+        return 1;
+    }
+
+    ia_mask_from_luma( &m, luma, threshold );
+    for( ; *ops && !rc; ops++ )
+        rc = *ops == 'd' ? ia_mask_dilate( &m, kw, kh ) : ia_mask_erode( &m, kw, kh );
+    if( !rc )
+        ia_mask_to_image( &m, iar );
+
+    ia_mask_free( &m );
+    ia_cache_release( luma );
+    return rc;
+}
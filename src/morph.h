@@ -0,0 +1,45 @@
+#ifndef _H_MORPH
+#define _H_MORPH
+
+#include "common.h"
+#include "cache.h"
+
+/* a binary mask, one bit per pixel. bit x of a row is bit x&63 of word x>>6,
+ * the bits past i_width in the last word of a row are always 0. */
+typedef struct ia_mask_t
+{
+    int32_t     i_width;
+    int32_t     i_height;
+    int32_t     i_words;    // words per row
+    uint64_t*   bits;
+} ia_mask_t;
+
+/* retval: 0 ok, 1 couldnt allocate */
+int  ia_mask_init( ia_mask_t* m, int width, int height );
+void ia_mask_free( ia_mask_t* m );
+
+/* sets the pixels with luma above threshold */
+void ia_mask_from_luma( ia_mask_t* m, ia_cache_entry_t* luma, int threshold );
+
+/* writes the mask to iar, 255 set and 0 not */
+void ia_mask_to_image( ia_mask_t* m, ia_image_t* iar );
+
+/* dilates or erodes m in place by a kw x kh rectangle, centred on the pixel
+ * (one left and above of the centre for even sizes). pixels outside the
+ * frame are ignored, so erosion doesnt eat in from the edges.
+ * retval: 0 ok, 1 couldnt allocate */
+int  ia_mask_dilate( ia_mask_t* m, int kw, int kh );
+int  ia_mask_erode( ia_mask_t* m, int kw, int kh );
+
+/* the same on every byte of the pixels of src with the max (dilate) or min
+ * (erode) of the rectangle, into dst. dst can be src.
+ * retval: 0 ok, 1 couldnt allocate */
+int  ia_morph_gray( ia_image_t* dst, ia_image_t* src, int kw, int kh, bool b_dilate );
+
+/* runs ops, a string of 'd' (dilate) and 'e' (erode), on iaf into iar. on the
+ * mask of luma above threshold, or on the pixels themselves for b_gray.
+ * retval: 0 ok, 1 couldnt allocate */
+int  ia_morph( ia_image_t* iaf, ia_image_t* iar, int kw, int kh, int threshold,
+               bool b_gray, const char* ops );
+
+#endif
@@ -0,0 +1,314 @@
+/* for MAP_HUGETLB, madvise, CPU_SET and pthread_setaffinity_np */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "numa.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#ifdef HAVE_LINUX_MEMPOLICY_H
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#endif
+
+/* pages looked up per buffer when counting where it lives */
+#define IA_NUMA_SAMPLES 8
+
+static int      numa_policy = IA_NUMA_NONE;
+static bool     numa_hugepages = false;
+static bool     numa_count = false;
+static unsigned long numa_nodemask = 1;  // online nodes, for interleaving
+static int      numa_nodes = 1;
+static int      numa_cpu_node[IA_NUMA_MAX_CPUS];    // node of every cpu, -1 unknown
+
+static uint64_t numa_bytes[IA_NUMA_MAX_NODES];
+static uint64_t numa_buffers = 0;
+static uint64_t numa_huge = 0;      // buffers backed by MAP_HUGETLB pages
+
+void ia_numa_set_policy( int policy, bool b_hugepages, bool b_count )
+{
+    int nodes[IA_NUMA_MAX_NODES];
+    int cpus[IA_NUMA_MAX_CPUS];
+    char line[4096];
+    FILE* fp;
+    int i, j, c, n = 0;
+
+    numa_policy = policy;
+    numa_hugepages = b_hugepages;
+    numa_count = b_count;
+    for( i = 0; i < IA_NUMA_MAX_CPUS; i++ )
+        numa_cpu_node[i] = -1;
+
+    fp = fopen( "/sys/devices/system/node/online", "r" );
+    if( fp != NULL ) {
+        if( fgets(line, sizeof(line), fp) != NULL )
+            n = ia_numa_parse_cpus( line, nodes, IA_NUMA_MAX_NODES );
+        fclose( fp );
+    }
+    if( n <= 0 )
+        return;
+
+    numa_nodemask = 0;
+    numa_nodes = 0;
+    for( i = 0; i < n; i++ ) {
+        if( nodes[i] >= (int) (8*sizeof(numa_nodemask)) )
+            continue;
+        numa_nodemask |= 1UL << nodes[i];
+        if( nodes[i] >= numa_nodes )
+            numa_nodes = nodes[i]+1;
+
+        /* which cpus are on the node, for ia_numa_list_node */
+        snprintf( line, sizeof(line), "/sys/devices/system/node/node%d/cpulist", nodes[i] );
+        if( (fp = fopen( line, "r" )) == NULL )
+            continue;
+        c = fgets(line, sizeof(line), fp) != NULL ? ia_numa_parse_cpus( line, cpus, IA_NUMA_MAX_CPUS ) : 0;
+        fclose( fp );
+        for( j = 0; j < c; j++ )
+            if( cpus[j] >= 0 && cpus[j] < IA_NUMA_MAX_CPUS )
+                numa_cpu_node[cpus[j]] = nodes[i];
+    }
+}
+
+int ia_numa_parse_policy( const char* name )
+{
+    if( !strcmp(name, "none") )
+        return IA_NUMA_NONE;
+    if( !strcmp(name, "local") )
+        return IA_NUMA_LOCAL;
+    if( !strcmp(name, "interleave") )
+        return IA_NUMA_INTERLEAVE;
+    return -1;
+}
+
+/* mmap rounds to pages, huge pages have to be unmapped whole */
+static size_t ia_numa_map_size( size_t size )
+{
+    size_t page = size >= IA_HUGEPAGE_SIZE ? IA_HUGEPAGE_SIZE : (size_t) sysconf( _SC_PAGESIZE );
+    return (size + page-1) & ~(page-1);
+}
+
+/* fresh anonymous pages aligned to a huge page, so the kernel can back all of
+ * them with THP. the excess of the over sized mapping is given back. */
+static void* ia_numa_map_aligned( size_t size )
+{
+    size_t span = size + IA_HUGEPAGE_SIZE;
+    uint8_t* map = mmap( NULL, span, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0 );
+    uint8_t* ptr;
+
+    if( map == MAP_FAILED )
+        return NULL;
+
+    ptr = (uint8_t*) (((uintptr_t) map + IA_HUGEPAGE_SIZE-1) & ~(uintptr_t) (IA_HUGEPAGE_SIZE-1));
+    if( ptr > map )
+        munmap( map, ptr - map );
+    if( map + span > ptr + size )
+        munmap( ptr + size, map + span - (ptr + size) );
+#ifdef MADV_HUGEPAGE
+    madvise( ptr, size, MADV_HUGEPAGE );
+#endif
+    return ptr;
+}
+
+int ia_numa_list_node( const char* list, int index )
+{
+    int cpus[IA_NUMA_MAX_CPUS];
+    int n;
+
+    if( list == NULL || *list == '\0' || index < 0 )
+        return -1;
+    n = ia_numa_parse_cpus( list, cpus, IA_NUMA_MAX_CPUS );
+    if( n <= 0 || cpus[index % n] < 0 || cpus[index % n] >= IA_NUMA_MAX_CPUS )
+        return -1;
+    return numa_cpu_node[cpus[index % n]];
+}
+
+void* ia_numa_alloc( size_t size, bool* b_mapped )
+{
+    return ia_numa_alloc_node( size, -1, b_mapped );
+}
+
+void* ia_numa_alloc_node( size_t size, int node, bool* b_mapped )
+{
+    void* ptr = NULL;
+    size_t map_size;
+
+    *b_mapped = false;
+
+    /* heap buffers, large ones aligned to a huge page and marked for THP */
+    if( numa_policy == IA_NUMA_NONE && !numa_hugepages ) {
+        size_t align = size >= IA_HUGEPAGE_SIZE ? IA_HUGEPAGE_SIZE : IA_IMAGE_ALIGN;
+
+        if( posix_memalign(&ptr, align, size) )
+            return NULL;
+#ifdef MADV_HUGEPAGE
+        if( align == IA_HUGEPAGE_SIZE )
+            madvise( ptr, size, MADV_HUGEPAGE );
+#endif
+        return ptr;
+    }
+
+    map_size = ia_numa_map_size( size );
+#ifdef MAP_HUGETLB
+    if( numa_hugepages && size >= IA_HUGEPAGE_SIZE ) {
+        ptr = mmap( NULL, map_size, PROT_READ|PROT_WRITE,
+                    MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0 );
+        if( ptr == MAP_FAILED )
+            ptr = NULL;
+        else if( numa_count )
+            __sync_fetch_and_add( &numa_huge, 1 );
+    }
+#endif
+    if( ptr == NULL ) {
+        ptr = size >= IA_HUGEPAGE_SIZE ? ia_numa_map_aligned( map_size )
+                                       : mmap( NULL, map_size, PROT_READ|PROT_WRITE,
+                                               MAP_PRIVATE|MAP_ANONYMOUS, -1, 0 );
+        if( ptr == MAP_FAILED || ptr == NULL )
+            return NULL;
+    }
+
+#ifdef HAVE_LINUX_MEMPOLICY_H
+    /* nothing is touched yet, so the policy decides where every page goes */
+    if( numa_policy == IA_NUMA_INTERLEAVE && numa_nodes > 1 &&
+        syscall(SYS_mbind, ptr, map_size, MPOL_INTERLEAVE, &numa_nodemask,
+                8*sizeof(numa_nodemask)+1, 0) )
+        fprintf( stderr, "ERROR: ia_numa_alloc(): mbind: %s\n", ia_strerror(errno) );
+    /* preferred rather than bound, a full node spills over instead of failing */
+    if( numa_policy == IA_NUMA_LOCAL && numa_nodes > 1 && node >= 0 &&
+        node < (int) (8*sizeof(numa_nodemask)) ) {
+        unsigned long mask = 1UL << node;
+        if( syscall(SYS_mbind, ptr, map_size, MPOL_PREFERRED, &mask, 8*sizeof(mask)+1, 0) )
+            fprintf( stderr, "ERROR: ia_numa_alloc(): mbind: %s\n", ia_strerror(errno) );
+    }
+#else
+    node = node;
+#endif
+
+    *b_mapped = true;
+    return ptr;
+}
+
+/* adds the buffer to the counters of the nodes its sampled pages are on */
+static void ia_numa_count( void* ptr, size_t size )
+{
+    uint64_t share = size / IA_NUMA_SAMPLES;
+    int i;
+
+    if( size == 0 )
+        return;
+
+    __sync_fetch_and_add( &numa_buffers, 1 );
+    for( i = 0; i < IA_NUMA_SAMPLES; i++ ) {
+        int node = 0;
+#ifdef HAVE_LINUX_MEMPOLICY_H
+        void* page = (uint8_t*) ptr + (size / IA_NUMA_SAMPLES) * i;
+        if( syscall(SYS_get_mempolicy, &node, NULL, 0, page, MPOL_F_NODE|MPOL_F_ADDR) ||
+            node < 0 || node >= IA_NUMA_MAX_NODES )
+            node = 0;
+#else
+        ptr = ptr;
+#endif
+        __sync_fetch_and_add( &numa_bytes[node], share );
+    }
+}
+
+void ia_numa_free( void* ptr, size_t size, bool b_mapped )
+{
+    if( ptr == NULL )
+        return;
+    if( numa_count )
+        ia_numa_count( ptr, size );
+    if( b_mapped )
+        munmap( ptr, ia_numa_map_size(size) );
+    else
+        free( ptr );
+}
+
+int ia_numa_parse_cpus( const char* list, int* cpus, int max )
+{
+    const char* s = list;
+    int n = 0;
+
+    while( *s != '\0' && !isspace(*s) ) {
+        char* end;
+        long first, last, i;
+
+        first = last = strtol( s, &end, 10 );
+        if( end == s || first < 0 )
+            return -1;
+        s = end;
+        if( *s == '-' ) {
+            last = strtol( s+1, &end, 10 );
+            if( end == s+1 || last < first )
+                return -1;
+            s = end;
+        }
+        for( i = first; i <= last; i++ ) {
+            if( n == max )
+                return -1;
+            cpus[n++] = i;
+        }
+        if( *s == ',' )
+            s++;
+        else if( *s != '\0' && !isspace(*s) )
+            return -1;
+    }
+    return n;
+}
+
+int ia_numa_pin( const char* list, int index )
+{
+    int cpus[IA_NUMA_MAX_CPUS];
+    cpu_set_t set;
+    int i, n, rc;
+
+    if( list == NULL || *list == '\0' )
+        return 0;
+
+    n = ia_numa_parse_cpus( list, cpus, IA_NUMA_MAX_CPUS );
+    if( n <= 0 ) {
+        fprintf( stderr, "ERROR: ia_numa_pin(): bad cpu list %s\n", list );
+        return 1;
+    }
+
+    CPU_ZERO( &set );
+    if( index >= 0 )
+        CPU_SET( cpus[index % n], &set );
+    else
+        for( i = 0; i < n; i++ )
+            CPU_SET( cpus[i], &set );
+
+    if( 0 != (rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set)) ) {
+        fprintf( stderr, "ERROR: ia_numa_pin(): couldnt pin to %s: %s\n", list, ia_strerror(rc) );
+        return 1;
+    }
+    return 0;
+}
+
+void ia_numa_report( FILE* fp )
+{
+    uint64_t total = 0;
+    int i;
+
+    if( !numa_count )
+        return;
+
+    for( i = 0; i < IA_NUMA_MAX_NODES; i++ )
+        total += numa_bytes[i];
+
+    fprintf( fp, "frame buffers: %llu", (long long unsigned) numa_buffers );
+    if( numa_hugepages )
+        fprintf( fp, ", %llu on huge pages", (long long unsigned) numa_huge );
+    fprintf( fp, "\n" );
+
+    for( i = 0; i < IA_NUMA_MAX_NODES; i++ ) {
+        if( numa_bytes[i] == 0 && !(i < numa_nodes && (numa_nodemask >> i & 1)) )
+            continue;
+        fprintf( fp, "  node %d: %10.1f MB %5.1f%%\n", i,
+                 numa_bytes[i] / (1024.0*1024.0),
+                 total ? 100.0 * numa_bytes[i] / total : 0.0 );
+    }
+}
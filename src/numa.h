@@ -0,0 +1,53 @@
+#ifndef _H_NUMA
+#define _H_NUMA
+
+#include "common.h"
+
+/* where the pages of frame buffers come from. with IA_NUMA_NONE buffers come
+ * from the heap and may reuse pages freed by other threads, with the other
+ * policies every buffer gets fresh pages from mmap so it lands where the
+ * policy puts it. */
+#define IA_NUMA_NONE        0
+#define IA_NUMA_LOCAL       1   // first touch, the node of the thread that writes it first
+#define IA_NUMA_INTERLEAVE  2   // spread over all nodes, for refs every worker reads
+
+#define IA_NUMA_MAX_NODES   64
+#define IA_NUMA_MAX_CPUS    1024
+
+/* sets how ia_numa_alloc places buffers. b_hugepages asks for explicit 2MB
+ * pages (MAP_HUGETLB), falling back to transparent huge pages when the pool
+ * is empty. b_count keeps the per-node counters for ia_numa_report. must be
+ * called before any image is created. */
+void ia_numa_set_policy( int policy, bool b_hugepages, bool b_count );
+
+/* parses a policy name: none, local or interleave
+ * retval: the policy, -1 unknown name */
+int ia_numa_parse_policy( const char* name );
+
+/* allocates size bytes aligned to at least IA_IMAGE_ALIGN. *b_mapped is set
+ * when the buffer came from mmap and must be given back to ia_numa_free */
+void* ia_numa_alloc( size_t size, bool* b_mapped );
+
+/* as ia_numa_alloc, but with the local policy the pages are placed on node,
+ * whoever touches them first. node -1 is first touch */
+void* ia_numa_alloc_node( size_t size, int node, bool* b_mapped );
+void ia_numa_free( void* ptr, size_t size, bool b_mapped );
+
+/* parses a cpu list like "0-3,8,10-11" into cpus
+ * retval: number of cpus, -1 malformed list */
+int ia_numa_parse_cpus( const char* list, int* cpus, int max );
+
+/* pins the calling thread to the cpus in list. index >= 0 pins it to the
+ * index'th cpu of the list only (wrapping around), -1 to the whole list.
+ * an empty list leaves the thread alone.
+ * retval: 0 ok, 1 error */
+int ia_numa_pin( const char* list, int index );
+
+/* the node of the cpu ia_numa_pin( list, index ) pins to
+ * retval: the node, -1 for an empty list or an unknown node */
+int ia_numa_list_node( const char* list, int index );
+
+/* prints the bytes of frame buffers each node held to fp */
+void ia_numa_report( FILE* fp );
+
+#endif
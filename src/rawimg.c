@@ -0,0 +1,373 @@
+/* for preadv */
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+
+#include "rawimg.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+/* iovecs handed to one preadv/writev call, well below IOV_MAX */
+#define IA_RAWIMG_IOV 512
+
+/* bytes of the file looked at to find the header */
+#define IA_RAWIMG_HEADER_SIZE 512
+
+#define IA_RAWIMG_BMP_HEADER_SIZE 54
+
+typedef enum {
+    IA_RAWIMG_BMP,
+    IA_RAWIMG_PPM,
+    IA_RAWIMG_PGM,
+} ia_rawimg_type_t;
+
+typedef struct ia_rawimg_header_t {
+    ia_rawimg_type_t type;
+    int     i_width;
+    int     i_height;
+    bool    b_bottom_up;    // first row in the file is the bottom one
+    size_t  i_row_size;     // bytes of pixel data per row
+    size_t  i_row_pad;      // bytes after each row
+    off_t   i_offset;       // start of the pixel data
+} ia_rawimg_header_t;
+
+static inline uint32_t rd32( const uint8_t* p )
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static inline uint16_t rd16( const uint8_t* p )
+{
+    return p[0] | p[1] << 8;
+}
+
+static inline void wr32( uint8_t* p, uint32_t v )
+{
+    p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+
+static inline void wr16( uint8_t* p, uint16_t v )
+{
+    p[0] = v; p[1] = v >> 8;
+}
+
+/* reads one decimal number out of a pnm header, skipping whitespace and
+ * comments in front of it
+ * retval: the number, -1 if there is none */
+static int ia_rawimg_pnm_number( const uint8_t* buf, int size, int* pos )
+{
+    int v = 0, digits = 0;
+
+    while( *pos < size ) {
+        if( buf[*pos] == '#' )
+            while( *pos < size && buf[*pos] != '\n' )
+                (*pos)++;
+        else if( buf[*pos] == ' ' || buf[*pos] == '\t' || buf[*pos] == '\n' || buf[*pos] == '\r' )
+            (*pos)++;
+        else
+            break;
+    }
+    while( *pos < size && buf[*pos] >= '0' && buf[*pos] <= '9' && digits < 9 ) {
+        v = v * 10 + buf[*pos] - '0';
+        (*pos)++;
+        digits++;
+    }
+    return digits ? v : -1;
+}
+
+/* retval: 0 ok, 1 not a format handled here, -1 error */
+static int ia_rawimg_header( int fd, ia_rawimg_header_t* h )
+{
+    uint8_t buf[IA_RAWIMG_HEADER_SIZE];
+    int size = pread( fd, buf, sizeof(buf), 0 );
+
+    if( size < 0 )
+        return -1;
+    if( size < 2 )
+        return 1;
+
+    if( buf[0] == 'B' && buf[1] == 'M' ) {
+        int32_t height;
+
+        /* only BITMAPINFOHEADER and its successors, uncompressed 24 bit */
+        if( size < IA_RAWIMG_BMP_HEADER_SIZE || rd32(buf+14) < 40 ||
+            rd16(buf+26) != 1 || rd16(buf+28) != 24 || rd32(buf+30) != 0 )
+            return 1;
+
+        h->type = IA_RAWIMG_BMP;
+        h->i_width = (int32_t)rd32( buf+18 );
+        height = (int32_t)rd32( buf+22 );
+        h->b_bottom_up = height > 0;
+        h->i_height = height > 0 ? height : -height;
+        h->i_row_size = h->i_width * 3;
+        h->i_row_pad = (4 - h->i_row_size % 4) % 4;
+        h->i_offset = rd32( buf+10 );
+    }
+    else if( buf[0] == 'P' && (buf[1] == '6' || buf[1] == '5') ) {
+        int pos = 2, maxval;
+
+        h->type = buf[1] == '6' ? IA_RAWIMG_PPM : IA_RAWIMG_PGM;
+        h->i_width = ia_rawimg_pnm_number( buf, size, &pos );
+        h->i_height = ia_rawimg_pnm_number( buf, size, &pos );
+        maxval = ia_rawimg_pnm_number( buf, size, &pos );
+        /* 16 bit and scaled samples go through FreeImage */
+        if( maxval != 255 || pos >= size )
+            return 1;
+        h->b_bottom_up = false;
+        h->i_row_size = h->i_width * (h->type == IA_RAWIMG_PPM ? 3 : 1);
+        h->i_row_pad = 0;
+        h->i_offset = pos + 1;  // a single whitespace ends the header
+    }
+    else
+        return 1;
+
+    if( h->i_width <= 0 || h->i_height <= 0 )
+        return 1;
+    return 0;
+}
+
+/* reads the rows of the image at offset in the file straight into the rows
+ * of iaf, skip bytes into each image row
+ * retval: 0 ok, -1 error */
+static int ia_rawimg_read_rows( int fd, ia_rawimg_header_t* h, ia_image_t* iaf, size_t skip )
+{
+    struct iovec iov[IA_RAWIMG_IOV];
+    uint8_t padding[4];
+    off_t offset = h->i_offset;
+    int row = 0;
+
+    /* a bottom-up bmp whose row padding happens to match is the image */
+    if( h->b_bottom_up && iaf->b_bottom_up && !skip &&
+        iaf->i_pitch == h->i_row_size + h->i_row_pad ) {
+        size_t size = iaf->i_pitch * h->i_height;
+        return pread( fd, iaf->pix, size, offset ) == (ssize_t)size ? 0 : -1;
+    }
+
+    while( row < h->i_height ) {
+        size_t total = 0;
+        int n = 0;
+
+        for( ; row < h->i_height && n + 2 <= IA_RAWIMG_IOV; row++ ) {
+            int y = h->b_bottom_up ? h->i_height - row - 1 : row;
+
+            iov[n].iov_base = ia_image_row( iaf, y ) + skip;
+            iov[n].iov_len = h->i_row_size;
+            total += iov[n++].iov_len;
+            if( h->i_row_pad ) {
+                iov[n].iov_base = padding;
+                iov[n].iov_len = h->i_row_pad;
+                total += iov[n++].iov_len;
+            }
+        }
+        if( preadv(fd, iov, n, offset) != (ssize_t)total )
+            return -1;
+        offset += total;
+    }
+    return 0;
+}
+
+int ia_rawimg_probe( const char* file, int* width, int* height )
+{
+    ia_rawimg_header_t h;
+    int fd, ret;
+
+    if( (fd = ia_open(file, O_RDONLY)) < 0 ) {
+        fprintf( stderr, "ERROR: ia_rawimg_probe(): couldnt open %s: %s\n", file, ia_strerror(errno) );
+        return -1;
+    }
+    ret = ia_rawimg_header( fd, &h );
+    close( fd );
+
+    if( ret == 0 ) {
+        *width = h.i_width;
+        *height = h.i_height;
+    }
+    return ret;
+}
+
+int ia_rawimg_read( const char* file, ia_image_t* iaf, int width, int height )
+{
+    ia_rawimg_header_t h;
+    int fd, ret, x, y;
+
+    if( (fd = ia_open(file, O_RDONLY)) < 0 ) {
+        fprintf( stderr, "ERROR: ia_rawimg_read(): couldnt open %s: %s\n", file, ia_strerror(errno) );
+        return -1;
+    }
+
+    ret = ia_rawimg_header( fd, &h );
+    if( ret == 0 && (h.i_width != width || h.i_height != height) )
+        ret = 1;
+    if( ret ) {
+        close( fd );
+        return ret;
+    }
+
+    /* gray rows land in the last third of the image row and are spread out
+     * from the left, so nothing is overwritten before it is read */
+    ret = ia_rawimg_read_rows( fd, &h, iaf, h.type == IA_RAWIMG_PGM ? 2 * width : 0 );
+    close( fd );
+    if( ret ) {
+        fprintf( stderr, "ERROR: ia_rawimg_read(): %s is truncated\n", file );
+        return -1;
+    }
+
+    if( h.type == IA_RAWIMG_PPM ) {
+        for( y = 0; y < height; y++ ) {
+            ia_pixel_t* p = iaf->pix + y * iaf->i_pitch;
+            for( x = 0; x < width; x++, p += 3 ) {
+                ia_pixel_t t = p[0];
+                p[0] = p[2];
+                p[2] = t;
+            }
+        }
+    }
+    else if( h.type == IA_RAWIMG_PGM ) {
+        for( y = 0; y < height; y++ ) {
+            ia_pixel_t* p = iaf->pix + y * iaf->i_pitch;
+            const ia_pixel_t* g = p + 2 * width;
+            for( x = 0; x < width; x++ ) {
+                ia_pixel_t v = g[x];
+                p[3*x+0] = p[3*x+1] = p[3*x+2] = v;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/* retval: 0 ok, -1 error */
+static int ia_rawimg_writev( int fd, struct iovec* iov, int n )
+{
+    size_t total = 0;
+    int i;
+
+    for( i = 0; i < n; i++ )
+        total += iov[i].iov_len;
+    return writev( fd, iov, n ) == (ssize_t)total ? 0 : -1;
+}
+
+static int ia_rawimg_write_bmp( int fd, ia_image_t* iar, int width, int height )
+{
+    uint8_t hdr[IA_RAWIMG_BMP_HEADER_SIZE] = { 'B', 'M' };
+    uint8_t padding[4] = { 0 };
+    struct iovec iov[IA_RAWIMG_IOV];
+    size_t pitch = (width * 3 + 3) & ~3;
+    int row = 0, n;
+
+    wr32( hdr+2, IA_RAWIMG_BMP_HEADER_SIZE + pitch * height );
+    wr32( hdr+10, IA_RAWIMG_BMP_HEADER_SIZE );
+    wr32( hdr+14, 40 );
+    wr32( hdr+18, width );
+    wr32( hdr+22, height );
+    wr16( hdr+26, 1 );
+    wr16( hdr+28, 24 );
+    wr32( hdr+34, pitch * height );
+    wr32( hdr+38, 2835 );   // 72 dpi
+    wr32( hdr+42, 2835 );
+
+    iov[0].iov_base = hdr;
+    iov[0].iov_len = sizeof(hdr);
+
+    if( iar->b_bottom_up && iar->i_pitch == pitch ) {
+        iov[1].iov_base = iar->pix;
+        iov[1].iov_len = pitch * height;
+        return ia_rawimg_writev( fd, iov, 2 );
+    }
+
+    n = 1;
+    while( row < height ) {
+        for( ; row < height && n + 2 <= IA_RAWIMG_IOV; row++ ) {
+            iov[n].iov_base = ia_image_row( iar, height - row - 1 );
+            iov[n++].iov_len = width * 3;
+            if( pitch != (size_t)width * 3 ) {
+                iov[n].iov_base = padding;
+                iov[n++].iov_len = pitch - width * 3;
+            }
+        }
+        if( ia_rawimg_writev(fd, iov, n) )
+            return -1;
+        n = 0;
+    }
+    return 0;
+}
+
+static int ia_rawimg_write_pnm( int fd, ia_image_t* iar, int width, int height, bool b_gray )
+{
+    char hdr[64];
+    struct iovec iov[2];
+    size_t row_size = width * (b_gray ? 1 : 3);
+    uint8_t* buf = ia_malloc( row_size * height );
+    uint8_t* d = buf;
+    int x, y, ret;
+
+    if( buf == NULL )
+        return -1;
+
+    /* pnm is top-down RGB, so the rows are turned around into buf once and
+     * written in one go */
+    for( y = 0; y < height; y++ ) {
+        const ia_pixel_t* p = ia_image_row( iar, y );
+        if( b_gray ) {
+            for( x = 0; x < width; x++, p += 3 )
+                *d++ = (29 * p[0] + 150 * p[1] + 77 * p[2] + 128) >> 8;
+        } else {
+            for( x = 0; x < width; x++, p += 3 ) {
+                *d++ = p[2];
+                *d++ = p[1];
+                *d++ = p[0];
+            }
+        }
+    }
+
+    iov[0].iov_base = hdr;
+    iov[0].iov_len = snprintf( hdr, sizeof(hdr), "P%c\n%d %d\n255\n", b_gray ? '5' : '6', width, height );
+    iov[1].iov_base = buf;
+    iov[1].iov_len = row_size * height;
+    ret = ia_rawimg_writev( fd, iov, 2 );
+
+    ia_free( buf );
+    return ret;
+}
+
+int ia_rawimg_write( const char* file, ia_image_t* iar, int width, int height )
+{
+    const char* ext = ia_strrchr( file, '.' );
+    ia_rawimg_type_t type;
+    int fd, ret;
+
+    if( ext == NULL )
+        return 1;
+    if( !strcasecmp(ext+1, "bmp") )
+        type = IA_RAWIMG_BMP;
+    else if( !strcasecmp(ext+1, "ppm") )
+        type = IA_RAWIMG_PPM;
+    else if( !strcasecmp(ext+1, "pgm") )
+        type = IA_RAWIMG_PGM;
+    else
+        return 1;
+
+    if( (fd = ia_open(file, O_WRONLY|O_CREAT|O_TRUNC, 0644)) < 0 ) {
+        fprintf( stderr, "ERROR: ia_rawimg_write(): couldnt open %s: %s\n", file, ia_strerror(errno) );
+        return -1;
+    }
+
+    if( type == IA_RAWIMG_BMP )
+        ret = ia_rawimg_write_bmp( fd, iar, width, height );
+    else
+        ret = ia_rawimg_write_pnm( fd, iar, width, height, type == IA_RAWIMG_PGM );
+
+    if( close(fd) || ret ) {
+        fprintf( stderr, "ERROR: ia_rawimg_write(): couldnt write %s: %s\n", file, ia_strerror(errno) );
+        return -1;
+    }
+    return 0;
+}
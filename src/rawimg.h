@@ -0,0 +1,26 @@
+#ifndef _H_RAWIMG
+#define _H_RAWIMG
+
+#include "common.h"
+
+/* readers and writers for the uncompressed formats ia is mostly fed with:
+ * 24 bit BMP, binary PPM (P6) and binary PGM (P5), all with 8 bit samples.
+ * only the header is parsed, pixel rows go between the file and the image
+ * buffer with preadv/writev. anything else is left to FreeImage, which the
+ * return value of 1 asks for. */
+
+/* reads the size of the image in file without loading it
+ * retval: 0 ok, 1 not a format handled here, -1 error */
+int ia_rawimg_probe( const char* file, int* width, int* height );
+
+/* loads file into iaf, which holds a width x height image. files of any
+ * other size are left to FreeImage.
+ * retval: 0 ok, 1 not a format handled here, -1 error */
+int ia_rawimg_read( const char* file, ia_image_t* iaf, int width, int height );
+
+/* saves the width x height image iar to file, the format is taken from the
+ * extension of file
+ * retval: 0 ok, 1 not a format handled here, -1 error */
+int ia_rawimg_write( const char* file, ia_image_t* iar, int width, int height );
+
+#endif
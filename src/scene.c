@@ -0,0 +1,127 @@
+#include "scene.h"
+
+ia_scene_t* ia_scene_open( const ia_param_t* p )
+{
+    ia_scene_t* sc = ia_calloc( 1, sizeof(ia_scene_t) );
+
+    if( sc == NULL )
+        return NULL;
+    sc->f_sigmas = p->SceneSettings.Threshold;
+    sc->f_min = p->SceneSettings.MinDist;
+    sc->i_first = p->i_maxrefs - 1;
+
+    if( p->SceneSettings.ListFile[0] ) {
+        if( !strcmp(p->SceneSettings.ListFile, "-") )
+            sc->list = stdout;
+        else if( (sc->list = fopen( p->SceneSettings.ListFile, "w" )) == NULL )
+            fprintf( stderr, "ERROR: ia_scene_open(): couldnt open cut list %s\n",
+                     p->SceneSettings.ListFile );
+        if( sc->list )
+            fprintf( sc->list, "# frame distance\n" );
+    }
+
+    pthread_mutex_init( &sc->mutex, NULL );
+    ia_pthread_cond_init( &sc->cond, NULL );
+    return sc;
+}
+
+static void ia_scene_hist( uint32_t* hist, ia_image_t* iaf )
+{
+    const int shift = 8 - IA_SCENE_BITS;
+    int x, y;
+
+    memset( hist, 0, IA_SCENE_BINS * sizeof(uint32_t) );
+    for( y = 0; y < iaf->i_height; y += IA_SCENE_STEP )
+    {
+        const ia_pixel_t* p = iaf->pix + (size_t)y * iaf->i_pitch;
+
+        for( x = 0; x < iaf->i_width; x += IA_SCENE_STEP, p += 3*IA_SCENE_STEP )
+            hist[(p[0] >> shift) << 2*IA_SCENE_BITS |
+                 (p[1] >> shift) << IA_SCENE_BITS | (p[2] >> shift)]++;
+    }
+}
+
+/* retval: the threshold a distance has to be above to be a cut */
+static double ia_scene_threshold( ia_scene_t* sc )
+{
+    const int n = sc->i_history < IA_SCENE_HISTORY ? (int) sc->i_history : IA_SCENE_HISTORY;
+    double mean = 0, var = 0;
+    int i;
+
+    if( n < IA_SCENE_MIN_HISTORY )
+        return sc->f_min > IA_SCENE_START_DIST ? sc->f_min : IA_SCENE_START_DIST;
+
+    for( i = 0; i < n; i++ )
+        mean += sc->history[i];
+    mean /= n;
+    for( i = 0; i < n; i++ )
+        var += (sc->history[i] - mean) * (sc->history[i] - mean);
+    var /= n;
+
+    mean += sc->f_sigmas * sqrt( var );
+    return mean > sc->f_min ? mean : sc->f_min;
+}
+
+bool ia_scene_frame( ia_scene_t* sc, ia_image_t* iaf )
+{
+    uint32_t* hist = ia_malloc( IA_SCENE_BINS * sizeof(uint32_t) );
+    bool b_cut = false;
+    int i, rc;
+
+    if( hist != NULL )
+        ia_scene_hist( hist, iaf );
+    else
+        fprintf( stderr, "ERROR: ia_scene_frame(): couldnt alloc histogram of frame %llu\n",
+                 (long long unsigned) iaf->i_frame );
+
+    if( 0 != (rc = ia_pthread_mutex_lock( &sc->mutex )) )
+        ia_pthread_error( rc, "ia_scene_frame()", "ia_pthread_mutex_lock()" );
+    while( sc->i_turn != iaf->i_frame ) {
+        if( 0 != (rc = ia_pthread_cond_wait( &sc->cond, &sc->mutex )) )
+            ia_pthread_error( rc, "ia_scene_frame()", "ia_pthread_cond_wait()" );
+    }
+
+    /* a frame without a histogram, or after one, is taken as the same scene */
+    if( hist != NULL && sc->prev != NULL ) {
+        uint64_t diff = 0, total = 0;
+        double dist;
+
+        for( i = 0; i < IA_SCENE_BINS; i++ ) {
+            diff += hist[i] > sc->prev[i] ? hist[i] - sc->prev[i] : sc->prev[i] - hist[i];
+            total += hist[i];
+        }
+        dist = total ? diff / (2.0 * total) : 0;
+
+        if( dist > ia_scene_threshold( sc ) ) {
+            b_cut = true;
+            sc->i_cuts++;
+            if( sc->list )
+                fprintf( sc->list, "%llu %.4f\n", (long long unsigned) iaf->i_frame, dist );
+        } else
+            sc->history[sc->i_history++ % IA_SCENE_HISTORY] = dist;
+    }
+    ia_free( sc->prev );
+    sc->prev = hist;
+
+    sc->i_turn++;
+    if( 0 != (rc = ia_pthread_cond_broadcast( &sc->cond )) )
+        ia_pthread_error( rc, "ia_scene_frame()", "ia_pthread_cond_broadcast()" );
+    if( 0 != (rc = ia_pthread_mutex_unlock( &sc->mutex )) )
+        ia_pthread_error( rc, "ia_scene_frame()", "ia_pthread_mutex_unlock()" );
+
+    return b_cut || iaf->i_frame == sc->i_first;
+}
+
+void ia_scene_close( ia_scene_t* sc )
+{
+    if( sc == NULL )
+        return;
+    if( sc->list && sc->list != stdout )
+        fclose( sc->list );
+    else if( sc->list )
+        fflush( sc->list );
+    ia_free( sc->prev );
+    pthread_mutex_destroy( &sc->mutex );
+    pthread_cond_destroy( &sc->cond );
+    ia_free( sc );
+}
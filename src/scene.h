@@ -0,0 +1,50 @@
+#ifndef _H_SCENE
+#define _H_SCENE
+
+#include "common.h"
+#include "image_analyzer.h"
+
+/* colour histograms have this many bits of each of b, g and r */
+#define IA_SCENE_BITS           3
+#define IA_SCENE_BINS           (1 << 3*IA_SCENE_BITS)
+#define IA_SCENE_STEP           2   // every second pixel of every second row
+
+/* the threshold follows the distances of the last IA_SCENE_HISTORY frames
+ * that werent cuts. until IA_SCENE_MIN_HISTORY of them are in it is fixed. */
+#define IA_SCENE_HISTORY        32
+#define IA_SCENE_MIN_HISTORY    4
+#define IA_SCENE_START_DIST     0.5
+
+/* scene cut detection on the input. a frame is a cut when the l1 distance
+ * of its coarse colour histogram to that of the frame before it, 0 for the
+ * same colours and 1 for none in common, is above both a floor and the mean
+ * of the recent distances plus some standard deviations of them. histograms
+ * are built without waiting, the decisions are taken in frame order. */
+typedef struct ia_scene_t
+{
+    double      f_sigmas;       // standard deviations above the mean a cut needs
+    double      f_min;          // and the distance it needs at least
+    uint64_t    i_first;        // first frame that has an output
+    uint64_t    i_turn;         // next frame allowed to decide
+    uint64_t    i_cuts;
+    uint32_t*   prev;           // histogram of the previous frame
+    double      history[IA_SCENE_HISTORY];
+    uint64_t    i_history;      // distances pushed so far
+    FILE*       list;           // cuts are written here if not NULL
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;
+} ia_scene_t;
+
+/* retval: the detector set up from p->SceneSettings, NULL if it couldnt be
+ * allocated */
+ia_scene_t* ia_scene_open( const ia_param_t* p );
+
+/* looks at iaf, frames have to come in consecutively from 0 and a call
+ * waits until the previous frame has been looked at.
+ * retval: true if iaf starts a scene: it is a cut or the first frame with an
+ * output */
+bool ia_scene_frame( ia_scene_t* sc, ia_image_t* iaf );
+
+void ia_scene_close( ia_scene_t* sc );
+
+#endif
@@ -0,0 +1,382 @@
+#include "stabilize.h"
+
+#include <limits.h>
+
+static const ia_affine_t ia_affine_identity = { 1, 0, 0, 0, 1, 0 };
+
+ia_stab_t* ia_stab_open( int window )
+{
+    ia_stab_t* st = ia_calloc( 1, sizeof(ia_stab_t) );
+
+    if( st == NULL )
+        return NULL;
+    st->i_window = window > 0 ? window : 1;
+    if( (st->ring = ia_malloc( st->i_window * sizeof(ia_affine_t) )) == NULL ) {
+        ia_free( st );
+        return NULL;
+    }
+    memcpy( st->traj, ia_affine_identity, sizeof(ia_affine_t) );
+    pthread_mutex_init( &st->mutex, NULL );
+    ia_pthread_cond_init( &st->cond, NULL );
+    return st;
+}
+
+/* r = a(b(x)) */
+static void ia_affine_mul( ia_affine_t r, const ia_affine_t a, const ia_affine_t b )
+{
+    ia_affine_t t;
+
+    t[0] = a[0]*b[0] + a[1]*b[3];
+    t[1] = a[0]*b[1] + a[1]*b[4];
+    t[2] = a[0]*b[2] + a[1]*b[5] + a[2];
+    t[3] = a[3]*b[0] + a[4]*b[3];
+    t[4] = a[3]*b[1] + a[4]*b[4];
+    t[5] = a[3]*b[2] + a[4]*b[5] + a[5];
+    memcpy( r, t, sizeof(ia_affine_t) );
+}
+
+/* retval: 0 ok, 1 a is singular */
+static int ia_affine_inv( ia_affine_t r, const ia_affine_t a )
+{
+    const double det = a[0]*a[4] - a[1]*a[3];
+
+    if( fabs( det ) < 1e-9 )
+        return 1;
+    r[0] =  a[4] / det;
+    r[1] = -a[1] / det;
+    r[3] = -a[3] / det;
+    r[4] =  a[0] / det;
+    r[2] = -(r[0]*a[2] + r[1]*a[5]);
+    r[5] = -(r[3]*a[2] + r[4]*a[5]);
+    return 0;
+}
+
+/* solves m * v = b for a symmetric or general 3x3 m by cramer's rule.
+ * retval: 0 ok, 1 singular */
+static int ia_solve3( const double m[9], const double b[3], double* v )
+{
+    const double det = m[0]*(m[4]*m[8] - m[5]*m[7]) - m[1]*(m[3]*m[8] - m[5]*m[6])
+                     + m[2]*(m[3]*m[7] - m[4]*m[6]);
+    int i;
+
+    if( fabs( det ) < 1e-9 )
+        return 1;
+    for( i = 0; i < 3; i++ ) {
+        double t[9];
+        memcpy( t, m, sizeof(t) );
+        t[i] = b[0];
+        t[3+i] = b[1];
+        t[6+i] = b[2];
+        v[i] = (t[0]*(t[4]*t[8] - t[5]*t[7]) - t[1]*(t[3]*t[8] - t[5]*t[6])
+             + t[2]*(t[3]*t[7] - t[4]*t[6])) / det;
+    }
+    return 0;
+}
+
+/* least squares affine taking the points (qx,qy) of idx to (kx,ky)
+ * retval: 0 ok, 1 degenerate */
+static int ia_affine_fit( ia_affine_t r, const float* q, const float* k, const int* idx, int n )
+{
+    double m[9] = { 0 }, bx[3] = { 0 }, by[3] = { 0 };
+    int i;
+
+    for( i = 0; i < n; i++ ) {
+        const double v[3] = { q[2*idx[i]], q[2*idx[i]+1], 1 };
+        int a, b;
+        for( a = 0; a < 3; a++ ) {
+            for( b = 0; b < 3; b++ )
+                m[3*a+b] += v[a] * v[b];
+            bx[a] += v[a] * k[2*idx[i]];
+            by[a] += v[a] * k[2*idx[i]+1];
+        }
+    }
+    return ia_solve3( m, bx, r ) || ia_solve3( m, by, r+3 );
+}
+
+static int ia_affine_inliers( const ia_affine_t a, const float* q, const float* k, int n, int* idx )
+{
+    const double tol = IA_STAB_INLIER_DIST * IA_STAB_INLIER_DIST;
+    int i, c = 0;
+
+    for( i = 0; i < n; i++ ) {
+        const double dx = a[0]*q[2*i] + a[1]*q[2*i+1] + a[2] - k[2*i];
+        const double dy = a[3]*q[2*i] + a[4]*q[2*i+1] + a[5] - k[2*i+1];
+        if( dx*dx + dy*dy < tol ) {
+            if( idx )
+                idx[c] = i;
+            c++;
+        }
+    }
+    return c;
+}
+
+/* the affine taking most of the points q to their k within the inlier
+ * distance, fitted again to all of those. the samples come from a generator
+ * seeded with the frame so runs are repeatable.
+ * retval: 0 ok, 1 no motion found */
+static int ia_affine_ransac( ia_affine_t r, const float* q, const float* k, int n,
+                             int* idx, uint64_t seed )
+{
+    uint32_t rnd = seed * 2654435761u + 1;
+    ia_affine_t a;
+    int it, best = 0;
+
+    if( n < 3 )
+        return 1;
+
+    for( it = 0; it < IA_STAB_RANSAC_ITERS; it++ )
+    {
+        int s[3], i, c;
+
+        for( i = 0; i < 3; i++ ) {
+            rnd = rnd * 1664525u + 1013904223u;
+            s[i] = (rnd >> 8) % n;
+        }
+        if( s[0] == s[1] || s[0] == s[2] || s[1] == s[2] || ia_affine_fit( a, q, k, s, 3 ) )
+            continue;
+        if( (c = ia_affine_inliers( a, q, k, n, NULL )) > best ) {
+            best = c;
+            memcpy( r, a, sizeof(ia_affine_t) );
+        }
+    }
+    if( best < IA_STAB_MIN_INLIERS )
+        return 1;
+
+    ia_affine_inliers( r, q, k, n, idx );
+    return ia_affine_fit( r, q, k, idx, best );
+}
+
+/* sad of the patches centred on (px,py) of p and (cx,cy) of c */
+static inline int ia_stab_sad( const ia_cache_entry_t* p, int px, int py,
+                               const ia_cache_entry_t* c, int cx, int cy )
+{
+    const uint8_t* a = (uint8_t*) p->data + (py - IA_STAB_PATCH) * p->i_stride + px - IA_STAB_PATCH;
+    const uint8_t* b = (uint8_t*) c->data + (cy - IA_STAB_PATCH) * c->i_stride + cx - IA_STAB_PATCH;
+    int x, y, sad = 0;
+
+    for( y = 0; y < 2*IA_STAB_PATCH+1; y++ )
+        for( x = 0; x < 2*IA_STAB_PATCH+1; x++ )
+            sad += abs( a[y * p->i_stride + x] - b[y * c->i_stride + x] );
+    return sad;
+}
+
+static inline bool ia_stab_inside( const ia_cache_entry_t* e, int x, int y )
+{
+    return x >= IA_STAB_PATCH && y >= IA_STAB_PATCH &&
+           x < e->i_width - IA_STAB_PATCH && y < e->i_height - IA_STAB_PATCH;
+}
+
+/* moves (cx,cy) to the best match within range of the patch at (px,py)
+ * retval: 0 found, 1 the patches dont fit */
+static int ia_stab_search( const ia_cache_entry_t* p, int px, int py,
+                           const ia_cache_entry_t* c, int* cx, int* cy, int range )
+{
+    int best = INT_MAX, bx = 0, by = 0;
+    int dx, dy;
+
+    if( !ia_stab_inside( p, px, py ) )
+        return 1;
+    for( dy = -range; dy <= range; dy++ ) {
+        for( dx = -range; dx <= range; dx++ ) {
+            int sad;
+            if( !ia_stab_inside( c, *cx + dx, *cy + dy ) )
+                continue;
+            /* ties go to the smaller move */
+            sad = ia_stab_sad( p, px, py, c, *cx + dx, *cy + dy );
+            if( sad < best || (sad == best && abs(dx) + abs(dy) < abs(bx) + abs(by)) ) {
+                best = sad;
+                bx = dx;
+                by = dy;
+            }
+        }
+    }
+    if( best == INT_MAX )
+        return 1;
+    *cx += bx;
+    *cy += by;
+    return 0;
+}
+
+/* motion of the frame with levels cur relative to the previous one, taking
+ * a point of the current frame to the previous one */
+static void ia_stab_estimate( ia_stab_t* st, ia_cache_entry_t** cur, ia_affine_t m, uint64_t seed )
+{
+    const int n = st->kp.i_kp;
+    float* q = ia_malloc( 4 * n * sizeof(float) + n * sizeof(int) + 1 );
+    float* k = q + 2*n;
+    int* idx = (int*) (q + 4*n);
+    int i, c = 0;
+
+    memcpy( m, ia_affine_identity, sizeof(ia_affine_t) );
+    if( q == NULL )
+        return;
+
+    for( i = 0; i < n; i++ )
+    {
+        const int x = st->kp.kp[i].x;
+        const int y = st->kp.kp[i].y;
+        int x4 = x >> 2, y4 = y >> 2;
+        int x2, y2, x1, y1;
+
+        if( ia_stab_search( st->prev[2], x >> 2, y >> 2, cur[2], &x4, &y4, IA_STAB_RANGE ) )
+            continue;
+        x2 = (x >> 1) + 2 * (x4 - (x >> 2));
+        y2 = (y >> 1) + 2 * (y4 - (y >> 2));
+        if( ia_stab_search( st->prev[1], x >> 1, y >> 1, cur[1], &x2, &y2, 2 ) )
+            continue;
+        x1 = x + 2 * (x2 - (x >> 1));
+        y1 = y + 2 * (y2 - (y >> 1));
+        if( ia_stab_search( st->prev[0], x, y, cur[0], &x1, &y1, 2 ) )
+            continue;
+        q[2*c] = x1;
+        q[2*c+1] = y1;
+        k[2*c] = x;
+        k[2*c+1] = y;
+        c++;
+    }
+
+    if( ia_affine_ransac( m, q, k, c, idx, seed ) )
+        memcpy( m, ia_affine_identity, sizeof(ia_affine_t) );
+    ia_free( q );
+}
+
+/* bilinear in 8 bit fixed point, samples off the frame are taken from its
+ * nearest edge. the source position moves by a constant step along a row. */
+static void ia_stab_warp( const ia_affine_t a, const ia_pixel_t* src, ia_image_t* iaf )
+{
+    const int w = iaf->i_width;
+    const int h = iaf->i_height;
+    const size_t pitch = iaf->i_pitch;
+    const int32_t dx = lrint( a[0] * 65536 );
+    const int32_t dy = lrint( a[3] * 65536 );
+    int x, y, c;
+
+    for( y = 0; y < h; y++ )
+    {
+        ia_pixel_t* d = iaf->pix + y * pitch;
+        int32_t sx = lrint( (a[1]*y + a[2]) * 65536 );
+        int32_t sy = lrint( (a[4]*y + a[5]) * 65536 );
+
+        for( x = 0; x < w; x++, sx += dx, sy += dy )
+        {
+            const int u = sx >> 16;
+            const int v = sy >> 16;
+            const int fx = (sx >> 8) & 255;
+            const int fy = (sy >> 8) & 255;
+
+            if( (unsigned) u < (unsigned) w-1 && (unsigned) v < (unsigned) h-1 ) {
+                const ia_pixel_t* p = src + v * pitch + 3*u;
+                for( c = 0; c < 3; c++ ) {
+                    const int t = p[c] * (256-fx) + p[c+3] * fx;
+                    const int b = p[c+pitch] * (256-fx) + p[c+pitch+3] * fx;
+                    d[3*x+c] = (t * (256-fy) + b * fy + 32768) >> 16;
+                }
+            } else {
+                const int u0 = u < 0 ? 0 : u > w-1 ? w-1 : u;
+                const int v0 = v < 0 ? 0 : v > h-1 ? h-1 : v;
+                const int u1 = u+1 < 0 ? 0 : u+1 > w-1 ? w-1 : u+1;
+                const int v1 = v+1 < 0 ? 0 : v+1 > h-1 ? h-1 : v+1;
+                for( c = 0; c < 3; c++ ) {
+                    const int t = src[v0*pitch + 3*u0+c] * (256-fx) + src[v0*pitch + 3*u1+c] * fx;
+                    const int b = src[v1*pitch + 3*u0+c] * (256-fx) + src[v1*pitch + 3*u1+c] * fx;
+                    d[3*x+c] = (t * (256-fy) + b * fy + 32768) >> 16;
+                }
+            }
+        }
+    }
+}
+
+int ia_stab_frame( ia_stab_t* st, ia_image_t* iaf )
+{
+    static const ia_cache_kind_t kinds[3] = { IA_CACHE_LUMA, IA_CACHE_PYR2, IA_CACHE_PYR4 };
+    ia_cache_entry_t* cur[3];
+    ia_keypoints_t kp;
+    ia_affine_t m, s, a;
+    ia_pixel_t* src;
+    bool b_fail = false;
+    int i, j, rc;
+    uint64_t n;
+
+    /* everything only depending on this frame is done before waiting */
+    memset( &kp, 0, sizeof(ia_keypoints_t) );
+    for( i = 0; i < 3; i++ )
+        b_fail |= (cur[i] = ia_cache_get( iaf, kinds[i] )) == NULL;
+    b_fail |= ia_keypoints_detect( &kp, iaf, IA_KEYPOINTS_FAST, IA_STAB_FAST_THRESHOLD,
+                                   (iaf->i_width + IA_STAB_GRID-1) / IA_STAB_GRID,
+                                   (iaf->i_height + IA_STAB_GRID-1) / IA_STAB_GRID,
+                                   IA_STAB_PER_CELL );
+
+    if( 0 != (rc = ia_pthread_mutex_lock( &st->mutex )) )
+        ia_pthread_error( rc, "ia_stab_frame()", "ia_pthread_mutex_lock()" );
+    while( st->i_turn != iaf->i_frame ) {
+        if( 0 != (rc = ia_pthread_cond_wait( &st->cond, &st->mutex )) )
+            ia_pthread_error( rc, "ia_stab_frame()", "ia_pthread_cond_wait()" );
+    }
+
+    /* a frame that couldnt be looked at is taken as not moving */
+    if( !b_fail && st->prev[0] != NULL )
+        ia_stab_estimate( st, cur, m, iaf->i_frame );
+    else
+        memcpy( m, ia_affine_identity, sizeof(ia_affine_t) );
+    ia_affine_mul( st->traj, st->traj, m );
+
+    memcpy( st->ring[st->i_ring % st->i_window], st->traj, sizeof(ia_affine_t) );
+    st->i_ring++;
+    n = st->i_ring < (uint64_t) st->i_window ? st->i_ring : (uint64_t) st->i_window;
+    memset( s, 0, sizeof(ia_affine_t) );
+    for( i = 0; i < (int) n; i++ )
+        for( j = 0; j < 6; j++ )
+            s[j] += st->ring[i][j] / n;
+
+    /* output pixel -> smoothed camera -> first frame -> this frame */
+    if( ia_affine_inv( a, st->traj ) )
+        memcpy( a, ia_affine_identity, sizeof(ia_affine_t) );
+    ia_affine_mul( a, a, s );
+
+    for( i = 0; i < 3; i++ ) {
+        ia_cache_release( st->prev[i] );
+        st->prev[i] = b_fail ? NULL : cur[i];
+    }
+    ia_keypoints_free( &st->kp );
+    st->kp = kp;
+
+    st->i_turn++;
+    if( 0 != (rc = ia_pthread_cond_broadcast( &st->cond )) )
+        ia_pthread_error( rc, "ia_stab_frame()", "ia_pthread_cond_broadcast()" );
+    if( 0 != (rc = ia_pthread_mutex_unlock( &st->mutex )) )
+        ia_pthread_error( rc, "ia_stab_frame()", "ia_pthread_mutex_unlock()" );
+
+    if( b_fail ) {
+        for( i = 0; i < 3; i++ )
+            ia_cache_release( cur[i] );
+        return 1;
+    }
+
+    /* nothing to do for a still camera */
+    for( i = 0; i < 6 && fabs( a[i] - ia_affine_identity[i] ) < 1.0 / 1024; i++ );
+    if( i == 6 )
+        return 0;
+
+    if( (src = ia_malloc( iaf->i_pitch * iaf->i_height )) == NULL )
+        return 1;
+    memcpy( src, iaf->pix, iaf->i_pitch * iaf->i_height );
+    ia_stab_warp( a, src, iaf );
+    ia_cache_flush( iaf );
+    ia_free( src );
+    return 0;
+}
+
+void ia_stab_close( ia_stab_t* st )
+{
+    int i;
+
+    if( st == NULL )
+        return;
+    for( i = 0; i < 3; i++ )
+        ia_cache_release( st->prev[i] );
+    ia_keypoints_free( &st->kp );
+    ia_free( st->ring );
+    pthread_mutex_destroy( &st->mutex );
+    pthread_cond_destroy( &st->cond );
+    ia_free( st );
+}
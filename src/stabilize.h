@@ -0,0 +1,56 @@
+#ifndef _H_STABILIZE
+#define _H_STABILIZE
+
+#include "common.h"
+#include "cache.h"
+#include "keypoints.h"
+
+struct ia_seq_t;
+
+/* keypoints tracked from frame to frame, found on a grid of this many cells
+ * a side so they cover the frame whatever its size */
+#define IA_STAB_GRID            8
+#define IA_STAB_PER_CELL        4
+#define IA_STAB_FAST_THRESHOLD  10
+
+#define IA_STAB_PATCH           3   // matched patches are 2*3+1 samples square
+#define IA_STAB_RANGE           8   // search radius on the 4x pyramid, 32 pixels
+#define IA_STAB_RANSAC_ITERS    256
+#define IA_STAB_INLIER_DIST     1.5 // pixels
+#define IA_STAB_MIN_INLIERS     6   // fewer and the frame is taken as not moving
+
+/* x' = m[0]*x + m[1]*y + m[2], y' = m[3]*x + m[4]*y + m[5] */
+typedef double ia_affine_t[6];
+
+/* global motion compensation of the input. every frame is matched against
+ * the one before it: the keypoints of the previous frame are searched for in
+ * the 4x pyramid, refined on the 2x one and then on luma, and an affine
+ * motion is fitted to the matches with ransac. the motions chained up are
+ * the camera trajectory, its average over the last i_window frames a
+ * smoothed one, and the frame is warped to where the smoothed camera would
+ * have seen it. this runs on every frame before any filter sees it, so all
+ * of them get the stabilised frames and refs. */
+typedef struct ia_stab_t
+{
+    int         i_window;
+    uint64_t    i_turn;         // next frame allowed to estimate its motion
+    ia_cache_entry_t* prev[3];  // luma, 2x, 4x pyramid of the previous frame as decoded
+    ia_keypoints_t kp;          // and its keypoints
+    ia_affine_t traj;           // previous frame to the first one
+    ia_affine_t* ring;          // the last i_window trajectories
+    uint64_t    i_ring;         // trajectories pushed so far
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;
+} ia_stab_t;
+
+/* retval: the stabiliser, NULL if it couldnt be allocated */
+ia_stab_t* ia_stab_open( int window );
+
+/* stabilises iaf in place. frames have to come in consecutively from 0, a
+ * call waits until the previous frame has estimated its motion.
+ * retval: 0 ok, 1 couldnt allocate (iaf is left as it was) */
+int ia_stab_frame( ia_stab_t* st, ia_image_t* iaf );
+
+void ia_stab_close( ia_stab_t* st );
+
+#endif
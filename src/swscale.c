@@ -1,5 +1,4 @@
 #include "swscale.h"
-#include <FreeImage.h>
 #include <pthread.h>
 
 #ifdef HAVE_LIBSWSCALE
@@ -25,25 +24,21 @@ int ia_swscale( ia_swscale_t* c, ia_image_t* iaf, int32_t width,
         return -1;
     }
 
+    /* the camera frame sits unpadded at the start of iaf->pix, top row
+     * first */
     int s_stride[4] = {width*2, 0, 0, 0};
-    int d_stride[4] = {width*3, 0, 0, 0};
+    int d_stride[4] = {ia_image_stride(iar), 0, 0, 0};
     uint8_t* s_slice[4] = {iaf->pix, 0, 0, 0};
-    uint8_t* d_slice[4] = {iar->pix, 0, 0, 0};
+    uint8_t* d_slice[4] = {ia_image_row(iar, 0), 0, 0, 0};
 
     if( sws_scale(c, s_slice, s_stride, 0, height, d_slice, d_stride)
         != height ) {
+        ia_image_free( iar );
         return -1;
     }
 
-    FreeImage_Unload( (FIBITMAP*)iaf->dib );
-    iaf->dib = iar->dib;
-    iaf->pix = iar->pix;
-
-    pthread_mutex_destroy( &iar->mutex );
-    pthread_cond_destroy( &iar->cond_ro );
-    pthread_cond_destroy( &iar->cond_rw );
-
-    ia_free( iar );
+    ia_image_swap( iaf, iar );
+    ia_image_free( iar );
 
     return 0;
 }
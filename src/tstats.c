@@ -0,0 +1,273 @@
+#include "tstats.h"
+#include "ia_sequence.h"
+
+int ia_tstats_require( struct ia_seq_t* s, int flags )
+{
+    ia_tstats_t* ts = s->tstats;
+
+    if( ts == NULL ) {
+        ts = ia_calloc( 1, sizeof(ia_tstats_t) );
+        if( ts == NULL )
+            return 1;
+        ts->i_window = s->param->i_maxrefs;
+        ts->i_turn = ts->i_window - 1;
+        pthread_mutex_init( &ts->mutex, NULL );
+        ia_pthread_cond_init( &ts->cond, NULL );
+        s->tstats = ts;
+    }
+
+    if( flags & IA_TSTATS_VAR )
+        flags |= IA_TSTATS_MEAN;
+    if( (flags & (IA_TSTATS_RANGE|IA_TSTATS_MEDIAN)) && ts->i_window > IA_TSTATS_MAX_ORDER_WINDOW ) {
+        fprintf( stderr, "WARNING: ia_tstats_require(): --refs > %d, min/max and median scan the window\n",
+                 IA_TSTATS_MAX_ORDER_WINDOW );
+        flags &= ~(IA_TSTATS_RANGE|IA_TSTATS_MEDIAN);
+    }
+    ts->i_flags |= flags;
+    return 0;
+}
+
+/* the window buffers are sized from the first frame, they hold one entry per
+ * byte of pix so filters can index them like the frames */
+static int ia_tstats_alloc( ia_tstats_t* ts, ia_image_t* iaf )
+{
+    int d;
+
+    ts->i_samples = iaf->i_pitch * iaf->i_height;
+    if( ts->i_flags & IA_TSTATS_MEAN )
+        if( (ts->sum = ia_calloc(ts->i_samples, sizeof(uint32_t))) == NULL )
+            return 1;
+    if( ts->i_flags & IA_TSTATS_VAR )
+        if( (ts->sumsq = ia_calloc(ts->i_samples, sizeof(uint32_t))) == NULL )
+            return 1;
+    if( ts->i_flags & IA_TSTATS_RANGE ) {
+        for( d = 0; d < 2; d++ ) {
+            ts->dq_val[d] = ia_malloc( ts->i_samples * ts->i_window );
+            ts->dq_tag[d] = ia_malloc( ts->i_samples * ts->i_window );
+            ts->dq_head[d] = ia_calloc( ts->i_samples, 1 );
+            ts->dq_len[d] = ia_calloc( ts->i_samples, 1 );
+            if( !ts->dq_val[d] || !ts->dq_tag[d] || !ts->dq_head[d] || !ts->dq_len[d] )
+                return 1;
+        }
+    }
+    if( ts->i_flags & IA_TSTATS_MEDIAN )
+        if( (ts->hist = ia_calloc(ts->i_samples, IA_TSTATS_HIST_SIZE)) == NULL )
+            return 1;
+    return 0;
+}
+
+/* d 0 keeps increasing values (front is the min), d 1 decreasing (the max).
+ * equal values push out older ones so the front is the newest extreme. */
+static inline void ia_tstats_dq_push( ia_tstats_t* ts, int d, size_t i, uint8_t v, uint8_t tag )
+{
+    const int n = ts->i_window;
+    uint8_t* val = ts->dq_val[d] + i * n;
+    uint8_t* tags = ts->dq_tag[d] + i * n;
+    int len = ts->dq_len[d][i];
+    int pos;
+
+    while( len > 0 ) {
+        pos = (ts->dq_head[d][i] + len - 1) % n;
+        if( d ? val[pos] > v : val[pos] < v )
+            break;
+        len--;
+    }
+    pos = (ts->dq_head[d][i] + len) % n;
+    val[pos] = v;
+    tags[pos] = tag;
+    ts->dq_len[d][i] = len + 1;
+}
+
+/* drops the front if it is the frame leaving the window */
+static inline void ia_tstats_dq_expire( ia_tstats_t* ts, int d, size_t i, uint8_t tag )
+{
+    const int n = ts->i_window;
+    int head = ts->dq_head[d][i];
+
+    if( ts->dq_len[d][i] && ts->dq_tag[d][i * n + head] == tag ) {
+        ts->dq_head[d][i] = (head + 1) % n;
+        ts->dq_len[d][i]--;
+    }
+}
+
+/* k'th smallest count, from 1 */
+static inline uint8_t ia_tstats_hist_rank( const uint8_t* h, int k )
+{
+    int c = 0, f;
+
+    while( k > h[c] )
+        k -= h[c++];
+    for( f = 16 + c*16; k > h[f]; f++ )
+        k -= h[f];
+    return f - 16;
+}
+
+static void ia_tstats_add( ia_tstats_t* ts, ia_image_t* iaf, uint64_t i_frame )
+{
+    const uint8_t tag = i_frame & 0xff;
+    size_t i;
+
+    for( i = 0; i < ts->i_samples; i++ )
+    {
+        const uint8_t v = iaf->pix[i];
+
+        if( ts->sum )
+            ts->sum[i] += v;
+        if( ts->sumsq )
+            ts->sumsq[i] += v*v;
+        if( ts->dq_val[0] ) {
+            ia_tstats_dq_push( ts, 0, i, v, tag );
+            ia_tstats_dq_push( ts, 1, i, v, tag );
+        }
+        if( ts->hist ) {
+            uint8_t* h = ts->hist + i * IA_TSTATS_HIST_SIZE;
+            h[v >> 4]++;
+            h[16 + v]++;
+        }
+    }
+}
+
+/* copies out the statistics of the full window ending at i_frame and takes
+ * the oldest frame, iaim[0], back out for the next one */
+static void ia_tstats_take( ia_tstats_t* ts, ia_tstats_window_t* w,
+                            ia_image_t** iaim, uint64_t i_frame )
+{
+    const uint64_t first = i_frame - (ts->i_window-1);
+    const uint8_t old = first & 0xff;
+    const int n = ts->i_window;
+    size_t i;
+
+    for( i = 0; i < ts->i_samples; i++ )
+    {
+        const uint8_t v = iaim[0]->pix[i];
+
+        if( ts->sum ) {
+            w->sum[i] = ts->sum[i];
+            ts->sum[i] -= v;
+        }
+        if( ts->sumsq ) {
+            w->sumsq[i] = ts->sumsq[i];
+            ts->sumsq[i] -= v*v;
+        }
+        if( ts->dq_val[0] ) {
+            const size_t h0 = i * n + ts->dq_head[0][i];
+            const size_t h1 = i * n + ts->dq_head[1][i];
+
+            w->min[i] = ts->dq_val[0][h0];
+            w->max[i] = ts->dq_val[1][h1];
+            w->argmin[i] = (uint8_t)(ts->dq_tag[0][h0] - old);
+            w->argmax[i] = (uint8_t)(ts->dq_tag[1][h1] - old);
+            ia_tstats_dq_expire( ts, 0, i, old );
+            ia_tstats_dq_expire( ts, 1, i, old );
+        }
+        if( ts->hist ) {
+            uint8_t* h = ts->hist + i * IA_TSTATS_HIST_SIZE;
+            w->median[i] = ia_tstats_hist_rank( h, (n+1) / 2 );
+            h[v >> 4]--;
+            h[16 + v]--;
+        }
+    }
+}
+
+static ia_tstats_window_t* ia_tstats_window_create( ia_tstats_t* ts )
+{
+    ia_tstats_window_t* w = ia_calloc( 1, sizeof(ia_tstats_window_t) );
+    bool b_fail = false;
+
+    if( w == NULL )
+        return NULL;
+
+    w->i_window = ts->i_window;
+    if( ts->sum )
+        b_fail |= (w->sum = ia_malloc( ts->i_samples * sizeof(uint32_t) )) == NULL;
+    if( ts->sumsq )
+        b_fail |= (w->sumsq = ia_malloc( ts->i_samples * sizeof(uint32_t) )) == NULL;
+    if( ts->dq_val[0] ) {
+        b_fail |= (w->min = ia_malloc( ts->i_samples )) == NULL;
+        b_fail |= (w->max = ia_malloc( ts->i_samples )) == NULL;
+        b_fail |= (w->argmin = ia_malloc( ts->i_samples )) == NULL;
+        b_fail |= (w->argmax = ia_malloc( ts->i_samples )) == NULL;
+    }
+    if( ts->hist )
+        b_fail |= (w->median = ia_malloc( ts->i_samples )) == NULL;
+    if( b_fail ) {
+        ia_tstats_window_free( w );
+        return NULL;
+    }
+    return w;
+}
+
+ia_tstats_window_t* ia_tstats_advance( ia_tstats_t* ts, ia_image_t** iaim, uint64_t i_frame )
+{
+    const uint64_t first = i_frame - (ts->i_window-1);
+    ia_tstats_window_t* w = NULL;
+    int rc;
+
+    if( 0 != (rc = ia_pthread_mutex_lock( &ts->mutex )) )
+        ia_pthread_error( rc, "ia_tstats_advance()", "ia_pthread_mutex_lock()" );
+
+    /* the window only moves forward one frame at a time */
+    while( ts->i_turn != i_frame ) {
+        if( 0 != (rc = ia_pthread_cond_wait( &ts->cond, &ts->mutex )) )
+            ia_pthread_error( rc, "ia_tstats_advance()", "ia_pthread_cond_wait()" );
+    }
+
+    if( ts->i_samples == 0 && ia_tstats_alloc(ts, iaim[0]) ) {
+        fprintf( stderr, "ERROR: ia_tstats_advance(): couldnt alloc running statistics\n" );
+        ts->i_flags = 0;
+    }
+
+    if( ts->i_flags ) {
+        /* the first window comes in whole */
+        for( ; ts->i_next <= i_frame; ts->i_next++ )
+            ia_tstats_add( ts, iaim[ts->i_next - first], ts->i_next );
+
+        w = ia_tstats_window_create( ts );
+        if( w != NULL )
+            ia_tstats_take( ts, w, iaim, i_frame );
+        else
+            fprintf( stderr, "ERROR: ia_tstats_advance(): couldnt alloc window statistics\n" );
+    }
+
+    ts->i_turn++;
+    if( 0 != (rc = ia_pthread_cond_broadcast( &ts->cond )) )
+        ia_pthread_error( rc, "ia_tstats_advance()", "ia_pthread_cond_broadcast()" );
+    if( 0 != (rc = ia_pthread_mutex_unlock( &ts->mutex )) )
+        ia_pthread_error( rc, "ia_tstats_advance()", "ia_pthread_mutex_unlock()" );
+
+    return w;
+}
+
+void ia_tstats_window_free( ia_tstats_window_t* w )
+{
+    if( w == NULL )
+        return;
+    ia_free( w->sum );
+    ia_free( w->sumsq );
+    ia_free( w->min );
+    ia_free( w->max );
+    ia_free( w->argmin );
+    ia_free( w->argmax );
+    ia_free( w->median );
+    ia_free( w );
+}
+
+void ia_tstats_close( ia_tstats_t* ts )
+{
+    int d;
+
+    if( ts == NULL )
+        return;
+    ia_free( ts->sum );
+    ia_free( ts->sumsq );
+    for( d = 0; d < 2; d++ ) {
+        ia_free( ts->dq_val[d] );
+        ia_free( ts->dq_tag[d] );
+        ia_free( ts->dq_head[d] );
+        ia_free( ts->dq_len[d] );
+    }
+    ia_free( ts->hist );
+    pthread_mutex_destroy( &ts->mutex );
+    pthread_cond_destroy( &ts->cond );
+    ia_free( ts );
+}
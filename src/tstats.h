@@ -0,0 +1,85 @@
+#ifndef _H_TSTATS
+#define _H_TSTATS
+
+#include "common.h"
+
+struct ia_seq_t;
+
+/* statistics a filter can ask for, see ia_tstats_require */
+#define IA_TSTATS_MEAN      0x1     // running sum
+#define IA_TSTATS_VAR       0x2     // running sum of squares too
+#define IA_TSTATS_RANGE     0x4     // min and max through monotonic deques
+#define IA_TSTATS_MEDIAN    0x8     // median through per byte histograms
+
+/* deque tags are frame numbers mod 256 and histogram counts are bytes, so min,
+ * max and median need windows no longer than this */
+#define IA_TSTATS_MAX_ORDER_WINDOW 255
+
+/* a histogram is 16 coarse bins of 16 values each followed by the 256 fine
+ * bins. the median is found by walking at most 16 of each. */
+#define IA_TSTATS_HIST_SIZE (16+256)
+
+/* per byte statistics of the ref window an output frame is computed from:
+ * the i_window frames iaim[0] (oldest) .. iaim[i_window-1] (current). every
+ * array has one entry per byte of pix, arrays of statistics that werent
+ * asked for are NULL. */
+typedef struct ia_tstats_window_t
+{
+    int32_t     i_window;
+    uint32_t*   sum;
+    uint32_t*   sumsq;
+    uint8_t*    min;
+    uint8_t*    max;
+    uint8_t*    argmin;     // iaim index of the newest frame holding min
+    uint8_t*    argmax;
+    uint8_t*    median;     // lower median for even windows
+} ia_tstats_window_t;
+
+/* running statistics over the sliding ref window. frames enter and leave in
+ * order, so the sums only change by the frame coming in and the one going
+ * out, the deques keep the only values that can still become the min or
+ * max, and the histograms change by one count in and one out. cost per byte
+ * doesnt depend on the window length. */
+typedef struct ia_tstats_t
+{
+    int         i_flags;
+    int32_t     i_window;
+    size_t      i_samples;  // bytes per frame, pitch included
+    uint64_t    i_next;     // next frame to enter the window
+    uint64_t    i_turn;     // next output frame allowed to advance
+    uint32_t*   sum;
+    uint32_t*   sumsq;
+    uint8_t*    dq_val[2];  // min, max deques, i_window entries per byte
+    uint8_t*    dq_tag[2];
+    uint8_t*    dq_head[2];
+    uint8_t*    dq_len[2];
+    uint8_t*    hist;       // IA_TSTATS_HIST_SIZE counts per byte
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;
+} ia_tstats_t;
+
+/* called from a filters init function: makes s keep the statistics in flags.
+ * retval: 0 ok, 1 couldnt allocate them */
+int ia_tstats_require( struct ia_seq_t* s, int flags );
+
+/* moves the window to end at frame i_frame, iaim being its frames, and
+ * returns a copy of the statistics for it. waits until every earlier output
+ * frame has moved the window.
+ * retval: the statistics, NULL on error */
+ia_tstats_window_t* ia_tstats_advance( ia_tstats_t* ts, ia_image_t** iaim, uint64_t i_frame );
+
+void ia_tstats_window_free( ia_tstats_window_t* w );
+void ia_tstats_close( ia_tstats_t* ts );
+
+static inline double ia_tstats_mean( ia_tstats_window_t* w, size_t i )
+{
+    return (double) w->sum[i] / w->i_window;
+}
+
+static inline double ia_tstats_var( ia_tstats_window_t* w, size_t i )
+{
+    double mean = ia_tstats_mean( w, i );
+    return (double) w->sumsq[i] / w->i_window - mean*mean;
+}
+
+#endif
@@ -0,0 +1,301 @@
+#include "y4m.h"
+#include "hash.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* longest header line accepted, the spec doesnt give one */
+#define IA_Y4M_LINE_SIZE 1024
+
+static const char* ia_y4m_chroma_tags[] = { "420jpeg", "422", "444", "mono" };
+
+static int ia_y4m_set_chroma( ia_y4m_t* y4m, ia_y4m_chroma_t chroma )
+{
+    size_t luma = (size_t)y4m->i_width * y4m->i_height;
+
+    y4m->chroma = chroma;
+    y4m->i_chroma_width = chroma == IA_Y4M_444 ? y4m->i_width : (y4m->i_width+1) >> 1;
+    y4m->i_chroma_height = chroma == IA_Y4M_420 ? (y4m->i_height+1) >> 1 : y4m->i_height;
+    if( chroma == IA_Y4M_MONO )
+        y4m->i_chroma_width = y4m->i_chroma_height = 0;
+
+    y4m->i_frame_size = luma + 2 * (size_t)y4m->i_chroma_width * y4m->i_chroma_height;
+    y4m->buf = ia_malloc( y4m->i_frame_size );
+    if( y4m->buf == NULL ) {
+        fprintf( stderr, "ERROR: ia_y4m_set_chroma(): couldnt alloc frame buffer\n" );
+        return -1;
+    }
+    return 0;
+}
+
+/* retval: 0 ok, -1 unsupported or broken header */
+static int ia_y4m_parse_header( ia_y4m_t* y4m, char* line )
+{
+    ia_y4m_chroma_t chroma = IA_Y4M_420;
+    char* save = NULL;
+    char* tok;
+
+    tok = strtok_r( line, " \n", &save );
+    if( tok == NULL || strcmp(tok, "YUV4MPEG2") ) {
+        fprintf( stderr, "ERROR: ia_y4m_parse_header(): not a YUV4MPEG2 stream\n" );
+        return -1;
+    }
+
+    while( (tok = strtok_r(NULL, " \n", &save)) != NULL ) {
+        switch( tok[0] ) {
+            case 'W':
+                y4m->i_width = atoi( tok+1 );
+                break;
+            case 'H':
+                y4m->i_height = atoi( tok+1 );
+                break;
+            case 'F':
+                if( sscanf(tok+1, "%d:%d", &y4m->i_fps_num, &y4m->i_fps_den) != 2 )
+                    y4m->i_fps_num = y4m->i_fps_den = 0;
+                break;
+            case 'C':
+                if( !strncmp(tok+1, "420", 3) )
+                    chroma = IA_Y4M_420;
+                else if( !strcmp(tok+1, "422") )
+                    chroma = IA_Y4M_422;
+                else if( !strcmp(tok+1, "444") )
+                    chroma = IA_Y4M_444;
+                else if( !strcmp(tok+1, "mono") )
+                    chroma = IA_Y4M_MONO;
+                else {
+                    fprintf( stderr, "ERROR: ia_y4m_parse_header(): unsupported colorspace %s\n", tok+1 );
+                    return -1;
+                }
+                break;
+            default:
+                /* interlacing, aspect and extensions dont change the layout */
+                break;
+        }
+    }
+
+    if( y4m->i_width <= 0 || y4m->i_height <= 0 ) {
+        fprintf( stderr, "ERROR: ia_y4m_parse_header(): missing frame size\n" );
+        return -1;
+    }
+    return ia_y4m_set_chroma( y4m, chroma );
+}
+
+ia_y4m_t* ia_y4m_open_read( const char* file )
+{
+    char line[IA_Y4M_LINE_SIZE];
+    struct stat st;
+    ia_y4m_t* y4m = ia_calloc( 1, sizeof(ia_y4m_t) );
+
+    if( y4m == NULL )
+        return NULL;
+
+    y4m->fp = strcmp(file, "-") ? ia_fopen( file, "rb" ) : stdin;
+    if( y4m->fp == NULL ) {
+        fprintf( stderr, "ERROR: ia_y4m_open_read(): couldnt open %s: %s\n", file, ia_strerror(errno) );
+        ia_free( y4m );
+        return NULL;
+    }
+    y4m->b_seekable = !fstat( fileno(y4m->fp), &st ) && S_ISREG( st.st_mode );
+
+    if( ia_fgets(line, sizeof(line), y4m->fp) == NULL ||
+        ia_y4m_parse_header(y4m, line) ) {
+        ia_y4m_close( y4m );
+        return NULL;
+    }
+    return y4m;
+}
+
+ia_y4m_t* ia_y4m_open_write( const char* file, int width, int height,
+                             int fps_num, int fps_den, ia_y4m_chroma_t chroma )
+{
+    ia_y4m_t* y4m = ia_calloc( 1, sizeof(ia_y4m_t) );
+
+    if( y4m == NULL )
+        return NULL;
+
+    y4m->i_width = width;
+    y4m->i_height = height;
+    y4m->i_fps_num = fps_num;
+    y4m->i_fps_den = fps_den;
+    if( ia_y4m_set_chroma(y4m, chroma) ) {
+        ia_free( y4m );
+        return NULL;
+    }
+
+    y4m->fp = strcmp(file, "-") ? ia_fopen( file, "wb" ) : stdout;
+    if( y4m->fp == NULL ) {
+        fprintf( stderr, "ERROR: ia_y4m_open_write(): couldnt open %s: %s\n", file, ia_strerror(errno) );
+        ia_y4m_close( y4m );
+        return NULL;
+    }
+
+    if( fprintf(y4m->fp, "YUV4MPEG2 W%d H%d F%d:%d Ip A1:1 C%s\n", width, height,
+                fps_num, fps_den, ia_y4m_chroma_tags[chroma]) < 0 ) {
+        fprintf( stderr, "ERROR: ia_y4m_open_write(): couldnt write header\n" );
+        ia_y4m_close( y4m );
+        return NULL;
+    }
+    return y4m;
+}
+
+/* consumes the FRAME line in front of every frame
+ * retval: 0 ok, -1 end of stream */
+static int ia_y4m_read_frame_header( ia_y4m_t* y4m )
+{
+    char line[IA_Y4M_LINE_SIZE];
+
+    if( ia_fgets(line, sizeof(line), y4m->fp) == NULL )
+        return -1;
+    if( strncmp(line, "FRAME", 5) ) {
+        fprintf( stderr, "ERROR: ia_y4m_read_frame_header(): lost frame sync\n" );
+        return -1;
+    }
+    return 0;
+}
+
+int ia_y4m_skip_frame( ia_y4m_t* y4m )
+{
+    if( ia_y4m_read_frame_header(y4m) )
+        return -1;
+    if( y4m->b_seekable )
+        return fseeko( y4m->fp, y4m->i_frame_size, SEEK_CUR ) ? -1 : 0;
+    if( fread(y4m->buf, 1, y4m->i_frame_size, y4m->fp) != y4m->i_frame_size )
+        return -1;
+    return 0;
+}
+
+int ia_y4m_read_frame( ia_y4m_t* y4m, ia_image_t* iaf )
+{
+    const int w = y4m->i_width;
+    const int h = y4m->i_height;
+    const int xs = y4m->chroma == IA_Y4M_444 ? 0 : 1;
+    const int ys = y4m->chroma == IA_Y4M_420 ? 1 : 0;
+    uint8_t *Y, *U, *V;
+    int x, y;
+
+    if( ia_y4m_read_frame_header(y4m) )
+        return -1;
+
+    /* kept planes are read straight into the frame's own buffer */
+    ia_free( iaf->planes );
+    iaf->planes = y4m->b_keep ? ia_malloc( y4m->i_frame_size ) : NULL;
+    Y = iaf->planes ? iaf->planes : y4m->buf;
+    U = Y + (size_t)w * h;
+    V = U + (size_t)y4m->i_chroma_width * y4m->i_chroma_height;
+
+    if( fread(Y, 1, y4m->i_frame_size, y4m->fp) != y4m->i_frame_size ) {
+        fprintf( stderr, "ERROR: ia_y4m_read_frame(): truncated frame\n" );
+        return -1;
+    }
+
+    /* BT.601 studio range, same constants as yuv420torgb24 */
+    for( y = 0; y < h; y++ )
+    {
+        const uint8_t* py = Y + (size_t)y * w;
+        const uint8_t* pu = U + (size_t)(y >> ys) * y4m->i_chroma_width;
+        const uint8_t* pv = V + (size_t)(y >> ys) * y4m->i_chroma_width;
+        ia_pixel_t* dst = ia_image_row( iaf, y );
+
+        for( x = 0; x < w; x++ )
+        {
+            int yy = (py[x] - 16) * 298;
+            int uu = 0, vv = 0;
+
+            if( y4m->chroma != IA_Y4M_MONO ) {
+                uu = pu[x >> xs] - 128;
+                vv = pv[x >> xs] - 128;
+            }
+
+            dst[3*x+0] = clip_uint8( (yy + uu*516 + 128) >> 8 );
+            dst[3*x+1] = clip_uint8( (yy - uu*100 - vv*208 + 128) >> 8 );
+            dst[3*x+2] = clip_uint8( (yy + vv*409 + 128) >> 8 );
+        }
+    }
+    if( iaf->planes )
+        iaf->i_planes_hash = ia_hash_image( iaf );
+
+    return 0;
+}
+
+/* converts iar into the planar buffer of y4m */
+static void ia_y4m_pack( ia_y4m_t* y4m, ia_image_t* iar )
+{
+    const int w = y4m->i_width;
+    const int h = y4m->i_height;
+    const int xs = y4m->chroma == IA_Y4M_444 ? 0 : 1;
+    const int ys = y4m->chroma == IA_Y4M_420 ? 1 : 0;
+    uint8_t* Y = y4m->buf;
+    uint8_t* U = Y + (size_t)w * h;
+    uint8_t* V = U + (size_t)y4m->i_chroma_width * y4m->i_chroma_height;
+    int x, y, cx, cy;
+
+    for( y = 0; y < h; y++ )
+    {
+        const ia_pixel_t* src = ia_image_row( iar, y );
+        uint8_t* py = Y + (size_t)y * w;
+
+        for( x = 0; x < w; x++ )
+            py[x] = ((66*src[3*x+2] + 129*src[3*x+1] + 25*src[3*x] + 128) >> 8) + 16;
+    }
+
+    /* chroma is taken from the average colour of the pixels it covers */
+    for( cy = 0; cy < y4m->i_chroma_height; cy++ )
+    {
+        for( cx = 0; cx < y4m->i_chroma_width; cx++ )
+        {
+            int r = 0, g = 0, b = 0, n = 0;
+
+            for( y = cy << ys; y < ((cy+1) << ys) && y < h; y++ )
+            {
+                const ia_pixel_t* src = ia_image_row( iar, y );
+                for( x = cx << xs; x < ((cx+1) << xs) && x < w; x++ )
+                {
+                    b += src[3*x+0];
+                    g += src[3*x+1];
+                    r += src[3*x+2];
+                    n++;
+                }
+            }
+            r = (r + n/2) / n;
+            g = (g + n/2) / n;
+            b = (b + n/2) / n;
+
+            U[cy * y4m->i_chroma_width + cx] = ((-38*r - 74*g + 112*b + 128) >> 8) + 128;
+            V[cy * y4m->i_chroma_width + cx] = ((112*r - 94*g - 18*b + 128) >> 8) + 128;
+        }
+    }
+}
+
+int ia_y4m_write_frame( ia_y4m_t* y4m, ia_image_t* iar )
+{
+    const uint8_t* data = y4m->buf;
+
+    /* an unmodified frame of y4m input, converting it back would add the
+     * rounding of a second conversion */
+    if( iar->planes )
+        data = iar->planes;
+    else
+        ia_y4m_pack( y4m, iar );
+
+    if( fputs("FRAME\n", y4m->fp) == EOF ||
+        fwrite(data, 1, y4m->i_frame_size, y4m->fp) != y4m->i_frame_size ) {
+        fprintf( stderr, "ERROR: ia_y4m_write_frame(): %s\n", ia_strerror(errno) );
+        return -1;
+    }
+    return 0;
+}
+
+void ia_y4m_close( ia_y4m_t* y4m )
+{
+    if( y4m->fp == stdout )
+        fflush( y4m->fp );
+    else if( y4m->fp && y4m->fp != stdin )
+        ia_fclose( y4m->fp );
+    ia_free( y4m->buf );
+    ia_free( y4m );
+}
@@ -0,0 +1,53 @@
+#ifndef _H_Y4M
+#define _H_Y4M
+
+#include "common.h"
+
+/* chroma layouts of YUV4MPEG2 streams ia can read and write */
+typedef enum {
+    IA_Y4M_420,     // 420jpeg, 420paldv, 420mpeg2 and plain 420
+    IA_Y4M_422,
+    IA_Y4M_444,
+    IA_Y4M_MONO,
+} ia_y4m_chroma_t;
+
+/* a YUV4MPEG2 stream, read or written through stdio so that pipes work the
+ * same as files. frames are planar YUV and converted to/from the bottom-up
+ * BGR24 layout of ia_image_t on the fly. */
+typedef struct ia_y4m_t {
+    FILE*           fp;
+    bool            b_seekable;     // skipped frames can be seeked over
+    int             i_width;
+    int             i_height;
+    int             i_fps_num;
+    int             i_fps_den;
+    ia_y4m_chroma_t chroma;
+    int             i_chroma_width;
+    int             i_chroma_height;
+    size_t          i_frame_size;   // bytes of planar data per frame
+    bool            b_keep;         // read frames keep their planes, see ia_image_t
+    uint8_t*        buf;            // one frame of planar data
+} ia_y4m_t;
+
+/* opens file for reading, "-" reads stdin */
+ia_y4m_t* ia_y4m_open_read( const char* file );
+
+/* opens file for writing, "-" writes to stdout */
+ia_y4m_t* ia_y4m_open_write( const char* file, int width, int height,
+                             int fps_num, int fps_den, ia_y4m_chroma_t chroma );
+
+/* reads the next frame into iaf
+ * retval: 0 ok, -1 end of stream or error */
+int ia_y4m_read_frame( ia_y4m_t* y4m, ia_image_t* iaf );
+
+/* drops the next frame without converting it
+ * retval: 0 ok, -1 end of stream or error */
+int ia_y4m_skip_frame( ia_y4m_t* y4m );
+
+/* writes iar as the next frame, its planes as they are when it has them
+ * retval: 0 ok, -1 error */
+int ia_y4m_write_frame( ia_y4m_t* y4m, ia_image_t* iar );
+
+void ia_y4m_close( ia_y4m_t* y4m );
+
+#endif
@@ -45,6 +45,8 @@ my $body1 =
 #include "common.h"
 #include "image_analyzer.h"
 #include "ia_sequence.h"
+#include "cache.h"
+#include "tstats.h"
 
 ';
 
@@ -55,8 +57,6 @@ static inline int offset( int w, int x, int y, int p )
     return w*y + x*3+p;
 }
 
-#define O( y,x ) (s->param->i_width*3*y + x*3)
-
 ';
 
 my $body3 =
@@ -68,9 +68,9 @@ typedef void (*clos_funcs)(ia_filter_param_t*);
 
 typedef struct ia_filters_t
 {
-    init_funcs      init[20];
-    exec_funcs      exec[20];
-    clos_funcs      clos[20];
+    init_funcs      init[IA_MAX_FILTERS];
+    exec_funcs      exec[IA_MAX_FILTERS];
+    clos_funcs      clos[IA_MAX_FILTERS];
 } ia_filters_t;
 
 ia_filters_t filters;